@@ -0,0 +1,440 @@
+/**
+ * @file als_filter.c
+ * ALS smoothing chain and profile lookup
+ * <p>
+ * Everything here is free of I/O and configuration,
+ * so that the ALS module and the offline tuning tool
+ * use the very same code
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include "als_filter.h"
+
+#include "median_filter.h"		/* median_filter_init(),
+					 * median_filter_map(),
+					 * median_filter_free()
+					 */
+
+/**
+ * Compile an ALS profile into threshold arrays for binary search
+ *
+ * Unsorted ranges are clamped into ascending order
+ *
+ * @param profile The profile to compile
+ * @param[out] table The compiled profile
+ * @param threshold_max The upper threshold of the topmost level
+ * @return 0 if the profile is sane, otherwise a mask of
+ *         ALS_PROFILE_UNTERMINATED and ALS_PROFILE_UNSORTED
+ */
+gint als_profile_compile(const als_profile_struct *profile,
+			 als_level_table_t *table, gint threshold_max)
+{
+	gint problems = 0;
+	gint i;
+
+	for (i = 0; i < ALS_RANGES; i++) {
+		if (profile->range[i][0] == -1)
+			break;
+
+		table->down[i] = profile->range[i][0];
+		table->up[i] = MAX(profile->range[i][1], profile->range[i][0]);
+
+		/* The binary search needs sorted thresholds */
+		if ((i > 0) &&
+		    ((table->down[i] < table->down[i - 1]) ||
+		     (table->up[i] < table->up[i - 1]))) {
+			table->down[i] = MAX(table->down[i],
+					     table->down[i - 1]);
+			table->up[i] = MAX(table->up[i], table->up[i - 1]);
+			problems |= ALS_PROFILE_UNSORTED;
+		}
+	}
+
+	if (i >= ALS_RANGES)
+		problems |= ALS_PROFILE_UNTERMINATED;
+
+	table->levels = i;
+	table->value = profile->value;
+
+	/* A level is left downwards below the lower edge
+	 * of the boundary below it, and upwards at the upper
+	 * edge of the boundary above it
+	 */
+	for (i = 0; i <= table->levels; i++) {
+		table->lower[i] = (i == 0) ? 0 : table->down[i - 1];
+		table->upper[i] = (i == table->levels) ?
+				  threshold_max : table->up[i];
+	}
+
+	return problems;
+}
+
+/**
+ * Find the first threshold that a lux value is below
+ *
+ * @param thresholds The thresholds, in ascending order
+ * @param first The first threshold to consider
+ * @param last One past the last threshold to consider
+ * @param lux The lux value
+ * @return The index of the threshold, or last if there's none
+ */
+static gint find_threshold(const gint *thresholds,
+			   gint first, gint last, gint lux)
+{
+	while (first < last) {
+		gint mid = first + ((last - first) / 2);
+
+		if (lux < thresholds[mid])
+			last = mid;
+		else
+			first = mid + 1;
+	}
+
+	return first;
+}
+
+/**
+ * Look up the brightness level for a lux value
+ *
+ * @param table The compiled profile
+ * @param lux The lux value
+ * @param[in,out] level The old level; will be replaced by the new level
+ * @param[out] lower The new lower ALS interrupt threshold
+ * @param[out] upper The new upper ALS interrupt threshold
+ * @return The brightness in % of maximum
+ */
+gint als_profile_lookup(const als_level_table_t *table, gint lux,
+			gint *level, gint *lower, gint *upper)
+{
+	gint old = CLAMP(*level, 0, table->levels);
+	gint new;
+
+	/* The boundaries below the current level are crossed
+	 * at their lower edges, the ones above it at their upper edges
+	 */
+	new = find_threshold(table->down, 0, old, lux);
+
+	if (new == old)
+		new = find_threshold(table->up, old, table->levels, lux);
+
+	*level = new;
+	*lower = table->lower[new];
+	*upper = table->upper[new];
+
+	return table->value[new];
+}
+
+/**
+ * Set up an empty smoothing chain
+ *
+ * @param chain The chain
+ * @param params The parameters of the stages; out of range
+ *               values are clamped
+ */
+void als_filter_chain_setup(als_filter_chain_t *chain,
+			    const als_filter_params_t *params)
+{
+	chain->count = 0;
+	chain->params = *params;
+
+	chain->params.median_window = MAX(chain->params.median_window, 1);
+	chain->params.ewma_weight = CLAMP(chain->params.ewma_weight, 1, 100);
+	chain->params.hysteresis_band = MAX(chain->params.hysteresis_band, 0);
+	chain->params.hysteresis_min = MAX(chain->params.hysteresis_min, 0);
+	chain->params.spike_ratio = MAX(chain->params.spike_ratio, 100);
+	chain->params.spike_min = MAX(chain->params.spike_min, 0);
+	chain->params.spike_hold = MAX(chain->params.spike_hold, 0);
+}
+
+/**
+ * Append a stage to a smoothing chain
+ *
+ * @param chain The chain
+ * @param type The stage type
+ * @return TRUE on success, FALSE if the chain is full
+ */
+gboolean als_filter_chain_append(als_filter_chain_t *chain,
+				 als_filter_type_t type)
+{
+	if (chain->count == ALS_FILTER_MAX_STAGES)
+		return FALSE;
+
+	chain->stages[chain->count++].type = type;
+
+	return TRUE;
+}
+
+/**
+ * Reset the state of a smoothing chain
+ *
+ * @param chain The chain
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean als_filter_chain_reset(als_filter_chain_t *chain)
+{
+	gboolean status = TRUE;
+	guint i;
+
+	for (i = 0; i < chain->count; i++) {
+		als_filter_stage_t *stage = &chain->stages[i];
+
+		stage->value = -1;
+		stage->average = 0;
+		stage->rejected = 0;
+
+		if (stage->type != ALS_FILTER_MEDIAN)
+			continue;
+
+		/* Re-initialise the median filter */
+		if (median_filter_init(&stage->median,
+				       chain->params.median_window) == FALSE) {
+			status = FALSE;
+			break;
+		}
+	}
+
+	return status;
+}
+
+/**
+ * Release a smoothing chain
+ *
+ * @param chain The chain
+ */
+void als_filter_chain_free(als_filter_chain_t *chain)
+{
+	guint i;
+
+	for (i = 0; i < ALS_FILTER_MAX_STAGES; i++)
+		median_filter_free(&chain->stages[i].median);
+
+	chain->count = 0;
+}
+
+/**
+ * Exponential moving average stage
+ *
+ * @param stage The stage
+ * @param params The parameters of the chain
+ * @param lux The lux value
+ * @return The filtered value
+ */
+static gint filter_ewma(als_filter_stage_t *stage,
+			const als_filter_params_t *params, gint lux)
+{
+	gint64 target = (gint64)lux * ALS_FILTER_EWMA_SCALE;
+
+	if (stage->value == -1)
+		stage->average = target;
+	else
+		stage->average += ((target - stage->average) *
+				   params->ewma_weight) / 100;
+
+	stage->value = (gint)((stage->average + (ALS_FILTER_EWMA_SCALE / 2)) /
+			      ALS_FILTER_EWMA_SCALE);
+
+	return stage->value;
+}
+
+/**
+ * Hysteresis stage; changes within the band around
+ * the last output don't change the output
+ *
+ * @param stage The stage
+ * @param params The parameters of the chain
+ * @param lux The lux value
+ * @return The filtered value
+ */
+static gint filter_hysteresis(als_filter_stage_t *stage,
+			      const als_filter_params_t *params, gint lux)
+{
+	gint64 band = MAX(((gint64)stage->value * params->hysteresis_band) / 100,
+			  params->hysteresis_min);
+
+	if ((stage->value == -1) ||
+	    (ABS((gint64)lux - stage->value) > band))
+		stage->value = lux;
+
+	return stage->value;
+}
+
+/**
+ * Spike rejection stage; a reading that differs from the last
+ * output by more than the spike ratio is only accepted once
+ * it has been seen more than spike_hold times in a row
+ *
+ * @param stage The stage
+ * @param params The parameters of the chain
+ * @param lux The lux value
+ * @return The filtered value
+ */
+static gint filter_spike(als_filter_stage_t *stage,
+			 const als_filter_params_t *params, gint lux)
+{
+	gint64 last = stage->value;
+	gint64 new = lux;
+
+	if ((last != -1) && (stage->rejected < params->spike_hold) &&
+	    (ABS(new - last) > params->spike_min) &&
+	    ((new * 100 > last * params->spike_ratio) ||
+	     (last * 100 > new * params->spike_ratio))) {
+		stage->rejected++;
+		goto EXIT;
+	}
+
+	stage->rejected = 0;
+	stage->value = lux;
+
+EXIT:
+	return stage->value;
+}
+
+/**
+ * Pass a reading through a smoothing chain
+ *
+ * @param chain The chain
+ * @param value The value to insert
+ * @return The filtered value
+ */
+gint als_filter_chain_map(als_filter_chain_t *chain, gint value)
+{
+	guint i;
+
+	for (i = 0; i < chain->count; i++) {
+		als_filter_stage_t *stage = &chain->stages[i];
+
+		switch (stage->type) {
+		case ALS_FILTER_MEDIAN:
+			value = median_filter_map(&stage->median, value);
+			break;
+
+		case ALS_FILTER_EWMA:
+			value = filter_ewma(stage, &chain->params, value);
+			break;
+
+		case ALS_FILTER_HYSTERESIS:
+			value = filter_hysteresis(stage, &chain->params,
+						  value);
+			break;
+
+		case ALS_FILTER_SPIKE:
+			value = filter_spike(stage, &chain->params, value);
+			break;
+
+		case ALS_FILTER_INVALID:
+		default:
+			break;
+		}
+	}
+
+	return value;
+}
+
+/**
+ * Poll at the shortest interval of a schedule,
+ * and forget the readings used for the variance
+ *
+ * @param schedule The poll schedule
+ */
+void als_poll_reset(als_poll_t *schedule)
+{
+	schedule->interval = schedule->min;
+	schedule->count = 0;
+	schedule->next = 0;
+}
+
+/**
+ * Set the range of poll intervals of a schedule;
+ * if the current interval is outside the new range,
+ * the schedule starts over at the shortest interval
+ *
+ * @param schedule The poll schedule
+ * @param min The shortest interval, in milliseconds; 0 to not poll
+ * @param max The longest interval, in milliseconds
+ */
+void als_poll_set_range(als_poll_t *schedule, gint min, gint max)
+{
+	schedule->min = MAX(min, 0);
+	schedule->max = MAX(max, schedule->min);
+
+	if ((schedule->interval < schedule->min) ||
+	    (schedule->interval > schedule->max))
+		als_poll_reset(schedule);
+}
+
+/**
+ * Adapt the poll interval to the variance of the recent readings;
+ * poll at the shortest interval while the ambient light changes,
+ * and double the interval, up to the longest one, while it is stable
+ *
+ * @param schedule The poll schedule
+ * @param lux The filtered lux value; -1 if the read failed
+ * @return TRUE if the poll interval changed, FALSE otherwise
+ */
+gboolean als_poll_adapt(als_poll_t *schedule, gint lux)
+{
+	gint interval = schedule->interval;
+	gdouble mean = 0.0;
+	gdouble variance = 0.0;
+	gdouble limit;
+	gboolean changed;
+	guint i;
+
+	if ((lux < 0) || (schedule->max == 0))
+		goto EXIT;
+
+	schedule->samples[schedule->next] = lux;
+	schedule->next = (schedule->next + 1) % ALS_VARIANCE_SAMPLES;
+
+	/* Keep the current rate until there are enough readings */
+	if (schedule->count < ALS_VARIANCE_SAMPLES) {
+		schedule->count++;
+		goto EXIT;
+	}
+
+	for (i = 0; i < schedule->count; i++)
+		mean += schedule->samples[i];
+
+	mean /= schedule->count;
+
+	for (i = 0; i < schedule->count; i++) {
+		gdouble delta = schedule->samples[i] - mean;
+
+		variance += delta * delta;
+	}
+
+	variance /= schedule->count;
+
+	/* Compare the variance with the square of the
+	 * largest standard deviation that counts as stable
+	 */
+	limit = MAX(mean * ALS_VARIANCE_CHANGE_RATIO / 100.0,
+		    ALS_VARIANCE_NOISE);
+
+	if (variance > limit * limit)
+		interval = schedule->min;
+	else
+		interval = MIN(interval * 2, schedule->max);
+
+	interval = CLAMP(interval, schedule->min, schedule->max);
+
+EXIT:
+	changed = (interval != schedule->interval);
+	schedule->interval = interval;
+
+	return changed;
+}
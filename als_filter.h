@@ -0,0 +1,177 @@
+/**
+ * @file als_filter.h
+ * Headers for the ALS smoothing chain and profile lookup
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _ALS_FILTER_H_
+#define _ALS_FILTER_H_
+
+#include <glib.h>
+
+#include "median_filter.h"
+
+/** Number of ranges in ALS profile */
+#define ALS_RANGES			11
+
+/** Maximum number of stages in the ALS smoothing chain */
+#define ALS_FILTER_MAX_STAGES		8
+
+/** Fixed point scale of the moving average */
+#define ALS_FILTER_EWMA_SCALE		256
+
+/** Number of ALS readings used for the lux variance */
+#define ALS_VARIANCE_SAMPLES		4
+/**
+ * Standard deviation of the lux readings, in % of their mean,
+ * above which the ambient light is considered to be changing
+ */
+#define ALS_VARIANCE_CHANGE_RATIO	10
+/**
+ * Standard deviation of the lux readings, in lux,
+ * that is always considered noise; this keeps
+ * small changes in darkness from speeding up the polling
+ */
+#define ALS_VARIANCE_NOISE		3
+
+/** The profile lacks the terminating { -1, -1 } range */
+#define ALS_PROFILE_UNTERMINATED	(1 << 0)
+/** The ranges of the profile aren't in ascending order */
+#define ALS_PROFILE_UNSORTED		(1 << 1)
+
+/** ALS profile */
+typedef struct {
+	/** Lower and upper bound for each brightness range */
+	const gint range[ALS_RANGES][2];
+	/** Brightness in % + possible HBM boost (boost level * 256) */
+	const gint value[ALS_RANGES + 1];
+} als_profile_struct;
+
+/** ALS profile compiled into threshold arrays for binary search */
+typedef struct {
+	/** Number of boundaries between levels; there's one more level */
+	gint levels;
+	/** Lux below which each boundary is crossed downwards */
+	gint down[ALS_RANGES];
+	/** Lux at or above which each boundary is crossed upwards */
+	gint up[ALS_RANGES];
+	/** Lower ALS threshold for each level */
+	gint lower[ALS_RANGES + 1];
+	/** Upper ALS threshold for each level */
+	gint upper[ALS_RANGES + 1];
+	/** Brightness for each level */
+	const gint *value;
+} als_level_table_t;
+
+/** ALS smoothing stage types */
+typedef enum {
+	/** Stage type not set; same as MCE_INVALID_TRANSLATION */
+	ALS_FILTER_INVALID = -1,
+	/** Median over the last median_window readings */
+	ALS_FILTER_MEDIAN = 0,
+	/** Exponential moving average */
+	ALS_FILTER_EWMA = 1,
+	/** Hysteresis band around the last output */
+	ALS_FILTER_HYSTERESIS = 2,
+	/** Rejection of single spikes */
+	ALS_FILTER_SPIKE = 3
+} als_filter_type_t;
+
+/** ALS smoothing stage; all state is allocated up front */
+typedef struct {
+	/** Stage type */
+	als_filter_type_t type;
+	/** Last output; -1 before the first reading */
+	gint value;
+	/** Moving average, in 1/ALS_FILTER_EWMA_SCALE lux */
+	gint64 average;
+	/** Spikes rejected in a row */
+	gint rejected;
+	/** Median filter */
+	median_filter_struct median;
+} als_filter_stage_t;
+
+/** Parameters of the ALS smoothing stages */
+typedef struct {
+	/** Window size of median stages */
+	gint median_window;
+	/** Weight of new readings in moving average stages, in % */
+	gint ewma_weight;
+	/** Width of hysteresis bands, in % of the last output */
+	gint hysteresis_band;
+	/** Minimum width of hysteresis bands, in lux */
+	gint hysteresis_min;
+	/** Ratio between readings that counts as a spike, in % */
+	gint spike_ratio;
+	/** Changes of at most this many lux are never spikes */
+	gint spike_min;
+	/** Number of spikes in a row to reject */
+	gint spike_hold;
+} als_filter_params_t;
+
+/**
+ * The ALS smoothing chain
+ *
+ * The chain must be zero-initialised before the first call
+ * to als_filter_chain_setup(), and released with als_filter_chain_free()
+ */
+typedef struct {
+	/** The stages */
+	als_filter_stage_t stages[ALS_FILTER_MAX_STAGES];
+	/** Number of stages */
+	guint count;
+	/** Parameters of the stages */
+	als_filter_params_t params;
+} als_filter_chain_t;
+
+/**
+ * ALS poll schedule; the poll interval adapts to the variance
+ * of the recent readings, within a range of intervals
+ *
+ * Set up with als_poll_set_range() and als_poll_reset()
+ */
+typedef struct {
+	/** Current poll interval, in milliseconds; 0 to not poll */
+	gint interval;
+	/** Shortest poll interval; used while the light changes */
+	gint min;
+	/** Longest poll interval; backed off to while the light is stable */
+	gint max;
+	/** Recent lux readings, for the variance */
+	gint samples[ALS_VARIANCE_SAMPLES];
+	/** Number of valid readings in samples */
+	guint count;
+	/** Next slot to use in samples */
+	guint next;
+} als_poll_t;
+
+gint als_profile_compile(const als_profile_struct *profile,
+			 als_level_table_t *table, gint threshold_max);
+gint als_profile_lookup(const als_level_table_t *table, gint lux,
+			gint *level, gint *lower, gint *upper);
+
+void als_filter_chain_setup(als_filter_chain_t *chain,
+			    const als_filter_params_t *params);
+gboolean als_filter_chain_append(als_filter_chain_t *chain,
+				 als_filter_type_t type);
+gboolean als_filter_chain_reset(als_filter_chain_t *chain);
+gint als_filter_chain_map(als_filter_chain_t *chain, gint value);
+void als_filter_chain_free(als_filter_chain_t *chain);
+
+void als_poll_set_range(als_poll_t *schedule, gint min, gint max);
+void als_poll_reset(als_poll_t *schedule);
+gboolean als_poll_adapt(als_poll_t *schedule, gint lux);
+
+#endif /* _ALS_FILTER_H_ */
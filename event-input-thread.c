@@ -0,0 +1,566 @@
+/**
+ * @file event-input-thread.c
+ * Input reader thread for the Mode Control Entity
+ * <p>
+ * Reads evdev devices on a dedicated thread, optionally with real-time
+ * priority, and passes the events to the mainloop through a
+ * single-producer/single-consumer ring; this keeps the timestamps of
+ * [power] presses and releases accurate even when the mainloop is busy
+ * dispatching D-Bus messages, GConf notifications or LED programming
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <errno.h>			/* errno, EINTR, EAGAIN */
+#include <fcntl.h>			/* fcntl(), O_NONBLOCK */
+#include <poll.h>			/* poll(), struct pollfd */
+#include <sched.h>			/* SCHED_FIFO, struct sched_param */
+#include <string.h>			/* memset() */
+#include <unistd.h>			/* pipe(), read(), write(), close() */
+#include <pthread.h>			/* pthread_create(), pthread_join(),
+					 * pthread_mutex_lock(),
+					 * pthread_mutex_unlock()
+					 */
+#include <linux/input.h>		/* struct input_event */
+
+#include "mce.h"
+#include "event-input-thread.h"
+
+#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-wakeups.h"		/* mce_wakeups_begin(),
+					 * mce_wakeups_end(),
+					 * MCE_WAKEUPS_INPUT_THREAD
+					 */
+
+/** An input device read by the input thread */
+typedef struct {
+	int fd;				/**< File descriptor; -1 if unused */
+	iomon_cb callback;		/**< Callback for the events */
+} input_thread_device_t;
+
+/** An event passed from the input thread to the mainloop */
+typedef struct {
+	iomon_cb callback;		/**< Callback for the event */
+	struct input_event ev;		/**< The event */
+} input_thread_event_t;
+
+/** Devices read by the input thread; protected by device_mutex */
+static input_thread_device_t devices[INPUT_THREAD_MAX_DEVICES];
+/** Bumped whenever devices changes; protected by device_mutex */
+static guint device_generation = 0;
+/** Mutex protecting the device table */
+static pthread_mutex_t device_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Event ring; written by the input thread, read by the mainloop */
+static input_thread_event_t ring[INPUT_THREAD_RING_SIZE];
+/** Ring write position; only advanced by the input thread */
+static volatile gint ring_head = 0;
+/** Ring read position; only advanced by the mainloop */
+static volatile gint ring_tail = 0;
+/** Has the input thread asked the mainloop to drain the ring? */
+static volatile gint wakeup_pending = 0;
+/** Should the input thread exit? */
+static volatile gint thread_quit = 0;
+
+/** Pipe used to wake up the mainloop; [0] read end, [1] write end */
+static int wakeup_fds[2] = { -1, -1 };
+/** Pipe used to wake up the input thread; [0] read end, [1] write end */
+static int control_fds[2] = { -1, -1 };
+/** I/O channel for the mainloop wakeup pipe */
+static GIOChannel *wakeup_iochan = NULL;
+/** ID for the mainloop wakeup I/O watch */
+static guint wakeup_source_id = 0;
+
+/** The input thread */
+static pthread_t input_thread;
+/** Is the input thread running? */
+static gboolean input_thread_running = FALSE;
+
+/**
+ * Write a byte to a pipe to wake up the other end
+ *
+ * @param fd The write end of the pipe
+ */
+static void poke_pipe(int fd)
+{
+	const gchar byte = 0;
+
+	/* If the pipe is full, the other end is awake already */
+	while ((write(fd, &byte, sizeof (byte)) == -1) && (errno == EINTR))
+		;
+}
+
+/**
+ * Empty a pipe
+ *
+ * @param fd The read end of the pipe
+ */
+static void drain_pipe(int fd)
+{
+	gchar buf[64];
+	ssize_t len;
+
+	while (((len = read(fd, buf, sizeof (buf))) > 0) ||
+	       ((len == -1) && (errno == EINTR)))
+		;
+
+	errno = 0;
+}
+
+/**
+ * Set a file descriptor to non-blocking mode
+ *
+ * @param fd The file descriptor
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	return ((flags != -1) &&
+		(fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1));
+}
+
+/**
+ * Get the number of free slots in the ring
+ * Called from the input thread only
+ *
+ * @return The number of free slots
+ */
+static guint ring_space(void)
+{
+	guint head = (guint)g_atomic_int_get(&ring_head);
+	guint tail = (guint)g_atomic_int_get(&ring_tail);
+
+	return INPUT_THREAD_RING_SIZE - (head - tail);
+}
+
+/**
+ * Read the pending events of a device into the ring
+ * Called from the input thread only, with device_mutex held
+ *
+ * @param device The device to read
+ * @return The number of events queued, -1 if the device failed
+ */
+static gint read_device(const input_thread_device_t *device)
+{
+	struct input_event evs[INPUT_THREAD_RING_SIZE];
+	guint head = (guint)g_atomic_int_get(&ring_head);
+	guint space = ring_space();
+	ssize_t len;
+	gint count = 0;
+	guint i;
+
+	if (space == 0)
+		goto EXIT;
+
+	if ((len = read(device->fd, evs, space * sizeof (evs[0]))) == -1) {
+		if ((errno != EAGAIN) && (errno != EINTR))
+			count = -1;
+
+		goto EXIT;
+	}
+
+	for (i = 0; i < (guint)len / sizeof (evs[0]); i++) {
+		input_thread_event_t *entry =
+			&ring[(head + i) & (INPUT_THREAD_RING_SIZE - 1)];
+
+		entry->callback = device->callback;
+		entry->ev = evs[i];
+		count++;
+	}
+
+	/* Publish the new events; g_atomic_int_set() is a full barrier,
+	 * so the entries are visible before the new head
+	 */
+	g_atomic_int_set(&ring_head, (gint)(head + count));
+
+EXIT:
+	return count;
+}
+
+/**
+ * Main function of the input thread
+ *
+ * @param arg Unused
+ * @return Always returns NULL
+ */
+static void *input_thread_main(void *arg)
+{
+	struct pollfd pfds[INPUT_THREAD_MAX_DEVICES + 1];
+	input_thread_device_t local[INPUT_THREAD_MAX_DEVICES];
+	guint generation = G_MAXUINT;
+	nfds_t nfds = 1;
+
+	(void)arg;
+
+	/* The control pipe is always the first entry */
+	pfds[0].fd = control_fds[0];
+	pfds[0].events = POLLIN;
+
+	while (g_atomic_int_get(&thread_quit) == 0) {
+		gboolean queued = FALSE;
+		gboolean full = FALSE;
+		nfds_t i;
+
+		/* Pick up changes to the device table */
+		pthread_mutex_lock(&device_mutex);
+
+		if (generation != device_generation) {
+			generation = device_generation;
+			nfds = 1;
+
+			for (i = 0; i < INPUT_THREAD_MAX_DEVICES; i++) {
+				if (devices[i].fd == -1)
+					continue;
+
+				local[nfds - 1] = devices[i];
+				pfds[nfds].fd = devices[i].fd;
+				pfds[nfds].events = POLLIN;
+				nfds++;
+			}
+		}
+
+		pthread_mutex_unlock(&device_mutex);
+
+		/* If the ring is full, leave the events in the kernel
+		 * and retry once the mainloop has had a chance to run
+		 */
+		if (ring_space() == 0)
+			full = TRUE;
+
+		if (poll(pfds, full ? 1 : nfds,
+			 full ? INPUT_THREAD_RETRY_DELAY : -1) == -1)
+			continue;
+
+		if ((pfds[0].revents & POLLIN) != 0)
+			drain_pipe(control_fds[0]);
+
+		if (full == TRUE)
+			continue;
+
+		for (i = 1; i < nfds; i++) {
+			gint count;
+
+			if (pfds[i].revents == 0)
+				continue;
+
+			/* Make sure the device wasn't removed
+			 * while we were polling
+			 */
+			pthread_mutex_lock(&device_mutex);
+
+			if (generation != device_generation) {
+				pthread_mutex_unlock(&device_mutex);
+				break;
+			}
+
+			count = read_device(&local[i - 1]);
+
+			pthread_mutex_unlock(&device_mutex);
+
+			/* The device is going away; stop polling it
+			 * until event-input removes it
+			 */
+			if ((count == -1) ||
+			    ((pfds[i].revents & (POLLERR | POLLHUP |
+						 POLLNVAL)) != 0))
+				pfds[i].fd = -1;
+
+			if (count > 0)
+				queued = TRUE;
+		}
+
+		/* Wake up the mainloop unless it already has a wakeup
+		 * pending; it clears the flag before draining the ring
+		 */
+		if ((queued == TRUE) &&
+		    (g_atomic_int_compare_and_exchange(&wakeup_pending,
+						       0, 1) == TRUE))
+			poke_pipe(wakeup_fds[1]);
+	}
+
+	return NULL;
+}
+
+/**
+ * Mainloop callback for events from the input thread
+ *
+ * @param source Unused
+ * @param condition Unused
+ * @param data Unused
+ * @return Always returns TRUE, to keep the I/O watch
+ */
+static gboolean input_thread_wakeup_cb(GIOChannel *source,
+				       GIOCondition condition,
+				       gpointer data)
+{
+	guint tail = (guint)g_atomic_int_get(&ring_tail);
+	guint head;
+
+	(void)source;
+	(void)condition;
+	(void)data;
+
+	mce_wakeups_begin(MCE_WAKEUPS_INPUT_THREAD, "events");
+
+	drain_pipe(wakeup_fds[0]);
+
+	/* Clear the flag before draining,
+	 * so that no event is left behind without a wakeup
+	 */
+	g_atomic_int_set(&wakeup_pending, 0);
+
+	while (tail != (head = (guint)g_atomic_int_get(&ring_head))) {
+		/* Like mce-io, a callback that asks for a flush
+		 * doesn't get the rest of the events read so far
+		 */
+		iomon_cb flushed = NULL;
+
+		while (tail != head) {
+			input_thread_event_t *entry =
+				&ring[tail & (INPUT_THREAD_RING_SIZE - 1)];
+
+			if ((entry->callback != flushed) &&
+			    (entry->callback(&entry->ev,
+					     sizeof (entry->ev)) == TRUE))
+				flushed = entry->callback;
+
+			tail++;
+		}
+
+		/* Hand the slots back to the input thread */
+		g_atomic_int_set(&ring_tail, (gint)tail);
+	}
+
+	mce_wakeups_end();
+
+	return TRUE;
+}
+
+/**
+ * Let the input thread read an input device
+ * The caller must stop reading the device itself,
+ * and must call mce_input_thread_remove_device()
+ * before closing the file descriptor
+ *
+ * @param fd The file descriptor of the device
+ * @param callback Function to call from the mainloop for each event
+ * @return TRUE on success, FALSE if the input thread isn't running
+ *         or cannot read any more devices
+ */
+gboolean mce_input_thread_add_device(int fd, iomon_cb callback)
+{
+	gboolean status = FALSE;
+	guint i;
+
+	if ((input_thread_running == FALSE) || (fd == -1))
+		goto EXIT;
+
+	pthread_mutex_lock(&device_mutex);
+
+	for (i = 0; i < INPUT_THREAD_MAX_DEVICES; i++) {
+		if (devices[i].fd == -1) {
+			devices[i].fd = fd;
+			devices[i].callback = callback;
+			device_generation++;
+			status = TRUE;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&device_mutex);
+
+	if (status == TRUE)
+		poke_pipe(control_fds[1]);
+	else
+		mce_log(LL_WARN,
+			"Input thread cannot read more than %d devices",
+			INPUT_THREAD_MAX_DEVICES);
+
+EXIT:
+	return status;
+}
+
+/**
+ * Stop the input thread from reading an input device
+ * Non-existing devices are silently ignored
+ *
+ * @param fd The file descriptor of the device
+ */
+void mce_input_thread_remove_device(int fd)
+{
+	gboolean removed = FALSE;
+	guint i;
+
+	if ((input_thread_running == FALSE) || (fd == -1))
+		goto EXIT;
+
+	pthread_mutex_lock(&device_mutex);
+
+	for (i = 0; i < INPUT_THREAD_MAX_DEVICES; i++) {
+		if (devices[i].fd == fd) {
+			devices[i].fd = -1;
+			devices[i].callback = NULL;
+			device_generation++;
+			removed = TRUE;
+		}
+	}
+
+	pthread_mutex_unlock(&device_mutex);
+
+	if (removed == TRUE)
+		poke_pipe(control_fds[1]);
+
+EXIT:
+	return;
+}
+
+/**
+ * Close the pipes used by the input thread
+ */
+static void close_pipes(void)
+{
+	guint i;
+
+	if (wakeup_source_id != 0) {
+		g_source_remove(wakeup_source_id);
+		wakeup_source_id = 0;
+	}
+
+	if (wakeup_iochan != NULL) {
+		g_io_channel_unref(wakeup_iochan);
+		wakeup_iochan = NULL;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (wakeup_fds[i] != -1) {
+			close(wakeup_fds[i]);
+			wakeup_fds[i] = -1;
+		}
+
+		if (control_fds[i] != -1) {
+			close(control_fds[i]);
+			control_fds[i] = -1;
+		}
+	}
+}
+
+/**
+ * Init function for the input thread
+ *
+ * @param priority The SCHED_FIFO priority of the thread;
+ *                 0 to use normal scheduling
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_input_thread_init(gint priority)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	gboolean status = FALSE;
+	int err;
+	guint i;
+
+	for (i = 0; i < INPUT_THREAD_MAX_DEVICES; i++)
+		devices[i].fd = -1;
+
+	if ((pipe(wakeup_fds) == -1) || (pipe(control_fds) == -1)) {
+		mce_log(LL_ERR,
+			"Failed to create pipes for the input thread; %s",
+			g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	if ((set_nonblocking(wakeup_fds[0]) == FALSE) ||
+	    (set_nonblocking(wakeup_fds[1]) == FALSE) ||
+	    (set_nonblocking(control_fds[0]) == FALSE) ||
+	    (set_nonblocking(control_fds[1]) == FALSE)) {
+		mce_log(LL_ERR,
+			"Failed to set up pipes for the input thread; %s",
+			g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	if ((wakeup_iochan = g_io_channel_unix_new(wakeup_fds[0])) == NULL) {
+		mce_log(LL_ERR,
+			"Failed to set up I/O channel for the input thread");
+		goto EXIT;
+	}
+
+	/* Input takes precedence over anything else in the mainloop */
+	wakeup_source_id = g_io_add_watch_full(wakeup_iochan,
+					       G_PRIORITY_HIGH, G_IO_IN,
+					       input_thread_wakeup_cb,
+					       NULL, NULL);
+
+	pthread_attr_init(&attr);
+
+	if (priority > 0) {
+		memset(&param, 0, sizeof (param));
+		param.sched_priority = priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+
+	if (((err = pthread_create(&input_thread, &attr,
+				   input_thread_main, NULL)) != 0) &&
+	    (priority > 0)) {
+		mce_log(LL_WARN,
+			"Failed to create real-time input thread; %s; "
+			"falling back to normal priority",
+			g_strerror(err));
+		err = pthread_create(&input_thread, NULL,
+				     input_thread_main, NULL);
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if (err != 0) {
+		mce_log(LL_ERR,
+			"Failed to create input thread; %s",
+			g_strerror(err));
+		goto EXIT;
+	}
+
+	input_thread_running = TRUE;
+	status = TRUE;
+
+EXIT:
+	if (status == FALSE)
+		close_pipes();
+
+	return status;
+}
+
+/**
+ * Exit function for the input thread
+ */
+void mce_input_thread_exit(void)
+{
+	if (input_thread_running == TRUE) {
+		g_atomic_int_set(&thread_quit, 1);
+		poke_pipe(control_fds[1]);
+		pthread_join(input_thread, NULL);
+		input_thread_running = FALSE;
+	}
+
+	close_pipes();
+
+	return;
+}
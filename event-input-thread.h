@@ -0,0 +1,62 @@
+/**
+ * @file event-input-thread.h
+ * Headers for the input reader thread for the Mode Control Entity
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _EVENT_INPUT_THREAD_H_
+#define _EVENT_INPUT_THREAD_H_
+
+#include <glib.h>
+
+#include "mce-io.h"			/* iomon_cb */
+
+/**
+ * Number of events the ring between the input thread
+ * and the mainloop can hold; must be a power of two
+ */
+#define INPUT_THREAD_RING_SIZE		256
+
+/** Maximum number of input devices read by the input thread */
+#define INPUT_THREAD_MAX_DEVICES	16
+
+/**
+ * Delay before retrying reads when the ring is full;
+ * the events stay queued in the kernel meanwhile; 10 milliseconds
+ */
+#define INPUT_THREAD_RETRY_DELAY	10
+
+/** Name of input thread configuration group */
+#define MCE_CONF_INPUT_THREAD_GROUP	"InputThread"
+
+/** Name of configuration key for enabling the input thread */
+#define MCE_CONF_INPUT_THREAD_ENABLED	"Enabled"
+
+/** Name of configuration key for the input thread real-time priority */
+#define MCE_CONF_INPUT_THREAD_PRIORITY	"Priority"
+
+/** Default input thread policy */
+#define DEFAULT_INPUT_THREAD_ENABLED	FALSE
+
+/** Default input thread SCHED_FIFO priority; 0 for normal scheduling */
+#define DEFAULT_INPUT_THREAD_PRIORITY	10
+
+gboolean mce_input_thread_add_device(int fd, iomon_cb callback);
+void mce_input_thread_remove_device(int fd);
+
+gboolean mce_input_thread_init(gint priority);
+void mce_input_thread_exit(void);
+
+#endif /* _EVENT_INPUT_THREAD_H_ */
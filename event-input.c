@@ -32,10 +32,19 @@
 #include <dirent.h>			/* opendir(), readdir(), telldir() */
 #include <string.h>			/* strcmp() */
 #include <unistd.h>			/* close() */
+#include <time.h>			/* CLOCK_MONOTONIC */
 #include <sys/ioctl.h>			/* ioctl() */
 #include <sys/types.h>			/* DIR */
+#include <sys/socket.h>			/* socket(), bind(), recvfrom(),
+					 * PF_NETLINK, SOCK_DGRAM
+					 */
+#include <linux/netlink.h>		/* struct sockaddr_nl,
+					 * NETLINK_KOBJECT_UEVENT
+					 */
 #include <linux/input.h>		/* struct input_event,
 					 * EVIOCGNAME, EVIOCGBIT, EVIOCGSW,
+					 * EVIOCGKEY, EVIOCGRAB,
+					 * EVIOCSCLOCKID,
 					 * EV_ABS, EV_KEY, EV_SW,
 					 * ABS_PRESSURE,
 					 * SW_CAMERA_LENS_COVER,
@@ -80,10 +89,20 @@
 					 * string_to_bitfield()
 					 */
 #include "mce-log.h"			/* mce_log(), LL_* */
-#include "mce-conf.h"			/* mce_conf_get_int(),
+#include "mce-timer.h"			/* mce_timer_add(),
+					 * mce_timer_add_seconds(),
+					 * mce_timer_remove()
+					 */
+#include "mce-conf.h"			/* mce_conf_get_bool(),
+					 * mce_conf_get_int(),
 					 * mce_conf_get_string()
 					 */
 #include "datapipe.h"			/* execute_datapipe() */
+#include "event-input-thread.h"		/* mce_input_thread_init(),
+					 * mce_input_thread_exit(),
+					 * mce_input_thread_add_device(),
+					 * mce_input_thread_remove_device()
+					 */
 
 /** ID for touchscreen I/O monitor timeout source */
 static guint touchscreen_io_monitor_timeout_cb_id = 0;
@@ -108,13 +127,43 @@ static GFileMonitor *dev_input_gfmp = NULL;
 /** The handler ID for the signal handler */
 static gulong dev_input_handler_id = 0;
 
+/** Netlink socket for kernel uevents */
+static int uevent_fd = -1;
+/** I/O channel for the uevent socket */
+static GIOChannel *uevent_iochan = NULL;
+/** ID for the uevent I/O watch */
+static guint uevent_source_id = 0;
+
+/**
+ * Input device changes waiting to be processed;
+ * device path -> TRUE (added) / FALSE (removed) stored in a pointer
+ */
+static GHashTable *pending_inputdevices = NULL;
+/** Rescan all input devices instead of processing the pending changes? */
+static gboolean inputdevice_rescan_pending = FALSE;
+/** ID for input device hotplug timeout source */
+static guint input_hotplug_timeout_cb_id = 0;
+
 /** Time in milliseconds before the key press is considered long */
 static gint longdelay = DEFAULT_HOME_LONG_DELAY;
 
 /** Can GPIO key interrupts be disabled? */
 static gboolean gpio_key_disable_exists = FALSE;
 
+/** Grab the touchscreen/keypad while the event eater is active? */
+static gboolean eveater_grab_input = DEFAULT_EVEATER_GRAB_INPUT;
+
+/** Are the touchscreen/keypad grabbed by the event eater? */
+static gboolean eveater_grab_active = FALSE;
+
+/** Are the touchscreen/keypad read by the input thread? */
+static gboolean input_thread_enabled = FALSE;
+
 static void update_inputdevices(const gchar *device, gboolean add);
+static gboolean scan_inputdevices(void);
+static void unregister_inputdevices(void);
+static void update_switch_states(void);
+static gboolean init_dev_input_monitor(void);
 
 static time_t prev_handled_touchscreen_activity_seconds = 0;
 
@@ -239,6 +288,7 @@ static void unregister_io_monitor(gpointer io_monitor, gpointer user_data)
 
 	(void)user_data;
 
+	mce_input_thread_remove_device(fd);
 	mce_unregister_io_monitor(io_monitor);
 
 	/* Close the fd if there is one */
@@ -254,13 +304,128 @@ static void unregister_io_monitor(gpointer io_monitor, gpointer user_data)
 	}
 }
 
+/**
+ * Check whether any key is held down on an input device
+ *
+ * @param fd The file descriptor of the input device
+ * @return TRUE if a key is held down or the key state cannot be read,
+ *         FALSE if no keys are held down
+ */
+static gboolean keys_held_down(int fd)
+{
+	gulong *statelist = NULL;
+	gsize statelistlen;
+	gboolean status = TRUE;
+	gsize i;
+
+	statelistlen = (KEY_CNT / bitsize_of(*statelist)) +
+		       ((KEY_CNT % bitsize_of(*statelist)) ? 1 : 0);
+	statelist = g_malloc0(statelistlen * sizeof (*statelist));
+
+	if (ioctl(fd, EVIOCGKEY(statelistlen * sizeof (*statelist)),
+		  statelist) == -1) {
+		errno = 0;
+		goto EXIT;
+	}
+
+	for (i = 0; i < statelistlen; i++) {
+		if (statelist[i] != 0)
+			goto EXIT;
+	}
+
+	status = FALSE;
+
+EXIT:
+	g_free(statelist);
+
+	return status;
+}
+
+/**
+ * Grab or release an input device on behalf of the event eater
+ *
+ * @param io_monitor The I/O monitor of the device
+ * @param user_data TRUE stored in a pointer to grab the device,
+ *                  FALSE stored in a pointer to release it
+ */
+static void grab_io_monitor(gpointer io_monitor, gpointer user_data)
+{
+	const gchar *filename = mce_get_io_monitor_name(io_monitor);
+	int fd = mce_get_io_monitor_fd(io_monitor);
+	int grab = GPOINTER_TO_INT(user_data);
+
+	if (fd == -1)
+		goto EXIT;
+
+	/* Never grab a device that has keys held down;
+	 * nobody else would see the matching release
+	 */
+	if ((grab != 0) && (keys_held_down(fd) == TRUE)) {
+		mce_log(LL_DEBUG,
+			"Not grabbing `%s'; keys held down",
+			filename);
+		goto EXIT;
+	}
+
+	/* Releasing a device that we failed to grab gives EINVAL;
+	 * that is harmless, so only complain about failed grabs
+	 */
+	if (ioctl(fd, EVIOCGRAB, grab) == -1) {
+		mce_log((grab != 0) ? LL_WARN : LL_DEBUG,
+			"ioctl(EVIOCGRAB, %d) failed on `%s'; %s",
+			grab, filename, g_strerror(errno));
+		errno = 0;
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Grab or release the touchscreen and keypad devices
+ *
+ * While grabbed, the events are only delivered to MCE;
+ * this keeps the compositor from waking up for events
+ * that the event eater would swallow anyway
+ *
+ * @param grab TRUE to grab the devices, FALSE to release them
+ */
+static void set_eveater_grab(gboolean grab)
+{
+	if (eveater_grab_active == grab)
+		goto EXIT;
+
+	eveater_grab_active = grab;
+
+	g_slist_foreach(touchscreen_dev_list,
+			(GFunc)grab_io_monitor, GINT_TO_POINTER(grab));
+	g_slist_foreach(keyboard_dev_list,
+			(GFunc)grab_io_monitor, GINT_TO_POINTER(grab));
+
+	mce_log(LL_DEBUG, "%s input devices for the event eater",
+		(grab == TRUE) ? "Grabbed" : "Released");
+
+EXIT:
+	return;
+}
+
+/**
+ * The event eater has swallowed its input;
+ * release the input devices and leave event eater mode
+ */
+static void eveater_input_consumed(void)
+{
+	set_eveater_grab(FALSE);
+	mce_rem_submode_int32(MCE_EVEATER_SUBMODE);
+}
+
 /**
  * Cancel timeout for touchscreen I/O monitor reprogramming
  */
 static void cancel_touchscreen_io_monitor_timeout(void)
 {
 	if (touchscreen_io_monitor_timeout_cb_id != 0) {
-		g_source_remove(touchscreen_io_monitor_timeout_cb_id);
+		mce_timer_remove(touchscreen_io_monitor_timeout_cb_id);
 		touchscreen_io_monitor_timeout_cb_id = 0;
 	}
 }
@@ -287,6 +452,33 @@ static gboolean touchscreen_iomon_cb(gpointer data, gsize bytes_read)
 		goto EXIT;
 	}
 
+	/* While the event eater holds the grab nobody else sees
+	 * the events; only watch for the touch (or double tap)
+	 * that ends event eater mode
+	 */
+	if (eveater_grab_active == TRUE) {
+		if ((ev->type == EV_KEY) && (ev->code == BTN_TOUCH)) {
+			(void)execute_datapipe(&device_inactive_pipe,
+					       GINT_TO_POINTER(FALSE),
+					       USE_INDATA, CACHE_INDATA);
+
+			if (ev->value == 0) {
+				eveater_input_consumed();
+				flush = TRUE;
+			}
+		} else if ((ev->type == EV_MSC) &&
+			   (ev->code == MSC_GESTURE) &&
+			   (ev->value == 0x4)) {
+			(void)execute_datapipe(&device_inactive_pipe,
+					       GINT_TO_POINTER(FALSE),
+					       USE_INDATA, CACHE_INDATA);
+			eveater_input_consumed();
+			flush = TRUE;
+		}
+
+		goto EXIT;
+	}
+
 	/* Ignore unwanted events */
 	if ((ev->type != EV_ABS) &&
 	    (ev->type != EV_KEY) &&
@@ -360,7 +552,7 @@ static gboolean keypress_repeat_timeout_cb(gpointer data)
 static void cancel_keypress_repeat_timeout(void)
 {
 	if (keypress_repeat_timeout_cb_id != 0) {
-		g_source_remove(keypress_repeat_timeout_cb_id);
+		mce_timer_remove(keypress_repeat_timeout_cb_id);
 		keypress_repeat_timeout_cb_id = 0;
 	}
 }
@@ -374,7 +566,7 @@ static void setup_keypress_repeat_timeout(void)
 
 	/* Setup new timeout */
 	keypress_repeat_timeout_cb_id =
-		g_timeout_add_seconds(MONITORING_DELAY,
+		mce_timer_add_seconds(MONITORING_DELAY,
 				      keypress_repeat_timeout_cb, NULL);
 }
 
@@ -495,6 +687,14 @@ static gboolean keypress_iomon_cb(gpointer data, gsize bytes_read)
 		}
 	}
 
+	/* With the keypad grabbed, the event eater has swallowed
+	 * its keypress once the key is released
+	 */
+	if ((eveater_grab_active == TRUE) &&
+	    (ev->type == EV_KEY) && (ev->value == 0)) {
+		eveater_input_consumed();
+	}
+
 EXIT:
 	return FALSE;
 }
@@ -526,7 +726,7 @@ static gboolean misc_io_monitor_timeout_cb(gpointer data)
 static void cancel_misc_io_monitor_timeout(void)
 {
 	if (misc_io_monitor_timeout_cb_id != 0) {
-		g_source_remove(misc_io_monitor_timeout_cb_id);
+		mce_timer_remove(misc_io_monitor_timeout_cb_id);
 		misc_io_monitor_timeout_cb_id = 0;
 	}
 }
@@ -540,7 +740,7 @@ static void setup_misc_io_monitor_timeout(void)
 
 	/* Setup new timeout */
 	misc_io_monitor_timeout_cb_id =
-		g_timeout_add_seconds(MONITORING_DELAY,
+		mce_timer_add_seconds(MONITORING_DELAY,
 				      misc_io_monitor_timeout_cb, NULL);
 }
 
@@ -731,6 +931,32 @@ EXIT:
 	return fd;
 }
 
+/**
+ * Make an event device timestamp its events using the monotonic clock,
+ * so that the age of an event is not affected by wall clock changes;
+ * if the kernel does not support this, the events keep their
+ * wall clock timestamps
+ *
+ * @param fd The file descriptor of the event device
+ * @param filename The name of the event file
+ */
+static void set_monotonic_event_clock(int fd, const gchar *const filename)
+{
+#ifdef EVIOCSCLOCKID
+	int clockid = CLOCK_MONOTONIC;
+
+	if (ioctl(fd, EVIOCSCLOCKID, &clockid) == -1) {
+		mce_log(LL_WARN,
+			"ioctl(EVIOCSCLOCKID) failed on `%s'; %s",
+			filename, g_strerror(errno));
+		errno = 0;
+	}
+#else
+	(void)fd;
+	(void)filename;
+#endif /* EVIOCSCLOCKID */
+}
+
 /**
  * Custom compare function used to find I/O monitor entries
  *
@@ -764,6 +990,28 @@ static void misc_err_cb(gpointer iomon, GIOCondition condition)
 	}
 }
 
+/**
+ * Let the input thread read the device of an I/O monitor
+ * If the input thread is not in use, or cannot take the device,
+ * the I/O monitor keeps reading it from the mainloop
+ *
+ * @param io_monitor The I/O monitor
+ * @param callback The callback of the I/O monitor
+ */
+static void hand_over_to_input_thread(gconstpointer io_monitor,
+				      iomon_cb callback)
+{
+	if (input_thread_enabled == FALSE)
+		goto EXIT;
+
+	if (mce_input_thread_add_device(mce_get_io_monitor_fd(io_monitor),
+					callback) == TRUE)
+		mce_suspend_io_monitor(io_monitor);
+
+EXIT:
+	return;
+}
+
 /**
  * Match and register I/O monitor
  */
@@ -801,6 +1049,11 @@ static void match_and_register_io_monitor(const gchar *filename)
 			}
 		} else {
 			touchscreen_dev_list = g_slist_prepend(touchscreen_dev_list, (gpointer)iomon);
+			hand_over_to_input_thread(iomon, touchscreen_iomon_cb);
+
+			if (eveater_grab_active == TRUE)
+				grab_io_monitor((gpointer)iomon,
+						GINT_TO_POINTER(TRUE));
 		}
 	} else if ((fd = match_event_file(filename, keyboard_event_drivers)) != -1) {
 		gconstpointer iomon = NULL;
@@ -819,7 +1072,14 @@ static void match_and_register_io_monitor(const gchar *filename)
 				errno = 0;
 			}
 		} else {
+			/* The [power] key handling measures the event age */
+			set_monotonic_event_clock(fd, filename);
 			keyboard_dev_list = g_slist_prepend(keyboard_dev_list, (gpointer)iomon);
+			hand_over_to_input_thread(iomon, keypress_iomon_cb);
+
+			if (eveater_grab_active == TRUE)
+				grab_io_monitor((gpointer)iomon,
+						GINT_TO_POINTER(TRUE));
 		}
 	} else {
 		gconstpointer iomon = NULL;
@@ -864,6 +1124,7 @@ static void update_inputdevices(const gchar *device, gboolean add)
 		iomon_id = list_entry->data;
 		touchscreen_dev_list = g_slist_remove(touchscreen_dev_list,
 						      iomon_id);
+		mce_input_thread_remove_device(mce_get_io_monitor_fd(iomon_id));
 		mce_unregister_io_monitor(iomon_id);
 	}
 
@@ -878,6 +1139,7 @@ static void update_inputdevices(const gchar *device, gboolean add)
 		iomon_id = list_entry->data;
 		keyboard_dev_list = g_slist_remove(keyboard_dev_list,
 						   iomon_id);
+		mce_input_thread_remove_device(mce_get_io_monitor_fd(iomon_id));
 		mce_unregister_io_monitor(iomon_id);
 	}
 
@@ -985,6 +1247,282 @@ static void unregister_inputdevices(void)
 	}
 }
 
+/**
+ * Process a pending input device change
+ * Wrapper for update_inputdevices() to use from g_hash_table_foreach()
+ *
+ * @param key The path of the device
+ * @param value TRUE if the device was added, FALSE if it was removed,
+ *              stored in a pointer
+ * @param user_data Unused
+ */
+static void process_inputdevice_update(gpointer key, gpointer value,
+				       gpointer user_data)
+{
+	(void)user_data;
+
+	update_inputdevices(key, GPOINTER_TO_INT(value));
+}
+
+/**
+ * Timeout callback for input device hotplug;
+ * processes the changes collected since the timeout was set up
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean input_hotplug_timeout_cb(gpointer data)
+{
+	(void)data;
+
+	input_hotplug_timeout_cb_id = 0;
+
+	if (inputdevice_rescan_pending == TRUE) {
+		/* We lost track of the changes; start over */
+		mce_log(LL_DEBUG, "Rescanning input devices");
+		unregister_inputdevices();
+		(void)scan_inputdevices();
+		update_switch_states();
+		inputdevice_rescan_pending = FALSE;
+	} else {
+		mce_log(LL_DEBUG, "Processing %u input device changes",
+			g_hash_table_size(pending_inputdevices));
+		g_hash_table_foreach(pending_inputdevices,
+				     process_inputdevice_update, NULL);
+	}
+
+	g_hash_table_remove_all(pending_inputdevices);
+
+	return FALSE;
+}
+
+/**
+ * Cancel timeout for input device hotplug
+ */
+static void cancel_input_hotplug_timeout(void)
+{
+	if (input_hotplug_timeout_cb_id != 0) {
+		mce_timer_remove(input_hotplug_timeout_cb_id);
+		input_hotplug_timeout_cb_id = 0;
+	}
+}
+
+/**
+ * Setup timeout for input device hotplug
+ *
+ * The timeout is not restarted by further changes; a burst of
+ * changes is handled at most INPUT_HOTPLUG_DELAY after it started
+ */
+static void setup_input_hotplug_timeout(void)
+{
+	if (input_hotplug_timeout_cb_id != 0)
+		goto EXIT;
+
+	input_hotplug_timeout_cb_id =
+		mce_timer_add(INPUT_HOTPLUG_DELAY,
+			      input_hotplug_timeout_cb, NULL);
+
+EXIT:
+	return;
+}
+
+/**
+ * Queue an input device change
+ * Only the last change for each device is kept,
+ * so a device that comes and goes within the window
+ * is matched at most once
+ *
+ * @param device The device that was added/removed
+ * @param add TRUE if the device was added, FALSE if it was removed
+ */
+static void queue_inputdevice_update(const gchar *device, gboolean add)
+{
+	g_hash_table_replace(pending_inputdevices,
+			     g_strdup(device), GINT_TO_POINTER(add));
+	setup_input_hotplug_timeout();
+}
+
+/**
+ * Close the uevent socket
+ */
+static void close_uevent_socket(void)
+{
+	if (uevent_source_id != 0) {
+		g_source_remove(uevent_source_id);
+		uevent_source_id = 0;
+	}
+
+	if (uevent_iochan != NULL) {
+		g_io_channel_unref(uevent_iochan);
+		uevent_iochan = NULL;
+	}
+
+	if (uevent_fd != -1) {
+		if (close(uevent_fd) == -1) {
+			mce_log(LL_ERR,
+				"Failed to close uevent socket; %s",
+				g_strerror(errno));
+			errno = 0;
+		}
+
+		uevent_fd = -1;
+	}
+}
+
+/**
+ * Callback for kernel uevents
+ *
+ * A uevent is an "ACTION@DEVPATH" header followed by
+ * NUL-separated KEY=value pairs; only additions and removals
+ * of input event devices are of interest to us
+ *
+ * @param source Unused
+ * @param condition The I/O condition
+ * @param data Unused
+ * @return TRUE to keep listening, FALSE if the socket failed
+ */
+static gboolean uevent_cb(GIOChannel *source, GIOCondition condition,
+			  gpointer data)
+{
+	static gchar buf[UEVENT_BUFFER_SIZE];
+	const gchar *action = NULL;
+	const gchar *subsystem = NULL;
+	const gchar *devname = NULL;
+	struct sockaddr_nl snl;
+	socklen_t snllen = sizeof (snl);
+	gboolean status = TRUE;
+	gchar *filename = NULL;
+	ssize_t len;
+	ssize_t i;
+
+	(void)source;
+	(void)data;
+
+	if ((condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) != 0) {
+		mce_log(LL_ERR,
+			"uevent socket failed; "
+			"falling back to monitoring `%s'",
+			DEV_INPUT_PATH);
+		uevent_source_id = 0;
+		close_uevent_socket();
+
+		/* We might have missed changes */
+		inputdevice_rescan_pending = TRUE;
+		setup_input_hotplug_timeout();
+		(void)init_dev_input_monitor();
+		status = FALSE;
+		goto EXIT;
+	}
+
+	if ((len = recvfrom(uevent_fd, buf, sizeof (buf) - 1, MSG_DONTWAIT,
+			    (struct sockaddr *)&snl, &snllen)) == -1) {
+		/* The socket buffer overflowed; we don't know
+		 * what we missed, so rescan everything
+		 */
+		if (errno == ENOBUFS) {
+			mce_log(LL_WARN,
+				"uevent socket overflow; "
+				"rescanning input devices");
+			inputdevice_rescan_pending = TRUE;
+			setup_input_hotplug_timeout();
+		}
+
+		errno = 0;
+		goto EXIT;
+	}
+
+	/* Only trust messages sent by the kernel */
+	if ((snllen != sizeof (snl)) || (snl.nl_pid != 0))
+		goto EXIT;
+
+	buf[len] = '\0';
+
+	for (i = strlen(buf) + 1; i < len; i += strlen(buf + i) + 1) {
+		const gchar *entry = buf + i;
+
+		if (strncmp(entry, "ACTION=", strlen("ACTION=")) == 0)
+			action = entry + strlen("ACTION=");
+		else if (strncmp(entry, "SUBSYSTEM=",
+				 strlen("SUBSYSTEM=")) == 0)
+			subsystem = entry + strlen("SUBSYSTEM=");
+		else if (strncmp(entry, "DEVNAME=", strlen("DEVNAME=")) == 0)
+			devname = entry + strlen("DEVNAME=");
+	}
+
+	if ((action == NULL) || (subsystem == NULL) || (devname == NULL))
+		goto EXIT;
+
+	if ((strcmp(subsystem, "input") != 0) ||
+	    (strncmp(devname, UEVENT_DEVNAME_PREFIX,
+		     strlen(UEVENT_DEVNAME_PREFIX)) != 0))
+		goto EXIT;
+
+	/* DEVNAME is relative to /dev */
+	filename = g_strconcat(DEV_INPUT_PATH, "/",
+			       devname + strlen("input/"), NULL);
+
+	if (strcmp(action, "add") == 0) {
+		queue_inputdevice_update(filename, TRUE);
+	} else if (strcmp(action, "remove") == 0) {
+		queue_inputdevice_update(filename, FALSE);
+	}
+
+EXIT:
+	g_free(filename);
+
+	return status;
+}
+
+/**
+ * Open a netlink socket to listen for kernel uevents
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean init_uevent_socket(void)
+{
+	struct sockaddr_nl snl;
+	gboolean status = FALSE;
+
+	if ((uevent_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+				NETLINK_KOBJECT_UEVENT)) == -1) {
+		mce_log(LL_WARN,
+			"Failed to open uevent socket; %s",
+			g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	memset(&snl, 0, sizeof (snl));
+	snl.nl_family = AF_NETLINK;
+	snl.nl_groups = UEVENT_KERNEL_GROUP;
+
+	if (bind(uevent_fd, (struct sockaddr *)&snl, sizeof (snl)) == -1) {
+		mce_log(LL_WARN,
+			"Failed to bind uevent socket; %s",
+			g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	if ((uevent_iochan = g_io_channel_unix_new(uevent_fd)) == NULL) {
+		mce_log(LL_WARN,
+			"Failed to set up I/O channel for uevent socket");
+		goto EXIT;
+	}
+
+	uevent_source_id = g_io_add_watch(uevent_iochan,
+					  G_IO_IN | G_IO_ERR | G_IO_HUP,
+					  uevent_cb, NULL);
+
+	status = TRUE;
+
+EXIT:
+	if (status == FALSE)
+		close_uevent_socket();
+
+	return status;
+}
+
 /**
  * Callback for directory changes
  *
@@ -1014,11 +1552,11 @@ static void dir_changed_cb(GFileMonitor *monitor,
 
 	switch (event_type) {
 	case G_FILE_MONITOR_EVENT_CREATED:
-		update_inputdevices(filepath, TRUE);
+		queue_inputdevice_update(filepath, TRUE);
 		break;
 
 	case G_FILE_MONITOR_EVENT_DELETED:
-		update_inputdevices(filepath, FALSE);
+		queue_inputdevice_update(filepath, FALSE);
 		break;
 
 	default:
@@ -1032,6 +1570,63 @@ EXIT:
 	return;
 }
 
+/**
+ * Monitor the input device directory for changes
+ * Used as a fallback when kernel uevents are not available
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean init_dev_input_monitor(void)
+{
+	GError *error = NULL;
+	gboolean status = FALSE;
+
+	if (dev_input_gfmp != NULL) {
+		status = TRUE;
+		goto EXIT;
+	}
+
+	/* Retrieve a GFile pointer to the directory to monitor */
+	if (dev_input_gfp == NULL)
+		dev_input_gfp = g_file_new_for_path(DEV_INPUT_PATH);
+
+	/* Monitor the directory */
+	if ((dev_input_gfmp = g_file_monitor_directory(dev_input_gfp,
+						       G_FILE_MONITOR_NONE,
+						       NULL, &error)) == NULL) {
+		mce_log(LL_ERR,
+			"Failed to add monitor for directory `%s'; %s",
+			DEV_INPUT_PATH, error->message);
+		goto EXIT;
+	}
+
+	/* Connect "changed" signal for the directory monitor */
+	dev_input_handler_id =
+		g_signal_connect(G_OBJECT(dev_input_gfmp), "changed",
+				 G_CALLBACK(dir_changed_cb), NULL);
+
+	status = TRUE;
+
+EXIT:
+	g_clear_error(&error);
+
+	return status;
+}
+
+/**
+ * Stop monitoring the input device directory
+ */
+static void exit_dev_input_monitor(void)
+{
+	if (dev_input_gfmp != NULL) {
+		g_signal_handler_disconnect(G_OBJECT(dev_input_gfmp),
+					    dev_input_handler_id);
+		dev_input_handler_id = 0;
+		g_file_monitor_cancel(dev_input_gfmp);
+		dev_input_gfmp = NULL;
+	}
+}
+
 /**
  * Handle submode change
  *
@@ -1057,6 +1652,17 @@ static void submode_trigger(gconstpointer data)
 		}
 	}
 
+	/* Hold the input grab for the duration of the event eater */
+	if (eveater_grab_input == TRUE) {
+		if ((submode & MCE_EVEATER_SUBMODE) != 0) {
+			if ((old_submode & MCE_EVEATER_SUBMODE) == 0)
+				set_eveater_grab(TRUE);
+		} else {
+			if ((old_submode & MCE_EVEATER_SUBMODE) != 0)
+				set_eveater_grab(FALSE);
+		}
+	}
+
 	old_submode = submode;
 }
 
@@ -1067,56 +1673,67 @@ static void submode_trigger(gconstpointer data)
  */
 gboolean mce_input_init(void)
 {
-	GError *error = NULL;
 	gboolean status = FALSE;
 
 	/* Append triggers/filters to datapipes */
 	append_output_trigger_to_datapipe(&submode_pipe,
 					  submode_trigger);
 
-	/* Retrieve a GFile pointer to the directory to monitor */
-	dev_input_gfp = g_file_new_for_path(DEV_INPUT_PATH);
+	pending_inputdevices = g_hash_table_new_full(g_str_hash, g_str_equal,
+						     g_free, NULL);
 
-	/* Monitor the directory */
-	if ((dev_input_gfmp = g_file_monitor_directory(dev_input_gfp,
-						       G_FILE_MONITOR_NONE,
-						       NULL, &error)) == NULL) {
-		mce_log(LL_ERR,
-			"Failed to add monitor for directory `%s'; %s",
-			DEV_INPUT_PATH, error->message);
-		goto EXIT;
+	/* Listen for kernel uevents; if that isn't possible,
+	 * fall back to monitoring the input device directory.
+	 * Either way, changes that happen during the initial scan
+	 * are queued and processed once the mainloop runs
+	 */
+	if (init_uevent_socket() == FALSE) {
+		if (init_dev_input_monitor() == FALSE)
+			goto EXIT;
 	}
 
-	/* XXX: There is a race condition here; if a file (dis)appears
-	 *      after this scan, but before we start monitoring,
-	 *      then we'll miss that device.  The race is miniscule though,
-	 *      and any workarounds are likely to be cumbersome
+	/* Read the touchscreen and keypad on a separate thread,
+	 * so that a busy mainloop doesn't delay the input events
 	 */
+	if (mce_conf_get_bool(MCE_CONF_INPUT_THREAD_GROUP,
+			      MCE_CONF_INPUT_THREAD_ENABLED,
+			      DEFAULT_INPUT_THREAD_ENABLED,
+			      NULL) == TRUE) {
+		gint priority =
+			mce_conf_get_int(MCE_CONF_INPUT_THREAD_GROUP,
+					 MCE_CONF_INPUT_THREAD_PRIORITY,
+					 DEFAULT_INPUT_THREAD_PRIORITY,
+					 NULL);
+
+		input_thread_enabled = mce_input_thread_init(priority);
+	}
+
 	/* Find the initial set of input devices */
 	if ((status = scan_inputdevices()) == FALSE) {
-		g_file_monitor_cancel(dev_input_gfmp);
-		dev_input_gfmp = NULL;
+		mce_input_thread_exit();
+		input_thread_enabled = FALSE;
+		close_uevent_socket();
+		exit_dev_input_monitor();
 		goto EXIT;
 	}
 
-	/* Connect "changed" signal for the directory monitor */
-	dev_input_handler_id =
-		g_signal_connect(G_OBJECT(dev_input_gfmp), "changed",
-				 G_CALLBACK(dir_changed_cb), NULL);
-
 	/* Get configuration options */
 	longdelay = mce_conf_get_int(MCE_CONF_HOMEKEY_GROUP,
 				     MCE_CONF_HOMEKEY_LONG_DELAY,
 				     DEFAULT_HOME_LONG_DELAY,
 				     NULL);
 
+	eveater_grab_input = mce_conf_get_bool(MCE_CONF_TKLOCK_GROUP,
+					       MCE_CONF_EVEATER_GRAB_INPUT,
+					       DEFAULT_EVEATER_GRAB_INPUT,
+					       NULL);
+
 	update_switch_states();
 
 	gpio_key_disable_exists = (g_access(GPIO_KEY_DISABLE_PATH, W_OK) == 0);
 
 EXIT:
 	errno = 0;
-	g_clear_error(&error);
 
 	return status;
 }
@@ -1130,12 +1747,14 @@ void mce_input_exit(void)
 	remove_output_trigger_from_datapipe(&submode_pipe,
 					    submode_trigger);
 
-	if (dev_input_gfmp != NULL) {
-		g_signal_handler_disconnect(G_OBJECT(dev_input_gfmp),
-					    dev_input_handler_id);
-		dev_input_handler_id = 0;
-		g_file_monitor_cancel(dev_input_gfmp);
-	}
+	close_uevent_socket();
+	exit_dev_input_monitor();
+
+	set_eveater_grab(FALSE);
+
+	/* Stop the input thread before closing the devices it reads */
+	mce_input_thread_exit();
+	input_thread_enabled = FALSE;
 
 	unregister_inputdevices();
 
@@ -1143,6 +1762,12 @@ void mce_input_exit(void)
 	cancel_touchscreen_io_monitor_timeout();
 	cancel_keypress_repeat_timeout();
 	cancel_misc_io_monitor_timeout();
+	cancel_input_hotplug_timeout();
+
+	if (pending_inputdevices != NULL) {
+		g_hash_table_destroy(pending_inputdevices);
+		pending_inputdevices = NULL;
+	}
 
 	return;
 }
@@ -29,6 +29,12 @@
 #define DEV_INPUT_PATH			"/dev/input"
 /** Prefix for event files */
 #define EVENT_FILE_PREFIX		"event"
+/** DEVNAME prefix of input event devices in uevents */
+#define UEVENT_DEVNAME_PREFIX		"input/" EVENT_FILE_PREFIX
+/** Netlink multicast group for kernel uevents */
+#define UEVENT_KERNEL_GROUP		1
+/** Size of the uevent receive buffer */
+#define UEVENT_BUFFER_SIZE		2048
 /** Path to the GPIO key disable interface */
 #define GPIO_KEY_DISABLE_PATH		"/sys/devices/platform/gpio-keys/disabled_keys"
 
@@ -180,6 +186,12 @@ static const gchar *const driver_blacklist[] = {
  */
 #define MONITORING_DELAY		1
 
+/**
+ * Delay between the first input device change and processing
+ * of all changes collected so far; 100 milliseconds
+ */
+#define INPUT_HOTPLUG_DELAY		100
+
 /** Name of Homekey configuration group */
 #define MCE_CONF_HOMEKEY_GROUP		"HomeKey"
 
@@ -195,6 +207,20 @@ static const gchar *const driver_blacklist[] = {
 /** Long delay for the [home] button in milliseconds */
 #define DEFAULT_HOME_LONG_DELAY		800		/* 0.8 seconds */
 
+#ifndef MCE_CONF_TKLOCK_GROUP
+/** Name of Touchscreen/Keypad lock configuration group */
+#define MCE_CONF_TKLOCK_GROUP		"TKLock"
+#endif /* MCE_CONF_TKLOCK_GROUP */
+
+/**
+ * Name of configuration key for grabbing the touchscreen and keypad
+ * while the event eater is active
+ */
+#define MCE_CONF_EVEATER_GRAB_INPUT	"EventEaterGrabInput"
+
+/** Default event eater input grab policy */
+#define DEFAULT_EVEATER_GRAB_INPUT	FALSE
+
 /* When MCE is made modular, this will be handled differently */
 gboolean mce_input_init(void);
 void mce_input_exit(void);
@@ -32,6 +32,10 @@
 #include "mce-dbus.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-wakeups.h"		/* mce_wakeups_begin(),
+					 * mce_wakeups_end(),
+					 * MCE_WAKEUPS_DBUS
+					 */
 
 /** List of all D-Bus handlers */
 static GSList *dbus_handlers = NULL;
@@ -512,10 +516,17 @@ static DBusHandlerResult msg_handler(DBusConnection *const connection,
 				     gpointer const user_data)
 {
 	guint status = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	const gchar *name;
 
 	(void)connection;
 	(void)user_data;
 
+	/* Errors have no member; use the error name instead */
+	if ((name = dbus_message_get_member(msg)) == NULL)
+		name = dbus_message_get_error_name(msg);
+
+	mce_wakeups_begin(MCE_WAKEUPS_DBUS, name);
+
 	for (msg_handler_iter = dbus_handlers;
 	     msg_handler_iter != NULL;
 	     msg_handler_iter = g_slist_next(msg_handler_iter)) {
@@ -563,6 +574,8 @@ static DBusHandlerResult msg_handler(DBusConnection *const connection,
 	}
 
 EXIT:
+	mce_wakeups_end();
+
 	return status;
 }
 
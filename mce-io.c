@@ -21,7 +21,7 @@
 #include <glib.h>
 #include <glib/gstdio.h>		/* g_access(), g_unlink() */
 
-#include <errno.h>			/* errno, EINVAL, ERANGE */
+#include <errno.h>			/* errno, EINVAL, ERANGE, ENODEV, ESPIPE */
 #include <fcntl.h>			/* open(), O_RDONLY */
 #include <stdio.h>			/* fopen(), fscanf(), fseek(),
                                          * fclose(), fprintf(), fileno(),
@@ -29,12 +29,18 @@
 					 */
 #include <stdlib.h>			/* exit(), strtoul(), EXIT_FAILURE */
 #include <string.h>			/* strlen() */
-#include <unistd.h>			/* close(), read(), ftruncate() */
+#include <unistd.h>			/* close(), read(), pread(),
+					 * ftruncate()
+					 */
 
 #include "mce.h"
 #include "mce-io.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-wakeups.h"		/* mce_wakeups_begin(),
+					 * mce_wakeups_end(),
+					 * MCE_WAKEUPS_IO
+					 */
 
 /** List of all file monitors */
 static GSList *file_monitors = NULL;
@@ -207,6 +213,158 @@ EXIT:
 	return status;
 }
 
+/**
+ * Helper function for closing file descriptors that checks for -1,
+ * prints proper error messages and sets the descriptor to -1 after close
+ *
+ * @param file The name of the file to close; only used by error messages
+ * @param fd A pointer to the file descriptor to close
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_close_fd(const gchar *const file, gint *fd)
+{
+	gboolean status = FALSE;
+
+	if (fd == NULL) {
+		mce_log(LL_CRIT,
+			"fd == NULL!");
+		goto EXIT;
+	}
+
+	if (*fd == -1) {
+		status = TRUE;
+		goto EXIT;
+	}
+
+	if (close(*fd) == -1) {
+		mce_log(LL_ERR,
+			"Failed to close `%s'; %s",
+			file ? file : "<unset>",
+			g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+	} else {
+		status = TRUE;
+	}
+
+	*fd = -1;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Read a chunk from a file into a caller supplied buffer,
+ * keeping the file open between reads
+ *
+ * The file is opened on the first read, and reopened once
+ * if the device has gone away in between (ENODEV);
+ * the chunk is always read from the start of the file
+ *
+ * @param file Path to the file
+ * @param[in,out] fd The file descriptor to use; -1 if not opened yet
+ * @param[in,out] seekable TRUE if the file may support pread();
+ *                         set to FALSE the first time it doesn't,
+ *                         after which it is read with read() directly;
+ *                         should be reset to TRUE along with the fd
+ * @param[out] data The buffer to read the chunk into
+ * @param[in,out] len [in] The length of the buffer to read
+ *                    [out] The number of bytes read
+ * @param flags Additional flags to pass to open();
+ *              by default O_RDONLY is always passed -- this is mainly
+ *              to allow passing O_NONBLOCK
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_pread_chunk_from_file(const gchar *const file, gint *fd,
+				   gboolean *seekable,
+				   void *data, gssize *len, int flags)
+{
+	gboolean status = FALSE;
+	gboolean reopened = FALSE;
+	gint again_count = 0;
+	gssize result = -1;
+
+	if (file == NULL) {
+		mce_log(LL_CRIT, "file == NULL!");
+		goto EXIT;
+	}
+
+	if ((fd == NULL) || (seekable == NULL) ||
+	    (data == NULL) || (len == NULL)) {
+		mce_log(LL_CRIT, "fd, seekable, data or len == NULL!");
+		goto EXIT;
+	}
+
+	if (*len <= 0) {
+		mce_log(LL_CRIT, "*len <= 0!");
+		goto EXIT;
+	}
+
+REOPEN:
+	/* If we cannot open the file, abort */
+	if ((*fd == -1) && ((*fd = open(file, O_RDONLY | flags)) == -1)) {
+		mce_log(LL_ERR,
+			"Cannot open `%s' for reading; %s",
+			file, g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT;
+	}
+
+	while (again_count++ < 10) {
+		/* Clear errors from earlier iterations */
+		errno = 0;
+
+		if (*seekable == TRUE) {
+			result = pread(*fd, data, *len, 0);
+
+			/* Devices that can't seek always return the latest
+			 * chunk; read them directly from now on
+			 */
+			if ((result == -1) && (errno == ESPIPE)) {
+				*seekable = FALSE;
+				errno = 0;
+			}
+		}
+
+		if (*seekable == FALSE)
+			result = read(*fd, data, *len);
+
+		if ((result == -1) &&
+		    ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			continue;
+		} else {
+			break;
+		}
+	}
+
+	if ((result == -1) && (errno == ENODEV) && (reopened == FALSE)) {
+		(void)mce_close_fd(file, fd);
+		reopened = TRUE;
+		again_count = 0;
+		goto REOPEN;
+	}
+
+	if (result == -1) {
+		mce_log(LL_ERR,
+			"Failed to read from `%s'; %s",
+			file, g_strerror(errno));
+
+		/* Ignore error */
+		errno = 0;
+		goto EXIT;
+	}
+
+	*len = result;
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
 /**
  * Read a string from a file
  *
@@ -665,6 +823,9 @@ static gboolean io_string_cb(GIOChannel *source,
 	/* Silence warnings */
 	(void)condition;
 
+	mce_wakeups_begin(MCE_WAKEUPS_IO,
+			  (iomon != NULL) ? iomon->file : NULL);
+
 	if (iomon == NULL) {
 		mce_log(LL_CRIT, "iomon == NULL!");
 		status = FALSE;
@@ -709,6 +870,8 @@ static gboolean io_string_cb(GIOChannel *source,
 	g_clear_error(&error);
 
 EXIT:
+	mce_wakeups_end();
+
 	if ((status == FALSE) &&
 	    (iomon != NULL) &&
 	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
@@ -743,6 +906,9 @@ static gboolean io_chunk_cb(GIOChannel *source,
 	/* Silence warnings */
 	(void)condition;
 
+	mce_wakeups_begin(MCE_WAKEUPS_IO,
+			  (iomon != NULL) ? iomon->file : NULL);
+
 	if (iomon == NULL) {
 		mce_log(LL_CRIT, "iomon == NULL!");
 		status = FALSE;
@@ -833,6 +999,8 @@ static gboolean io_chunk_cb(GIOChannel *source,
 	}
 
 EXIT:
+	mce_wakeups_end();
+
 	if ((status == FALSE) &&
 	    (iomon != NULL) &&
 	    (iomon->error_policy == MCE_IO_ERROR_POLICY_EXIT)) {
@@ -863,6 +1031,9 @@ static gboolean io_error_cb(GIOChannel *source,
 	/* Silence warnings */
 	(void)source;
 
+	mce_wakeups_begin(MCE_WAKEUPS_IO,
+			  (iomon != NULL) ? iomon->file : NULL);
+
 	if (iomon == NULL) {
 		mce_log(LL_CRIT, "iomon == NULL!");
 		goto EXIT;
@@ -913,6 +1084,8 @@ EXIT:
 		iomon->err_callback(iomon, condition);
 	}
 
+	mce_wakeups_end();
+
 	return TRUE;
 }
 
@@ -43,6 +43,10 @@ typedef void (*iomon_err_cb)(gpointer data, GIOCondition condition);
 gboolean mce_close_file(const gchar *const file, FILE **fp);
 gboolean mce_read_chunk_from_file(const gchar *const file, void **data,
 				  gssize *len, int flags);
+gboolean mce_close_fd(const gchar *const file, gint *fd);
+gboolean mce_pread_chunk_from_file(const gchar *const file, gint *fd,
+				   gboolean *seekable,
+				   void *data, gssize *len, int flags);
 gboolean mce_read_string_from_file(const gchar *const file, gchar **string);
 gboolean mce_read_number_string_from_file(const gchar *const file,
 					  gulong *number, FILE **fp,
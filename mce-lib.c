@@ -21,6 +21,7 @@
  */
 #include <glib.h>
 
+#include <time.h>			/* clock_gettime(), CLOCK_MONOTONIC */
 #include <stdio.h>			/* sscanf() */
 #include <string.h>			/* strcmp() */
 
@@ -359,3 +360,23 @@ gboolean strmemcmp(guint8 *mem, const gchar *str, gulong len)
 EXIT:
 	return result;
 }
+
+/**
+ * Get the current monotonic time
+ * Unlike the wall clock time, this is not affected by clock changes
+ *
+ * @return The monotonic time in milliseconds
+ */
+gint64 mce_get_monotonic_time_ms(void)
+{
+	struct timespec ts;
+	gint64 ms = 0;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		goto EXIT;
+
+	ms = ((gint64)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+
+EXIT:
+	return ms;
+}
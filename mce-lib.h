@@ -55,5 +55,7 @@ gchar *strstr_delim(const gchar *const haystack, const char *needle,
 		    const char *const delimiter);
 gboolean strmemcmp(guint8 *mem, const gchar *str, gulong len);
 
+gint64 mce_get_monotonic_time_ms(void);
+
 
 #endif /* _MCE_LIB_H_ */
@@ -0,0 +1,366 @@
+/**
+ * @file mce-sensorhub.c
+ * Shared ALS and proximity sensor reader for the Mode Control Entity
+ * <p>
+ * The Avago (APDS990x) chip reports ambient light and proximity
+ * through a single device node, and the Dipro (BH1770GLC/SFH7770)
+ * chip is powered up by either of its nodes.  Instead of opening,
+ * monitoring and reading the chip once per user, the users attach
+ * to the device node here; the node is opened and monitored once,
+ * each sample is read once, and passed on to every attached user.
+ * The node is kept open, and thus the chip powered, for as long as
+ * any user is attached
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <string.h>			/* strcmp() */
+
+#include "mce.h"
+#include "mce-sensorhub.h"
+
+#include "mce-io.h"			/* mce_register_io_monitor_chunk(),
+					 * mce_unregister_io_monitor(),
+					 * mce_pread_chunk_from_file(),
+					 * mce_close_fd(),
+					 * iomon_cb,
+					 * MCE_IO_ERROR_POLICY_WARN
+					 */
+#include "mce-log.h"			/* mce_log(), LL_* */
+
+/** Maximum number of device nodes in use at the same time */
+#define SENSORHUB_MAX_NODES		SENSORHUB_CHANNELS
+
+/** A device node, shared by the channels attached to it */
+typedef struct {
+	gchar *device;			/**< Path to the node; NULL if unused */
+	gsize chunk_size;		/**< Size of a sample */
+	gint fd;			/**< Descriptor for reads; -1 if none */
+	gboolean seekable;		/**< Does the fd support pread()? */
+	gconstpointer iomon_id;		/**< I/O monitor; NULL if none */
+	guint refcount;			/**< Number of attached channels */
+	gboolean dispatching;		/**< Is a sample being passed on? */
+	guint release_cb_id;		/**< Deferred release; 0 if none */
+} sensorhub_node_t;
+
+/** A user of the sensor */
+typedef struct {
+	sensorhub_node_t *node;		/**< The node; NULL if detached */
+	iomon_cb callback;		/**< Sample callback; NULL if none */
+} sensorhub_user_t;
+
+/** The device nodes */
+static sensorhub_node_t sensorhub_nodes[SENSORHUB_MAX_NODES];
+
+/** The users of the sensor, by channel */
+static sensorhub_user_t sensorhub_users[SENSORHUB_CHANNELS];
+
+/**
+ * Find the node for a device
+ *
+ * @param device Path to the device node
+ * @return The node, or NULL if the device isn't in use
+ */
+static sensorhub_node_t *find_node(const gchar *const device)
+{
+	guint i;
+
+	for (i = 0; i < SENSORHUB_MAX_NODES; i++) {
+		if ((sensorhub_nodes[i].device != NULL) &&
+		    (strcmp(sensorhub_nodes[i].device, device) == 0))
+			return &sensorhub_nodes[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Close a node that has no channels attached any longer
+ *
+ * @param node The node
+ */
+static void release_node(sensorhub_node_t *node)
+{
+	if (node->release_cb_id != 0) {
+		g_source_remove(node->release_cb_id);
+		node->release_cb_id = 0;
+	}
+
+	if (node->iomon_id != NULL) {
+		mce_unregister_io_monitor(node->iomon_id);
+		node->iomon_id = NULL;
+	}
+
+	(void)mce_close_fd(node->device, &node->fd);
+
+	mce_log(LL_DEBUG, "Closed the sensor node `%s'", node->device);
+
+	g_free(node->device);
+	node->device = NULL;
+}
+
+/**
+ * Idle callback for closing a node that was detached from
+ * while it was passing on a sample
+ *
+ * @param data The node
+ * @return Always returns FALSE, this is a one-shot cb
+ */
+static gboolean release_node_cb(gpointer data)
+{
+	sensorhub_node_t *node = data;
+
+	node->release_cb_id = 0;
+
+	if ((node->device != NULL) && (node->refcount == 0))
+		release_node(node);
+
+	return FALSE;
+}
+
+/**
+ * Pass a sample on to all channels attached to a node
+ *
+ * @param node The node the sample was read from
+ * @param data The sample
+ * @param bytes_read The size of the sample
+ * @return TRUE to flush the remaining samples, FALSE otherwise
+ */
+static gboolean dispatch_sample(sensorhub_node_t *node,
+				gpointer data, gsize bytes_read)
+{
+	gboolean flush = FALSE;
+	guint i;
+
+	node->dispatching = TRUE;
+
+	for (i = 0; i < SENSORHUB_CHANNELS; i++) {
+		sensorhub_user_t *user = &sensorhub_users[i];
+
+		if ((user->node != node) || (user->callback == NULL))
+			continue;
+
+		if (user->callback(data, bytes_read) == TRUE)
+			flush = TRUE;
+	}
+
+	node->dispatching = FALSE;
+
+	/* Everyone left; don't read any further samples */
+	if (node->refcount == 0)
+		flush = TRUE;
+
+	return flush;
+}
+
+/**
+ * I/O monitor callback for the first node
+ *
+ * @param data The sample
+ * @param bytes_read The size of the sample
+ * @return TRUE to flush the remaining samples, FALSE otherwise
+ */
+static gboolean node0_iomon_cb(gpointer data, gsize bytes_read)
+{
+	return dispatch_sample(&sensorhub_nodes[0], data, bytes_read);
+}
+
+/**
+ * I/O monitor callback for the second node
+ *
+ * @param data The sample
+ * @param bytes_read The size of the sample
+ * @return TRUE to flush the remaining samples, FALSE otherwise
+ */
+static gboolean node1_iomon_cb(gpointer data, gsize bytes_read)
+{
+	return dispatch_sample(&sensorhub_nodes[1], data, bytes_read);
+}
+
+/** I/O monitor callbacks, by node */
+static const iomon_cb node_iomon_cbs[SENSORHUB_MAX_NODES] = {
+	node0_iomon_cb,
+	node1_iomon_cb
+};
+
+/**
+ * Attach a channel to a device node; the node is opened
+ * if no other channel uses it already
+ *
+ * @param channel The channel to attach
+ * @param device Path to the device node
+ * @param chunk_size The size of a sample
+ * @param callback Called with every sample read from the node;
+ *                 NULL if the channel only reads samples itself
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_sensorhub_attach(sensorhub_channel_t channel,
+			      const gchar *const device,
+			      gsize chunk_size, iomon_cb callback)
+{
+	sensorhub_user_t *user;
+	sensorhub_node_t *node;
+	gboolean status = FALSE;
+	guint i;
+
+	if (((guint)channel >= SENSORHUB_CHANNELS) ||
+	    (device == NULL)) {
+		mce_log(LL_CRIT, "Invalid sensor channel or device");
+		goto EXIT;
+	}
+
+	user = &sensorhub_users[channel];
+
+	/* Re-attaching replaces the earlier attachment */
+	if (user->node != NULL)
+		mce_sensorhub_detach(channel);
+
+	if ((node = find_node(device)) != NULL) {
+		if (node->chunk_size != chunk_size) {
+			mce_log(LL_ERR,
+				"Sample size mismatch for `%s'; "
+				"%zu bytes requested, %zu bytes in use",
+				device, chunk_size, node->chunk_size);
+			goto EXIT;
+		}
+	} else {
+		for (i = 0; i < SENSORHUB_MAX_NODES; i++) {
+			if (sensorhub_nodes[i].device == NULL)
+				break;
+		}
+
+		if (i == SENSORHUB_MAX_NODES) {
+			mce_log(LL_CRIT,
+				"Too many sensor nodes in use; "
+				"cannot open `%s'", device);
+			goto EXIT;
+		}
+
+		node = &sensorhub_nodes[i];
+		node->device = g_strdup(device);
+		node->chunk_size = chunk_size;
+		node->fd = -1;
+		node->seekable = TRUE;
+		node->iomon_id = NULL;
+		node->refcount = 0;
+		node->dispatching = FALSE;
+		node->release_cb_id = 0;
+
+		mce_log(LL_DEBUG, "Opened the sensor node `%s'", device);
+	}
+
+	/* Monitor the node once somebody wants the samples */
+	if ((callback != NULL) && (node->iomon_id == NULL)) {
+		node->iomon_id =
+			mce_register_io_monitor_chunk(-1, device,
+						      MCE_IO_ERROR_POLICY_WARN,
+						      G_IO_IN | G_IO_PRI |
+						      G_IO_ERR, FALSE,
+						      node_iomon_cbs[node - sensorhub_nodes],
+						      chunk_size);
+
+		if (node->iomon_id == NULL) {
+			if (node->refcount == 0)
+				release_node(node);
+
+			goto EXIT;
+		}
+	}
+
+	/* A pending release is no longer needed */
+	if (node->release_cb_id != 0) {
+		g_source_remove(node->release_cb_id);
+		node->release_cb_id = 0;
+	}
+
+	node->refcount++;
+	user->node = node;
+	user->callback = callback;
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Detach a channel from its device node; the node is closed
+ * once no channel uses it any longer
+ *
+ * @param channel The channel to detach
+ */
+void mce_sensorhub_detach(sensorhub_channel_t channel)
+{
+	sensorhub_user_t *user;
+	sensorhub_node_t *node;
+
+	if ((guint)channel >= SENSORHUB_CHANNELS)
+		goto EXIT;
+
+	user = &sensorhub_users[channel];
+
+	if ((node = user->node) == NULL)
+		goto EXIT;
+
+	user->node = NULL;
+	user->callback = NULL;
+
+	if (--node->refcount > 0)
+		goto EXIT;
+
+	/* The I/O monitor can't be removed while it is reading */
+	if (node->dispatching == TRUE) {
+		if (node->release_cb_id == 0)
+			node->release_cb_id = g_idle_add(release_node_cb,
+							 node);
+	} else {
+		release_node(node);
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Read a sample from a device node; if the node is in use,
+ * its descriptor is used, otherwise the node is opened
+ * just for this read
+ *
+ * @param device Path to the device node
+ * @param[out] data The buffer to read the sample into
+ * @param[in,out] len [in] The size of the buffer
+ *                    [out] The number of bytes read
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_sensorhub_read(const gchar *const device,
+			    void *data, gssize *len)
+{
+	sensorhub_node_t *node = find_node(device);
+	gboolean seekable = TRUE;
+	gboolean status;
+	gint fd = -1;
+
+	if (node != NULL)
+		return mce_pread_chunk_from_file(device, &node->fd,
+						 &node->seekable,
+						 data, len, 0);
+
+	status = mce_pread_chunk_from_file(device, &fd, &seekable,
+					   data, len, 0);
+	(void)mce_close_fd(device, &fd);
+
+	return status;
+}
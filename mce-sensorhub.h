@@ -0,0 +1,44 @@
+/**
+ * @file mce-sensorhub.h
+ * Headers for the shared ALS and proximity sensor reader
+ * for the Mode Control Entity
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MCE_SENSORHUB_H_
+#define _MCE_SENSORHUB_H_
+
+#include <glib.h>
+
+#include "mce-io.h"			/* iomon_cb */
+
+/** Users of a combined ambient light and proximity sensor */
+typedef enum {
+	/** The ambient light sensor */
+	SENSORHUB_CHANNEL_ALS = 0,
+	/** The proximity sensor */
+	SENSORHUB_CHANNEL_PS = 1,
+	/** Number of channels */
+	SENSORHUB_CHANNELS
+} sensorhub_channel_t;
+
+gboolean mce_sensorhub_attach(sensorhub_channel_t channel,
+			      const gchar *const device,
+			      gsize chunk_size, iomon_cb callback);
+void mce_sensorhub_detach(sensorhub_channel_t channel);
+gboolean mce_sensorhub_read(const gchar *const device,
+			    void *data, gssize *len);
+
+#endif /* _MCE_SENSORHUB_H_ */
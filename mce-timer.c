@@ -0,0 +1,1094 @@
+/**
+ * @file mce-timer.c
+ * Timeout scheduler for the Mode Control Entity
+ * <p>
+ * Most timeouts in MCE are set up, cancelled and set up again
+ * on every state change or input event; doing that with
+ * g_timeout_add() and g_source_remove() means creating, attaching
+ * and destroying a GSource each time.  This scheduler keeps the
+ * timeouts in a hashed timer wheel instead, so that adding and
+ * removing a timeout is a list operation, and drives all of them
+ * from a single GSource that wakes up only for the nearest deadline.
+ * The deadlines are also kept in a min-heap per timeout class,
+ * so the nearest one is known without walking the wheel.
+ * While the display is off, timeouts that have no use then
+ * don't wake up the device
+ * <p>
+ * Periodic work that doesn't need to run at an exact time can use
+ * aligned timeouts instead; these are allowed to expire late by
+ * a tolerance, and are run together with the DSME heartbeat,
+ * with other timeouts, or with each other, whichever comes first
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include "mce.h"
+#include "mce-timer.h"
+
+#include "mce-lib.h"			/* mce_get_monotonic_time_ms() */
+#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-conf.h"			/* mce_conf_get_int() */
+#include "mce-wakeups.h"		/* mce_wakeups_begin(),
+					 * mce_wakeups_end(),
+					 * MCE_WAKEUPS_TIMEOUT
+					 */
+#include "datapipe.h"			/* append_output_trigger_to_datapipe(),
+					 * remove_output_trigger_from_datapipe()
+					 */
+
+/** States of a timeout */
+typedef enum {
+	/** The timeout is waiting in the wheel */
+	MCE_TIMER_QUEUED = 0,
+	/** The timeout has expired and is waiting to be dispatched */
+	MCE_TIMER_EXPIRED = 1,
+	/** The timeout was removed while expired or being dispatched */
+	MCE_TIMER_REMOVED = 2,
+	/** The timeout has expired and is held until unblank */
+	MCE_TIMER_HELD = 3
+} mce_timer_state_t;
+
+/** A timeout */
+typedef struct mce_timer {
+	guint id;			/**< ID of the timeout */
+	mce_timer_state_t state;	/**< State of the timeout */
+	gint64 expiry;			/**< Monotonic expiry time in ms */
+	guint slot;			/**< Wheel slot holding the timeout */
+	guint heap_index;		/**< Position in the deadline heap */
+	guint interval;			/**< Interval in ms */
+	gboolean seconds;		/**< Round expiry up to full seconds? */
+	mce_timer_class_t timer_class;	/**< Class of the timeout */
+	const gchar *name;		/**< Name of the timeout */
+	gboolean aligned;		/**< Aligned timeout? */
+	guint tolerance;		/**< How late the timeout may expire */
+	GSourceFunc function;		/**< Function to call on expiry */
+	gpointer data;			/**< Data to pass to the function */
+	struct mce_timer *prev;		/**< Previous timeout in the slot */
+	struct mce_timer *next;		/**< Next timeout in the slot */
+} mce_timer_t;
+
+/** Number of timeout classes */
+#define MCE_TIMER_CLASSES		(MCE_TIMER_DISPLAY_ON + 1)
+
+/** The timer wheel; each slot is a list of timeouts */
+static mce_timer_t *wheel[MCE_TIMER_WHEEL_SLOTS];
+
+/**
+ * The timeouts in the wheel, as a binary min-heap on the expiry time
+ * for each timeout class; the root of each heap is the nearest
+ * deadline of that class
+ */
+static GPtrArray *deadlines[MCE_TIMER_CLASSES];
+
+/** Timeouts by ID */
+static GHashTable *timers = NULL;
+
+/** The last ID handed out */
+static guint last_timer_id = 0;
+
+/**
+ * The wheel has been processed up to, but not including,
+ * this millisecond
+ */
+static gint64 wheel_time = 0;
+
+/** ID of the GSource driving the timer wheel */
+static guint wheel_source_id = 0;
+
+/** Are non-critical timeouts deferred, since the display is off? */
+static gboolean timers_deferred = FALSE;
+
+/** Timeouts held until unblank */
+static GSList *held_timers = NULL;
+
+/** Number of wakeups of the timer wheel */
+static guint wheel_wakeups = 0;
+
+/** Number of timeouts held until unblank */
+static guint held_count = 0;
+
+/** Aligned timeouts; these are kept outside the wheel */
+static GSList *aligned_timers = NULL;
+
+/** Tolerance of aligned timeouts, in percent of the interval */
+static gint aligned_tolerance = DEFAULT_ALIGNED_TOLERANCE;
+
+/** Number of aligned timeouts that shared a wakeup */
+static guint aligned_merged_count = 0;
+
+/** Number of aligned timeouts that needed a wakeup of their own */
+static guint aligned_unmerged_count = 0;
+
+/**
+ * Check whether a timeout may wake up the device
+ *
+ * @param timer The timeout
+ * @return TRUE if the timeout may wake up the device, FALSE if not
+ */
+static gboolean timer_can_wake(const mce_timer_t *timer)
+{
+	return ((timers_deferred == FALSE) ||
+		(timer->timer_class == MCE_TIMER_CRITICAL));
+}
+
+/**
+ * Get the wheel slot for a point in time
+ *
+ * @param time The monotonic time in milliseconds
+ * @return The slot index
+ */
+static guint time_to_slot(gint64 time)
+{
+	return (guint)(time & (MCE_TIMER_WHEEL_SLOTS - 1));
+}
+
+/**
+ * Get a timeout in a deadline heap
+ *
+ * @param heap The heap
+ * @param index The position in the heap
+ * @return The timeout
+ */
+static mce_timer_t *heap_get(GPtrArray *heap, guint index)
+{
+	return g_ptr_array_index(heap, index);
+}
+
+/**
+ * Put a timeout at a position in a deadline heap
+ *
+ * @param heap The heap
+ * @param index The position in the heap
+ * @param timer The timeout
+ */
+static void heap_set(GPtrArray *heap, guint index, mce_timer_t *timer)
+{
+	g_ptr_array_index(heap, index) = timer;
+	timer->heap_index = index;
+}
+
+/**
+ * Move a timeout towards the root of its deadline heap
+ * until its parent expires no later than it
+ *
+ * @param heap The heap
+ * @param index The position of the timeout in the heap
+ */
+static void heap_sift_up(GPtrArray *heap, guint index)
+{
+	mce_timer_t *timer = heap_get(heap, index);
+
+	while (index > 0) {
+		mce_timer_t *parent = heap_get(heap, (index - 1) / 2);
+
+		if (parent->expiry <= timer->expiry)
+			break;
+
+		heap_set(heap, index, parent);
+		index = (index - 1) / 2;
+	}
+
+	heap_set(heap, index, timer);
+}
+
+/**
+ * Move a timeout away from the root of its deadline heap
+ * until its children expire no earlier than it
+ *
+ * @param heap The heap
+ * @param index The position of the timeout in the heap
+ */
+static void heap_sift_down(GPtrArray *heap, guint index)
+{
+	mce_timer_t *timer = heap_get(heap, index);
+
+	while ((2 * index) + 1 < heap->len) {
+		guint child = (2 * index) + 1;
+
+		if ((child + 1 < heap->len) &&
+		    (heap_get(heap, child + 1)->expiry <
+		     heap_get(heap, child)->expiry))
+			child++;
+
+		if (timer->expiry <= heap_get(heap, child)->expiry)
+			break;
+
+		heap_set(heap, index, heap_get(heap, child));
+		index = child;
+	}
+
+	heap_set(heap, index, timer);
+}
+
+/**
+ * Add a timeout to the deadline heap of its class
+ *
+ * @param timer The timeout
+ */
+static void heap_insert(mce_timer_t *timer)
+{
+	GPtrArray *heap = deadlines[timer->timer_class];
+
+	g_ptr_array_add(heap, timer);
+	heap_sift_up(heap, heap->len - 1);
+}
+
+/**
+ * Remove a timeout from the deadline heap of its class
+ *
+ * @param timer The timeout
+ */
+static void heap_remove(mce_timer_t *timer)
+{
+	GPtrArray *heap = deadlines[timer->timer_class];
+	guint index = timer->heap_index;
+
+	/* The last timeout takes the place of the removed one */
+	g_ptr_array_remove_index_fast(heap, index);
+
+	if (index < heap->len) {
+		mce_timer_t *last = heap_get(heap, index);
+
+		heap_set(heap, index, last);
+		heap_sift_up(heap, index);
+		heap_sift_down(heap, last->heap_index);
+	}
+}
+
+/**
+ * Get the nearest deadline of a timeout class
+ *
+ * @param timer_class The class of the timeouts
+ * @return The monotonic time in milliseconds,
+ *         G_MAXINT64 if there are no timeouts of the class
+ */
+static gint64 get_class_deadline(mce_timer_class_t timer_class)
+{
+	GPtrArray *heap = deadlines[timer_class];
+
+	return ((heap == NULL) || (heap->len == 0)) ?
+		G_MAXINT64 : heap_get(heap, 0)->expiry;
+}
+
+/**
+ * Insert a timeout into the wheel
+ *
+ * @param timer The timeout
+ */
+static void wheel_insert(mce_timer_t *timer)
+{
+	/* Timeouts that are already due go into the
+	 * first slot that hasn't been processed yet
+	 */
+	timer->slot = time_to_slot(MAX(timer->expiry, wheel_time));
+	timer->state = MCE_TIMER_QUEUED;
+	timer->prev = NULL;
+	timer->next = wheel[timer->slot];
+
+	if (wheel[timer->slot] != NULL)
+		wheel[timer->slot]->prev = timer;
+
+	wheel[timer->slot] = timer;
+
+	heap_insert(timer);
+}
+
+/**
+ * Queue a timeout; aligned timeouts go on their own list
+ *
+ * @param timer The timeout
+ */
+static void queue_timer(mce_timer_t *timer)
+{
+	if (timer->aligned == TRUE) {
+		timer->state = MCE_TIMER_QUEUED;
+		aligned_timers = g_slist_prepend(aligned_timers, timer);
+	} else {
+		wheel_insert(timer);
+	}
+}
+
+/**
+ * Remove a timeout from the wheel
+ *
+ * @param timer The timeout
+ */
+static void wheel_unlink(mce_timer_t *timer)
+{
+	if (timer->prev != NULL)
+		timer->prev->next = timer->next;
+	else
+		wheel[timer->slot] = timer->next;
+
+	if (timer->next != NULL)
+		timer->next->prev = timer->prev;
+
+	timer->prev = NULL;
+	timer->next = NULL;
+
+	heap_remove(timer);
+}
+
+/**
+ * Get the time by which an aligned timeout has to be run
+ *
+ * @return The nearest deadline of the aligned timeouts,
+ *         G_MAXINT64 if there are none that may wake up the device
+ */
+static gint64 get_aligned_deadline(void)
+{
+	gint64 deadline = G_MAXINT64;
+	GSList *tmp;
+
+	for (tmp = aligned_timers; tmp != NULL; tmp = g_slist_next(tmp)) {
+		mce_timer_t *timer = tmp->data;
+
+		if ((timer->expiry + timer->tolerance < deadline) &&
+		    (timer_can_wake(timer) == TRUE))
+			deadline = timer->expiry + timer->tolerance;
+	}
+
+	return deadline;
+}
+
+/**
+ * Get the time of the next wakeup of the timer wheel
+ *
+ * @return The monotonic time in milliseconds,
+ *         G_MAXINT64 if there's nothing to wake up for
+ */
+static gint64 get_next_wakeup(void)
+{
+	gint64 next_wakeup = get_class_deadline(MCE_TIMER_CRITICAL);
+
+	/* While deferred, only critical timeouts wake up the device */
+	if (timers_deferred == FALSE) {
+		next_wakeup = MIN(next_wakeup,
+				  get_class_deadline(MCE_TIMER_DEFERRABLE));
+		next_wakeup = MIN(next_wakeup,
+				  get_class_deadline(MCE_TIMER_DISPLAY_ON));
+	}
+
+	return MIN(next_wakeup, get_aligned_deadline());
+}
+
+/**
+ * Set the expiry time of a timeout
+ *
+ * @param timer The timeout
+ * @param now The current monotonic time in milliseconds
+ */
+static void set_expiry(mce_timer_t *timer, gint64 now)
+{
+	timer->expiry = now + timer->interval;
+
+	/* Let timeouts with a resolution of seconds expire together */
+	if (timer->seconds == TRUE)
+		timer->expiry = ((timer->expiry + 999) / 1000) * 1000;
+}
+
+/**
+ * Compare the expiry times of two timeouts
+ *
+ * @param a The first timeout
+ * @param b The second timeout
+ * @return Less than, equal to or greater than zero if a expires
+ *         before, at the same time as or after b
+ */
+static gint timer_expiry_compare(gconstpointer a, gconstpointer b)
+{
+	const mce_timer_t *timer_a = a;
+	const mce_timer_t *timer_b = b;
+
+	if (timer_a->expiry != timer_b->expiry)
+		return (timer_a->expiry < timer_b->expiry) ? -1 : 1;
+
+	/* Same expiry time; keep the order they were added in */
+	return (timer_a->id < timer_b->id) ? -1 : 1;
+}
+
+/**
+ * Collect the timeouts that have expired
+ *
+ * @param now The current monotonic time in milliseconds
+ * @return A list of the expired timeouts, ordered by expiry time
+ */
+static GSList *collect_expired(gint64 now)
+{
+	GSList *expired = NULL;
+	gint64 last;
+	gint64 i;
+
+	/* Never walk more than one full revolution, but always walk
+	 * the first slot; timeouts that were already due when queued,
+	 * such as released held ones, wait there
+	 */
+	last = MIN(now, wheel_time + MCE_TIMER_WHEEL_SLOTS - 1);
+	last = MAX(last, wheel_time);
+
+	for (i = wheel_time; i <= last; i++) {
+		mce_timer_t *timer = wheel[time_to_slot(i)];
+
+		while (timer != NULL) {
+			mce_timer_t *next = timer->next;
+
+			if (timer->expiry <= now) {
+				wheel_unlink(timer);
+				timer->state = MCE_TIMER_EXPIRED;
+				expired = g_slist_prepend(expired, timer);
+			}
+
+			timer = next;
+		}
+	}
+
+	wheel_time = MAX(wheel_time, now + 1);
+
+	return g_slist_sort(expired, timer_expiry_compare);
+}
+
+/**
+ * GSource prepare function for the timer wheel
+ *
+ * @param source Unused
+ * @param timeout Where to store the time until the nearest deadline
+ * @return TRUE if a timeout has expired, FALSE otherwise
+ */
+static gboolean wheel_prepare(GSource *source, gint *timeout)
+{
+	gint64 next_wakeup = get_next_wakeup();
+	gboolean status = FALSE;
+	gint64 now;
+
+	(void)source;
+
+	if (next_wakeup == G_MAXINT64) {
+		*timeout = -1;
+		goto EXIT;
+	}
+
+	now = mce_get_monotonic_time_ms();
+
+	if (next_wakeup <= now) {
+		*timeout = 0;
+		status = TRUE;
+	} else {
+		*timeout = (gint)MIN(next_wakeup - now, G_MAXINT);
+	}
+
+EXIT:
+	return status;
+}
+
+/**
+ * Check whether a deferrable timeout has expired
+ *
+ * @param now The current monotonic time in milliseconds
+ * @return TRUE if a deferrable timeout has expired, FALSE otherwise
+ */
+static gboolean deferrable_expired(gint64 now)
+{
+	gboolean expired = FALSE;
+	GSList *tmp;
+
+	if (get_class_deadline(MCE_TIMER_DEFERRABLE) <= now) {
+		expired = TRUE;
+		goto EXIT;
+	}
+
+	for (tmp = aligned_timers; tmp != NULL; tmp = g_slist_next(tmp)) {
+		mce_timer_t *timer = tmp->data;
+
+		if ((timer->timer_class == MCE_TIMER_DEFERRABLE) &&
+		    (timer->expiry <= now)) {
+			expired = TRUE;
+			break;
+		}
+	}
+
+EXIT:
+	return expired;
+}
+
+/**
+ * GSource check function for the timer wheel
+ *
+ * Deferrable timeouts don't count towards the wakeups while
+ * the display is off, but this is called whenever the mainloop
+ * wakes up for any source; if one of them has expired,
+ * it is run now that the device is awake anyway
+ *
+ * @param source Unused
+ * @return TRUE if a timeout has expired, FALSE otherwise
+ */
+static gboolean wheel_check(GSource *source)
+{
+	gint64 next_wakeup = get_next_wakeup();
+	gint64 now = mce_get_monotonic_time_ms();
+
+	(void)source;
+
+	return (((next_wakeup != G_MAXINT64) && (next_wakeup <= now)) ||
+		((timers_deferred == TRUE) &&
+		 (deferrable_expired(now) == TRUE)));
+}
+
+/**
+ * Free a timeout
+ *
+ * @param timer The timeout
+ */
+static void free_timer(mce_timer_t *timer)
+{
+	g_slice_free(mce_timer_t, timer);
+}
+
+/**
+ * Run an expired timeout
+ *
+ * @param timer The timeout
+ * @param now The current monotonic time in milliseconds
+ */
+static void run_timer(mce_timer_t *timer, gint64 now)
+{
+	gboolean periodic;
+
+	/* Removed by an earlier callback in this batch? */
+	if (timer->state == MCE_TIMER_REMOVED)
+		goto FREE;
+
+	mce_wakeups_begin(MCE_WAKEUPS_TIMEOUT, timer->name);
+	periodic = timer->function(timer->data);
+	mce_wakeups_end();
+
+	if ((periodic == TRUE) && (timer->state == MCE_TIMER_EXPIRED)) {
+		/* Periodic timeout; schedule the next expiry */
+		set_expiry(timer, now);
+		queue_timer(timer);
+		goto EXIT;
+	}
+
+	/* Unless the callback removed it, the ID is still valid */
+	if (timer->state == MCE_TIMER_EXPIRED)
+		g_hash_table_remove(timers, GUINT_TO_POINTER(timer->id));
+
+FREE:
+	free_timer(timer);
+
+EXIT:
+	return;
+}
+
+/**
+ * Run the aligned timeouts that have expired
+ *
+ * @param now The current monotonic time in milliseconds
+ * @param shared TRUE if the device woke up for something else anyway,
+ *               FALSE if the wakeup was for the aligned timeouts only
+ */
+static void run_aligned_timers(gint64 now, gboolean shared)
+{
+	GSList *expired = NULL;
+	GSList *tmp = aligned_timers;
+
+	while (tmp != NULL) {
+		GSList *next = g_slist_next(tmp);
+		mce_timer_t *timer = tmp->data;
+
+		/* Display-on timeouts wait in the list until unblank */
+		if ((timer->expiry <= now) &&
+		    ((timers_deferred == FALSE) ||
+		     (timer->timer_class != MCE_TIMER_DISPLAY_ON))) {
+			aligned_timers = g_slist_delete_link(aligned_timers,
+							     tmp);
+			timer->state = MCE_TIMER_EXPIRED;
+			expired = g_slist_prepend(expired, timer);
+		}
+
+		tmp = next;
+	}
+
+	if (expired == NULL)
+		goto EXIT;
+
+	expired = g_slist_sort(expired, timer_expiry_compare);
+
+	/* Unless something else woke up the device,
+	 * the first timeout is the one that needed the wakeup;
+	 * the rest came along for free
+	 */
+	if (shared == FALSE) {
+		aligned_unmerged_count++;
+		aligned_merged_count += g_slist_length(expired) - 1;
+	} else {
+		aligned_merged_count += g_slist_length(expired);
+	}
+
+	mce_log(LL_DEBUG,
+		"Running %u aligned timeouts; "
+		"%u merged and %u unmerged in total",
+		g_slist_length(expired),
+		aligned_merged_count, aligned_unmerged_count);
+
+	for (tmp = expired; tmp != NULL; tmp = g_slist_next(tmp))
+		run_timer(tmp->data, now);
+
+	g_slist_free(expired);
+
+EXIT:
+	return;
+}
+
+/**
+ * GSource dispatch function for the timer wheel
+ *
+ * @param source Unused
+ * @param callback Unused
+ * @param user_data Unused
+ * @return Always returns TRUE, to keep the source
+ */
+static gboolean wheel_dispatch(GSource *source, GSourceFunc callback,
+			       gpointer user_data)
+{
+	gint64 now = mce_get_monotonic_time_ms();
+	GSList *expired = collect_expired(now);
+	GSList *tmp;
+
+	(void)source;
+	(void)callback;
+	(void)user_data;
+
+	wheel_wakeups++;
+
+	for (tmp = expired; tmp != NULL; tmp = g_slist_next(tmp)) {
+		mce_timer_t *timer = tmp->data;
+
+		/* Hold timeouts that are of no use until unblank */
+		if ((timer->state == MCE_TIMER_EXPIRED) &&
+		    (timers_deferred == TRUE) &&
+		    (timer->timer_class == MCE_TIMER_DISPLAY_ON)) {
+			timer->state = MCE_TIMER_HELD;
+			held_timers = g_slist_prepend(held_timers, timer);
+			held_count++;
+			continue;
+		}
+
+		run_timer(timer, now);
+	}
+
+	/* Aligned timeouts that have expired come along */
+	run_aligned_timers(now, (expired != NULL) ? TRUE : FALSE);
+
+	g_slist_free(expired);
+
+	return TRUE;
+}
+
+/** GSource functions for the timer wheel */
+static GSourceFuncs wheel_funcs = {
+	.prepare = wheel_prepare,
+	.check = wheel_check,
+	.dispatch = wheel_dispatch,
+	.finalize = NULL
+};
+
+/**
+ * Release the timeouts held until unblank;
+ * they expire as soon as the mainloop gets to them
+ */
+static void release_held_timers(void)
+{
+	gint64 now = mce_get_monotonic_time_ms();
+	GSList *tmp;
+
+	if (held_timers == NULL)
+		goto EXIT;
+
+	mce_log(LL_DEBUG,
+		"Releasing %u held timeouts; "
+		"%u held and %u wakeups in total",
+		g_slist_length(held_timers), held_count, wheel_wakeups);
+
+	for (tmp = held_timers; tmp != NULL; tmp = g_slist_next(tmp)) {
+		mce_timer_t *timer = tmp->data;
+
+		timer->expiry = now;
+		wheel_insert(timer);
+	}
+
+	g_slist_free(held_timers);
+	held_timers = NULL;
+
+EXIT:
+	return;
+}
+
+/**
+ * Datapipe trigger for the display state
+ *
+ * @param data The display state stored in a pointer
+ */
+static void display_state_trigger(gconstpointer data)
+{
+	display_state_t display_state = GPOINTER_TO_INT(data);
+	gboolean deferred;
+
+	switch (display_state) {
+	case MCE_DISPLAY_OFF:
+	case MCE_DISPLAY_LPM_OFF:
+	case MCE_DISPLAY_LPM_ON:
+		deferred = TRUE;
+		break;
+
+	case MCE_DISPLAY_UNDEF:
+	case MCE_DISPLAY_DIM:
+	case MCE_DISPLAY_ON:
+	default:
+		deferred = FALSE;
+		break;
+	}
+
+	if (deferred == timers_deferred)
+		goto EXIT;
+
+	timers_deferred = deferred;
+
+	if (timers_deferred == FALSE)
+		release_held_timers();
+
+EXIT:
+	return;
+}
+
+/**
+ * Datapipe trigger for the DSME heartbeat
+ *
+ * @param data Unused
+ */
+static void heartbeat_trigger(gconstpointer data)
+{
+	(void)data;
+
+	/* The device is awake anyway; run the aligned timeouts
+	 * that have expired, rather than wake up for them later
+	 */
+	run_aligned_timers(mce_get_monotonic_time_ms(), TRUE);
+}
+
+/**
+ * Set up the timer wheel
+ */
+static void init_wheel(void)
+{
+	GSource *source;
+	guint i;
+
+	if (wheel_source_id != 0)
+		goto EXIT;
+
+	timers = g_hash_table_new(g_direct_hash, g_direct_equal);
+	wheel_time = mce_get_monotonic_time_ms();
+
+	for (i = 0; i < MCE_TIMER_CLASSES; i++)
+		deadlines[i] = g_ptr_array_new();
+
+	source = g_source_new(&wheel_funcs, sizeof (GSource));
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	wheel_source_id = g_source_attach(source, NULL);
+	g_source_unref(source);
+
+EXIT:
+	return;
+}
+
+/**
+ * Add a timeout
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param timer_class The class of the timeout
+ * @param interval The interval in milliseconds
+ * @param seconds TRUE to round the expiry time up to full seconds
+ * @param aligned TRUE to allow the timeout to expire late,
+ *                to share a wakeup with other work
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+static guint add_timer(const gchar *name, mce_timer_class_t timer_class,
+		       guint interval, gboolean seconds, gboolean aligned,
+		       GSourceFunc function, gpointer data)
+{
+	mce_timer_t *timer;
+
+	init_wheel();
+
+	timer = g_slice_new0(mce_timer_t);
+
+	/* Skip 0 and IDs still in use after wraparound */
+	do {
+		timer->id = ++last_timer_id;
+	} while ((timer->id == 0) ||
+		 (g_hash_table_lookup(timers,
+				      GUINT_TO_POINTER(timer->id)) != NULL));
+
+	timer->interval = interval;
+	timer->seconds = seconds;
+	timer->timer_class = timer_class;
+	timer->name = name;
+	timer->aligned = aligned;
+	timer->function = function;
+	timer->data = data;
+
+	if (aligned == TRUE)
+		timer->tolerance = ((guint64)interval *
+				    aligned_tolerance) / 100;
+
+	set_expiry(timer, mce_get_monotonic_time_ms());
+	queue_timer(timer);
+	g_hash_table_insert(timers, GUINT_TO_POINTER(timer->id), timer);
+
+	return timer->id;
+}
+
+/**
+ * Add a timeout; a replacement for g_timeout_add()
+ * Use through the mce_timer_add() macro,
+ * which names the timeout after the function
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+guint mce_timer_add_named(const gchar *name, guint interval,
+			  GSourceFunc function, gpointer data)
+{
+	return add_timer(name, MCE_TIMER_CRITICAL, interval, FALSE, FALSE,
+			 function, data);
+}
+
+/**
+ * Add a timeout with a resolution of seconds;
+ * a replacement for g_timeout_add_seconds()
+ * The expiry time is rounded up to a full second,
+ * so that timeouts expiring close to each other
+ * are handled in the same wakeup
+ * Use through the mce_timer_add_seconds() macro,
+ * which names the timeout after the function
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param interval The interval in seconds
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+guint mce_timer_add_seconds_named(const gchar *name, guint interval,
+				  GSourceFunc function, gpointer data)
+{
+	return add_timer(name, MCE_TIMER_CRITICAL, interval * 1000,
+			 TRUE, FALSE, function, data);
+}
+
+/**
+ * Add a timeout of a specific class
+ * Use through the mce_timer_add_class() macro,
+ * which names the timeout after the function
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param timer_class The class of the timeout
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+guint mce_timer_add_class_named(const gchar *name,
+				mce_timer_class_t timer_class, guint interval,
+				GSourceFunc function, gpointer data)
+{
+	return add_timer(name, timer_class, interval, FALSE, FALSE,
+			 function, data);
+}
+
+/**
+ * Add a timeout of a specific class with a resolution of seconds
+ * Use through the mce_timer_add_seconds_class() macro,
+ * which names the timeout after the function
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param timer_class The class of the timeout
+ * @param interval The interval in seconds
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+guint mce_timer_add_seconds_class_named(const gchar *name,
+					mce_timer_class_t timer_class,
+					guint interval, GSourceFunc function,
+					gpointer data)
+{
+	return add_timer(name, timer_class, interval * 1000, TRUE, FALSE,
+			 function, data);
+}
+
+/**
+ * Add an aligned timeout of a specific class
+ * The timeout may expire late by a tolerance given as a percentage
+ * of the interval in mce.ini; within that window it is run together
+ * with the DSME heartbeat or other timeouts, if any, and only
+ * wakes up the device by itself at the end of the window
+ * Use through the mce_timer_add_aligned() macro,
+ * which names the timeout after the function
+ *
+ * @param name The name of the timeout, for the wakeup statistics
+ * @param timer_class The class of the timeout
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires;
+ *                 if it returns TRUE, the timeout is rescheduled
+ * @param data Data to pass to the function
+ * @return The ID of the timeout
+ */
+guint mce_timer_add_aligned_named(const gchar *name,
+				  mce_timer_class_t timer_class,
+				  guint interval, GSourceFunc function,
+				  gpointer data)
+{
+	return add_timer(name, timer_class, interval, FALSE, TRUE,
+			 function, data);
+}
+
+/**
+ * Remove a timeout; a replacement for g_source_remove()
+ *
+ * @param id The ID of the timeout
+ * @return TRUE if the timeout was removed, FALSE if it didn't exist
+ */
+gboolean mce_timer_remove(guint id)
+{
+	gboolean status = FALSE;
+	mce_timer_t *timer;
+
+	if ((timers == NULL) ||
+	    ((timer = g_hash_table_lookup(timers,
+					  GUINT_TO_POINTER(id))) == NULL)) {
+		mce_log(LL_ERR, "Timeout %u not found", id);
+		goto EXIT;
+	}
+
+	g_hash_table_remove(timers, GUINT_TO_POINTER(id));
+
+	/* Expired timeouts are freed by the dispatcher */
+	if (timer->state == MCE_TIMER_EXPIRED) {
+		timer->state = MCE_TIMER_REMOVED;
+	} else if (timer->state == MCE_TIMER_HELD) {
+		held_timers = g_slist_remove(held_timers, timer);
+		free_timer(timer);
+	} else if (timer->aligned == TRUE) {
+		aligned_timers = g_slist_remove(aligned_timers, timer);
+		free_timer(timer);
+	} else {
+		wheel_unlink(timer);
+		free_timer(timer);
+	}
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Init function for the timeout scheduler
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_timer_init(void)
+{
+	/* Append triggers/filters to datapipes */
+	append_output_trigger_to_datapipe(&display_state_pipe,
+					  display_state_trigger);
+	append_output_trigger_to_datapipe(&heartbeat_pipe,
+					  heartbeat_trigger);
+
+	/* Tolerance of aligned timeouts */
+	aligned_tolerance = mce_conf_get_int(MCE_CONF_TIMER_GROUP,
+					     MCE_CONF_ALIGNED_TOLERANCE,
+					     DEFAULT_ALIGNED_TOLERANCE,
+					     NULL);
+	aligned_tolerance = CLAMP(aligned_tolerance, 0, 100);
+
+	return TRUE;
+}
+
+/**
+ * Exit function for the timeout scheduler
+ */
+void mce_timer_exit(void)
+{
+	GSList *tmp;
+	guint i;
+
+	/* Remove triggers/filters from datapipes */
+	remove_output_trigger_from_datapipe(&heartbeat_pipe,
+					    heartbeat_trigger);
+	remove_output_trigger_from_datapipe(&display_state_pipe,
+					    display_state_trigger);
+
+	if (wheel_source_id != 0) {
+		g_source_remove(wheel_source_id);
+		wheel_source_id = 0;
+	}
+
+	for (i = 0; i < MCE_TIMER_WHEEL_SLOTS; i++) {
+		while (wheel[i] != NULL) {
+			mce_timer_t *timer = wheel[i];
+
+			wheel[i] = timer->next;
+			free_timer(timer);
+		}
+	}
+
+	for (i = 0; i < MCE_TIMER_CLASSES; i++) {
+		if (deadlines[i] != NULL) {
+			g_ptr_array_free(deadlines[i], TRUE);
+			deadlines[i] = NULL;
+		}
+	}
+
+	for (tmp = held_timers; tmp != NULL; tmp = g_slist_next(tmp))
+		free_timer(tmp->data);
+
+	g_slist_free(held_timers);
+	held_timers = NULL;
+
+	for (tmp = aligned_timers; tmp != NULL; tmp = g_slist_next(tmp))
+		free_timer(tmp->data);
+
+	g_slist_free(aligned_timers);
+	aligned_timers = NULL;
+
+	if (timers != NULL) {
+		g_hash_table_destroy(timers);
+		timers = NULL;
+	}
+
+	return;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file mce-timer.h
+ * Headers for the timeout scheduler for the Mode Control Entity
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MCE_TIMER_H_
+#define _MCE_TIMER_H_
+
+#include <glib.h>
+
+/**
+ * Number of slots in the timer wheel; must be a power of two.
+ * Each slot covers one millisecond; timeouts further away
+ * than one revolution simply stay in their slot for more rounds
+ */
+#define MCE_TIMER_WHEEL_SLOTS		512
+
+/** Name of timeout scheduler configuration group */
+#define MCE_CONF_TIMER_GROUP		"Timer"
+
+/** Name of configuration key for the tolerance of aligned timeouts */
+#define MCE_CONF_ALIGNED_TOLERANCE	"AlignedTolerance"
+
+/**
+ * Default tolerance of aligned timeouts;
+ * in percent of the interval of the timeout
+ */
+#define DEFAULT_ALIGNED_TOLERANCE	25
+
+/** Timeout classes; decides what happens while the display is off */
+typedef enum {
+	/** Always expires on time */
+	MCE_TIMER_CRITICAL = 0,
+	/**
+	 * While the display is off or in low power mode,
+	 * doesn't wake up the device by itself; expires when
+	 * the device wakes up for some other reason, or on unblank
+	 */
+	MCE_TIMER_DEFERRABLE = 1,
+	/**
+	 * Only expires while the display is on; if it would expire
+	 * while the display is off or in low power mode,
+	 * it is held until unblank
+	 */
+	MCE_TIMER_DISPLAY_ON = 2
+} mce_timer_class_t;
+
+/**
+ * Add a timeout; a replacement for g_timeout_add()
+ * The timeout is named after the function in the wakeup statistics
+ *
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires
+ * @param data Data to pass to the function
+ */
+#define mce_timer_add(interval, function, data)				\
+	mce_timer_add_named(#function, (interval), (function), (data))
+
+/**
+ * Add a timeout with a resolution of seconds;
+ * a replacement for g_timeout_add_seconds()
+ *
+ * @param interval The interval in seconds
+ * @param function The function to call when the timeout expires
+ * @param data Data to pass to the function
+ */
+#define mce_timer_add_seconds(interval, function, data)			\
+	mce_timer_add_seconds_named(#function, (interval),		\
+				    (function), (data))
+
+/**
+ * Add a timeout of a specific class
+ *
+ * @param timer_class The class of the timeout
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires
+ * @param data Data to pass to the function
+ */
+#define mce_timer_add_class(timer_class, interval, function, data)	\
+	mce_timer_add_class_named(#function, (timer_class), (interval),	\
+				  (function), (data))
+
+/**
+ * Add a timeout of a specific class with a resolution of seconds
+ *
+ * @param timer_class The class of the timeout
+ * @param interval The interval in seconds
+ * @param function The function to call when the timeout expires
+ * @param data Data to pass to the function
+ */
+#define mce_timer_add_seconds_class(timer_class, interval, function, data) \
+	mce_timer_add_seconds_class_named(#function, (timer_class),	\
+					  (interval), (function), (data))
+
+/**
+ * Add an aligned timeout of a specific class
+ *
+ * @param timer_class The class of the timeout
+ * @param interval The interval in milliseconds
+ * @param function The function to call when the timeout expires
+ * @param data Data to pass to the function
+ */
+#define mce_timer_add_aligned(timer_class, interval, function, data)	\
+	mce_timer_add_aligned_named(#function, (timer_class), (interval), \
+				    (function), (data))
+
+guint mce_timer_add_named(const gchar *name, guint interval,
+			  GSourceFunc function, gpointer data);
+guint mce_timer_add_seconds_named(const gchar *name, guint interval,
+				  GSourceFunc function, gpointer data);
+guint mce_timer_add_class_named(const gchar *name,
+				mce_timer_class_t timer_class, guint interval,
+				GSourceFunc function, gpointer data);
+guint mce_timer_add_seconds_class_named(const gchar *name,
+					mce_timer_class_t timer_class,
+					guint interval, GSourceFunc function,
+					gpointer data);
+guint mce_timer_add_aligned_named(const gchar *name,
+				  mce_timer_class_t timer_class,
+				  guint interval, GSourceFunc function,
+				  gpointer data);
+gboolean mce_timer_remove(guint id);
+
+gboolean mce_timer_init(void);
+void mce_timer_exit(void);
+
+#endif /* _MCE_TIMER_H_ */
@@ -0,0 +1,385 @@
+/**
+ * @file mce-wakeups.c
+ * Mainloop wakeup accounting for the Mode Control Entity
+ * <p>
+ * Counts how often the mainloop wakes up, and attributes each
+ * wakeup to the first source dispatched after it; a source is
+ * an I/O monitor, a timeout or a D-Bus message, named after
+ * the file, the callback or the D-Bus member respectively.
+ * The number of dispatches, the CPU time used and the longest
+ * dispatch are accounted per source as well
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <string.h>			/* strcspn() */
+#include <time.h>			/* clock_gettime(),
+					 * CLOCK_MONOTONIC,
+					 * CLOCK_THREAD_CPUTIME_ID
+					 */
+#include <dbus/dbus.h>
+
+#include "mce.h"
+#include "mce-wakeups.h"
+
+#include "mce-lib.h"			/* mce_get_monotonic_time_ms() */
+#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-watchdog.h"		/* mce_watchdog_begin(),
+					 * mce_watchdog_end()
+					 */
+#include "mce-dbus.h"			/* mce_dbus_handler_add(),
+					 * dbus_new_method_reply(),
+					 * dbus_send_message(),
+					 * MCE_REQUEST_IF
+					 */
+
+/**
+ * Maximum number of sources accounted separately;
+ * D-Bus member names come from other processes,
+ * so the table mustn't grow without bounds
+ */
+#define MAX_WAKEUP_SOURCES		256
+
+/** Name used for sources beyond MAX_WAKEUP_SOURCES */
+#define OTHER_WAKEUP_SOURCE		"other"
+
+/** Statistics for a source */
+typedef struct {
+	gchar *name;			/**< Type and name of the source */
+	guint wakeups;			/**< Wakeups caused by the source */
+	guint dispatches;		/**< Dispatches of the source */
+	guint64 cpu_time;		/**< CPU time used, in microseconds */
+	guint max_time;			/**< Longest dispatch, in microseconds */
+	guint stalls;			/**< Dispatches over the time budget */
+} wakeup_source_t;
+
+/** Statistics by source name */
+static GHashTable *wakeup_sources = NULL;
+
+/** The poll function that glib would use */
+static GPollFunc default_poll = NULL;
+
+/** Number of mainloop wakeups */
+static guint wakeups = 0;
+
+/** Has the mainloop woken up, with nothing dispatched since? */
+static gboolean wakeup_pending = FALSE;
+
+/** Nesting depth of dispatches */
+static guint dispatch_depth = 0;
+
+/** Monotonic time at the start of the dispatch, in microseconds */
+static gint64 dispatch_start = 0;
+
+/** CPU time at the start of the dispatch, in microseconds */
+static gint64 dispatch_cpu_start = 0;
+
+/** Type and name of the source being dispatched */
+static gchar dispatch_source[128];
+
+/** Monotonic time when the statistics were started, in milliseconds */
+static gint64 stats_start = 0;
+
+/**
+ * Read a clock
+ *
+ * @param clock_id The clock to read
+ * @return The time in microseconds
+ */
+static gint64 get_clock_us(clockid_t clock_id)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock_id, &ts) == -1)
+		return 0;
+
+	return ((gint64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/**
+ * Free the statistics for a source
+ *
+ * @param data The statistics
+ */
+static void free_wakeup_source(gpointer data)
+{
+	wakeup_source_t *source = data;
+
+	g_free(source->name);
+	g_slice_free(wakeup_source_t, source);
+}
+
+/**
+ * Find the statistics for the source being dispatched,
+ * adding them if needed
+ *
+ * @return The statistics for the source
+ */
+static wakeup_source_t *get_wakeup_source(void)
+{
+	wakeup_source_t *source;
+	const gchar *key = dispatch_source;
+	gchar other[sizeof (dispatch_source)];
+	gsize type_len;
+
+	if ((source = g_hash_table_lookup(wakeup_sources, key)) != NULL)
+		goto EXIT;
+
+	if (g_hash_table_size(wakeup_sources) >= MAX_WAKEUP_SOURCES) {
+		/* Keep the type; replace the name */
+		type_len = strcspn(dispatch_source, ":");
+		g_snprintf(other, sizeof (other), "%.*s:%s",
+			   (gint)type_len, dispatch_source,
+			   OTHER_WAKEUP_SOURCE);
+		key = other;
+
+		if ((source = g_hash_table_lookup(wakeup_sources,
+						  key)) != NULL)
+			goto EXIT;
+	}
+
+	source = g_slice_new0(wakeup_source_t);
+	source->name = g_strdup(key);
+	g_hash_table_insert(wakeup_sources, source->name, source);
+
+EXIT:
+	return source;
+}
+
+/**
+ * Mark the start of a dispatch
+ *
+ * Dispatches nested inside another are accounted to the outermost one
+ *
+ * @param type The type of the source; MCE_WAKEUPS_*
+ * @param name The name of the source
+ */
+void mce_wakeups_begin(const gchar *const type, const gchar *const name)
+{
+	if (wakeup_sources == NULL)
+		goto EXIT;
+
+	if (dispatch_depth++ > 0)
+		goto EXIT;
+
+	g_snprintf(dispatch_source, sizeof (dispatch_source), "%s:%s",
+		   type, (name != NULL) ? name : "unknown");
+
+	mce_watchdog_begin(dispatch_source);
+
+	dispatch_start = get_clock_us(CLOCK_MONOTONIC);
+	dispatch_cpu_start = get_clock_us(CLOCK_THREAD_CPUTIME_ID);
+
+EXIT:
+	return;
+}
+
+/**
+ * Mark the end of a dispatch, and account it to its source
+ */
+void mce_wakeups_end(void)
+{
+	wakeup_source_t *source;
+	gint64 elapsed;
+
+	if ((wakeup_sources == NULL) || (dispatch_depth == 0))
+		goto EXIT;
+
+	if (--dispatch_depth > 0)
+		goto EXIT;
+
+	source = get_wakeup_source();
+
+	source->dispatches++;
+	source->cpu_time += get_clock_us(CLOCK_THREAD_CPUTIME_ID) -
+			    dispatch_cpu_start;
+
+	elapsed = get_clock_us(CLOCK_MONOTONIC) - dispatch_start;
+
+	if (elapsed > source->max_time)
+		source->max_time = (guint)MIN(elapsed, G_MAXUINT);
+
+	if (mce_watchdog_end(dispatch_source, elapsed) == TRUE)
+		source->stalls++;
+
+	/* The first source dispatched gets the blame for the wakeup */
+	if (wakeup_pending == TRUE) {
+		source->wakeups++;
+		wakeup_pending = FALSE;
+	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Poll function for the mainloop; counts the wakeups
+ *
+ * @param fds The file descriptors to poll
+ * @param nfds The number of file descriptors
+ * @param timeout The poll timeout in milliseconds; -1 to block
+ * @return The return value of the default poll function
+ */
+static gint wakeup_poll(GPollFD *fds, guint nfds, gint timeout)
+{
+	gint status = default_poll(fds, nfds, timeout);
+
+	/* A poll that doesn't block isn't a wakeup */
+	if (timeout != 0) {
+		wakeups++;
+		wakeup_pending = TRUE;
+	}
+
+	return status;
+}
+
+/**
+ * D-Bus callback for the wakeup statistics get method call
+ *
+ * @param msg The D-Bus message to reply to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean wakeups_get_dbus_cb(DBusMessage *const msg)
+{
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+	dbus_uint32_t elapsed;
+	const gchar **names;
+	dbus_uint32_t *source_wakeups;
+	dbus_uint32_t *dispatches;
+	dbus_uint64_t *cpu_times;
+	dbus_uint32_t *max_times;
+	dbus_uint32_t *stalls;
+	GHashTableIter iter;
+	gpointer value;
+	gint count;
+	gint i = 0;
+
+	mce_log(LL_DEBUG, "Received wakeup statistics get request");
+
+	count = g_hash_table_size(wakeup_sources);
+	names = g_new0(const gchar *, count + 1);
+	source_wakeups = g_new0(dbus_uint32_t, count + 1);
+	dispatches = g_new0(dbus_uint32_t, count + 1);
+	cpu_times = g_new0(dbus_uint64_t, count + 1);
+	max_times = g_new0(dbus_uint32_t, count + 1);
+	stalls = g_new0(dbus_uint32_t, count + 1);
+
+	g_hash_table_iter_init(&iter, wakeup_sources);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		wakeup_source_t *source = value;
+
+		names[i] = source->name;
+		source_wakeups[i] = source->wakeups;
+		dispatches[i] = source->dispatches;
+		cpu_times[i] = source->cpu_time;
+		max_times[i] = source->max_time;
+		stalls[i] = source->stalls;
+		i++;
+	}
+
+	elapsed = (dbus_uint32_t)(mce_get_monotonic_time_ms() - stats_start);
+
+	/* Create a reply */
+	reply = dbus_new_method_reply(msg);
+
+	if (dbus_message_append_args(reply,
+				     DBUS_TYPE_UINT32, &wakeups,
+				     DBUS_TYPE_UINT32, &elapsed,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+				     &names, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				     &source_wakeups, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				     &dispatches, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64,
+				     &cpu_times, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				     &max_times, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				     &stalls, count,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to append reply arguments to D-Bus message "
+			"for %s.%s",
+			MCE_REQUEST_IF, MCE_WAKEUPS_GET);
+		dbus_message_unref(reply);
+		goto EXIT;
+	}
+
+	/* Send the message */
+	status = dbus_send_message(reply);
+
+EXIT:
+	g_free(names);
+	g_free(source_wakeups);
+	g_free(dispatches);
+	g_free(cpu_times);
+	g_free(max_times);
+	g_free(stalls);
+
+	return status;
+}
+
+/**
+ * Init function for the wakeup accounting
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_wakeups_init(void)
+{
+	gboolean status = FALSE;
+
+	wakeup_sources = g_hash_table_new_full(g_str_hash, g_str_equal,
+					       NULL, free_wakeup_source);
+	stats_start = mce_get_monotonic_time_ms();
+
+	/* Count the wakeups of the default mainloop */
+	default_poll = g_main_context_get_poll_func(NULL);
+	g_main_context_set_poll_func(NULL, wakeup_poll);
+
+	/* get_wakeup_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_WAKEUPS_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 wakeups_get_dbus_cb) == NULL)
+		goto EXIT;
+
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Exit function for the wakeup accounting
+ */
+void mce_wakeups_exit(void)
+{
+	if (default_poll != NULL) {
+		g_main_context_set_poll_func(NULL, default_poll);
+		default_poll = NULL;
+	}
+
+	if (wakeup_sources != NULL) {
+		g_hash_table_destroy(wakeup_sources);
+		wakeup_sources = NULL;
+	}
+
+	return;
+}
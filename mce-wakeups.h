@@ -0,0 +1,54 @@
+/**
+ * @file mce-wakeups.h
+ * Headers for the mainloop wakeup accounting for the Mode Control Entity
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MCE_WAKEUPS_H_
+#define _MCE_WAKEUPS_H_
+
+#include <glib.h>
+
+/**
+ * Query the wakeup statistics
+ *
+ * Reply arguments:
+ * uint32 wakeups of the mainloop,
+ * uint32 milliseconds since the statistics were started,
+ * array of string source names,
+ * array of uint32 wakeups caused by each source,
+ * array of uint32 dispatches of each source,
+ * array of uint64 CPU time used by each source, in microseconds,
+ * array of uint32 longest dispatch of each source, in microseconds,
+ * array of uint32 dispatches of each source over the time budget
+ */
+#define MCE_WAKEUPS_GET			"get_wakeup_stats"
+
+/** Source name prefix for I/O monitors */
+#define MCE_WAKEUPS_IO			"io"
+/** Source name prefix for timeouts */
+#define MCE_WAKEUPS_TIMEOUT		"timeout"
+/** Source name prefix for D-Bus messages */
+#define MCE_WAKEUPS_DBUS		"dbus"
+/** Source name prefix for the input thread */
+#define MCE_WAKEUPS_INPUT_THREAD	"input-thread"
+
+void mce_wakeups_begin(const gchar *const type, const gchar *const name);
+void mce_wakeups_end(void);
+
+gboolean mce_wakeups_init(void);
+void mce_wakeups_exit(void);
+
+#endif /* _MCE_WAKEUPS_H_ */
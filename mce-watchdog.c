@@ -0,0 +1,396 @@
+/**
+ * @file mce-watchdog.c
+ * Mainloop stall detector for the Mode Control Entity
+ * <p>
+ * Every dispatch accounted by mce-wakeups has a time budget;
+ * dispatches that exceed it are logged as stalls.  A helper thread
+ * keeps an eye on the dispatch in progress, so that a mainloop
+ * that is stuck is reported while it is still stuck, together
+ * with a backtrace of the mainloop taken at that point
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <time.h>			/* clock_gettime(), nanosleep(),
+					 * CLOCK_MONOTONIC
+					 */
+#include <signal.h>			/* sigaction(), sigemptyset(),
+					 * SIGUSR2, SA_RESTART
+					 */
+#include <stdlib.h>			/* free() */
+#include <string.h>			/* memset() */
+#include <execinfo.h>			/* backtrace(),
+					 * backtrace_symbols()
+					 */
+#include <pthread.h>			/* pthread_create(), pthread_join(),
+					 * pthread_kill(),
+					 * pthread_cond_timedwait()
+					 */
+
+#include "mce.h"
+#include "mce-watchdog.h"
+
+#include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-conf.h"			/* mce_conf_get_int(),
+					 * mce_conf_get_bool()
+					 */
+
+/** Signal used to take a backtrace of the mainloop */
+#define WATCHDOG_SIGNAL			SIGUSR2
+
+/** Dispatch time budget, in milliseconds; 0 if disabled */
+static gint watchdog_budget = 0;
+
+/** Is the helper thread running? */
+static gboolean watchdog_running = FALSE;
+
+/** The helper thread */
+static pthread_t watchdog_thread;
+
+/** The mainloop thread */
+static pthread_t mainloop_thread;
+
+/** Mutex protecting the dispatch state below */
+static pthread_mutex_t watchdog_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Condition for changes in the dispatch state */
+static pthread_cond_t watchdog_cond;
+
+/** Is a dispatch in progress? */
+static gboolean dispatch_busy = FALSE;
+
+/** Sequence number of the dispatch in progress */
+static guint dispatch_seq = 0;
+
+/** Sequence number of the last dispatch reported as stalled */
+static guint reported_seq = 0;
+
+/** When the dispatch in progress exceeds its budget */
+static struct timespec dispatch_deadline;
+
+/** Name of the source being dispatched */
+static gchar dispatch_source[128];
+
+/** Is the helper thread waiting for a dispatch to start? */
+static gboolean watchdog_idle = FALSE;
+
+/** Should the helper thread exit? */
+static gboolean watchdog_quit = FALSE;
+
+/** Stack frames of the last mainloop backtrace */
+static void *backtrace_frames[WATCHDOG_MAX_FRAMES];
+
+/** Number of stack frames in backtrace_frames */
+static volatile sig_atomic_t backtrace_size = 0;
+
+/** Has the mainloop taken the backtrace? */
+static volatile sig_atomic_t backtrace_done = 0;
+
+/**
+ * Signal handler for the mainloop thread; takes a backtrace
+ *
+ * @param signr Unused
+ */
+static void backtrace_handler(int signr)
+{
+	(void)signr;
+
+	backtrace_size = backtrace(backtrace_frames, WATCHDOG_MAX_FRAMES);
+	backtrace_done = 1;
+}
+
+/**
+ * Get the current monotonic time
+ *
+ * @param[out] ts Where to store the time
+ */
+static void get_monotonic_time(struct timespec *ts)
+{
+	if (clock_gettime(CLOCK_MONOTONIC, ts) == -1)
+		memset(ts, 0, sizeof (*ts));
+}
+
+/**
+ * Check whether a point in time has passed
+ *
+ * @param ts The point in time
+ * @return TRUE if the time has passed, FALSE otherwise
+ */
+static gboolean time_passed(const struct timespec *ts)
+{
+	struct timespec now;
+
+	get_monotonic_time(&now);
+
+	return ((now.tv_sec > ts->tv_sec) ||
+		((now.tv_sec == ts->tv_sec) && (now.tv_nsec >= ts->tv_nsec)));
+}
+
+/**
+ * Report a stalled mainloop, with a backtrace if possible
+ * Called from the helper thread, without watchdog_mutex held
+ *
+ * @param source The name of the source being dispatched
+ */
+static void report_stall(const gchar *const source)
+{
+	struct timespec ts = { 0, 1000000 };
+	gchar **symbols = NULL;
+	gint i;
+
+	mce_log(LL_WARN,
+		"Mainloop stalled for more than %d ms in %s",
+		watchdog_budget, source);
+
+	/* Let the mainloop take a backtrace of itself;
+	 * system calls that can't be restarted, such as nanosleep(),
+	 * return early with EINTR, which the glib and D-Bus
+	 * blocking calls retry anyway
+	 */
+	backtrace_done = 0;
+
+	if (pthread_kill(mainloop_thread, WATCHDOG_SIGNAL) != 0)
+		goto EXIT;
+
+	for (i = 0; i < WATCHDOG_BACKTRACE_TIMEOUT; i++) {
+		if (backtrace_done != 0)
+			break;
+
+		nanosleep(&ts, NULL);
+	}
+
+	if (backtrace_done == 0) {
+		mce_log(LL_WARN, "No backtrace; the mainloop didn't respond");
+		goto EXIT;
+	}
+
+	if ((symbols = backtrace_symbols(backtrace_frames,
+					 backtrace_size)) == NULL)
+		goto EXIT;
+
+	/* Skip the signal handler itself */
+	for (i = 1; i < backtrace_size; i++)
+		mce_log(LL_WARN, "  %s", symbols[i]);
+
+	free(symbols);
+
+EXIT:
+	return;
+}
+
+/**
+ * The helper thread; waits for dispatches to exceed their budget
+ *
+ * @param data Unused
+ * @return Always returns NULL
+ */
+static void *watchdog_thread_main(void *data)
+{
+	gchar source[sizeof (dispatch_source)];
+
+	(void)data;
+
+	pthread_mutex_lock(&watchdog_mutex);
+
+	while (watchdog_quit == FALSE) {
+		/* Nothing to watch; sleep until a dispatch starts */
+		if ((dispatch_busy == FALSE) || (reported_seq == dispatch_seq)) {
+			watchdog_idle = TRUE;
+			pthread_cond_wait(&watchdog_cond, &watchdog_mutex);
+			watchdog_idle = FALSE;
+			continue;
+		}
+
+		/* Sleep until the dispatch ends or runs out of budget */
+		if (time_passed(&dispatch_deadline) == FALSE) {
+			pthread_cond_timedwait(&watchdog_cond, &watchdog_mutex,
+					       &dispatch_deadline);
+			continue;
+		}
+
+		reported_seq = dispatch_seq;
+		g_strlcpy(source, dispatch_source, sizeof (source));
+
+		pthread_mutex_unlock(&watchdog_mutex);
+		report_stall(source);
+		pthread_mutex_lock(&watchdog_mutex);
+	}
+
+	pthread_mutex_unlock(&watchdog_mutex);
+
+	return NULL;
+}
+
+/**
+ * Mark the start of a dispatch
+ *
+ * @param source The name of the source being dispatched
+ */
+void mce_watchdog_begin(const gchar *const source)
+{
+	struct timespec *ts = &dispatch_deadline;
+
+	if (watchdog_running == FALSE)
+		goto EXIT;
+
+	pthread_mutex_lock(&watchdog_mutex);
+
+	dispatch_busy = TRUE;
+	dispatch_seq++;
+	g_strlcpy(dispatch_source, source, sizeof (dispatch_source));
+
+	get_monotonic_time(ts);
+	ts->tv_sec += watchdog_budget / 1000;
+	ts->tv_nsec += (watchdog_budget % 1000) * 1000000;
+
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+
+	if (watchdog_idle == TRUE)
+		pthread_cond_signal(&watchdog_cond);
+
+	pthread_mutex_unlock(&watchdog_mutex);
+
+EXIT:
+	return;
+}
+
+/**
+ * Mark the end of a dispatch
+ *
+ * @param source The name of the source that was dispatched
+ * @param elapsed The duration of the dispatch, in microseconds
+ * @return TRUE if the dispatch exceeded its budget, FALSE otherwise
+ */
+gboolean mce_watchdog_end(const gchar *const source, gint64 elapsed)
+{
+	gboolean stalled = FALSE;
+
+	if (watchdog_running == TRUE) {
+		pthread_mutex_lock(&watchdog_mutex);
+
+		dispatch_busy = FALSE;
+
+		/* Let the helper thread go back to sleep
+		 * while the device is awake anyway
+		 */
+		if (watchdog_idle == FALSE)
+			pthread_cond_signal(&watchdog_cond);
+
+		pthread_mutex_unlock(&watchdog_mutex);
+	}
+
+	if ((watchdog_budget == 0) || (elapsed <= watchdog_budget * 1000))
+		goto EXIT;
+
+	mce_log(LL_WARN,
+		"Dispatch of %s took %lld ms; the budget is %d ms",
+		source, (long long)(elapsed / 1000), watchdog_budget);
+
+	stalled = TRUE;
+
+EXIT:
+	return stalled;
+}
+
+/**
+ * Init function for the mainloop stall detector
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+gboolean mce_watchdog_init(void)
+{
+	pthread_condattr_t condattr;
+	struct sigaction sa;
+	gboolean use_backtrace;
+
+	watchdog_budget = mce_conf_get_int(MCE_CONF_WATCHDOG_GROUP,
+					   MCE_CONF_WATCHDOG_BUDGET,
+					   DEFAULT_WATCHDOG_BUDGET,
+					   NULL);
+	use_backtrace = mce_conf_get_bool(MCE_CONF_WATCHDOG_GROUP,
+					  MCE_CONF_WATCHDOG_BACKTRACE,
+					  DEFAULT_WATCHDOG_BACKTRACE,
+					  NULL);
+
+	if (watchdog_budget < 0)
+		watchdog_budget = 0;
+
+	if ((watchdog_budget == 0) || (use_backtrace == FALSE))
+		goto EXIT;
+
+	/* The first call of backtrace() may load libgcc,
+	 * which mustn't happen inside the signal handler
+	 */
+	backtrace_size = backtrace(backtrace_frames, WATCHDOG_MAX_FRAMES);
+
+	memset(&sa, 0, sizeof (sa));
+	sa.sa_handler = backtrace_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(WATCHDOG_SIGNAL, &sa, NULL) == -1) {
+		mce_log(LL_WARN,
+			"Failed to install the backtrace signal handler; "
+			"stalls are only logged afterwards");
+		goto EXIT;
+	}
+
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&watchdog_cond, &condattr);
+	pthread_condattr_destroy(&condattr);
+
+	mainloop_thread = pthread_self();
+	watchdog_quit = FALSE;
+
+	if (pthread_create(&watchdog_thread, NULL,
+			   watchdog_thread_main, NULL) != 0) {
+		mce_log(LL_WARN,
+			"Failed to create the watchdog thread; "
+			"stalls are only logged afterwards");
+		pthread_cond_destroy(&watchdog_cond);
+		goto EXIT;
+	}
+
+	watchdog_running = TRUE;
+
+EXIT:
+	return TRUE;
+}
+
+/**
+ * Exit function for the mainloop stall detector
+ */
+void mce_watchdog_exit(void)
+{
+	if (watchdog_running == FALSE)
+		goto EXIT;
+
+	pthread_mutex_lock(&watchdog_mutex);
+	watchdog_quit = TRUE;
+	pthread_cond_signal(&watchdog_cond);
+	pthread_mutex_unlock(&watchdog_mutex);
+
+	pthread_join(watchdog_thread, NULL);
+	pthread_cond_destroy(&watchdog_cond);
+	watchdog_running = FALSE;
+
+EXIT:
+	return;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file mce-watchdog.h
+ * Headers for the mainloop stall detector for the Mode Control Entity
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MCE_WATCHDOG_H_
+#define _MCE_WATCHDOG_H_
+
+#include <glib.h>
+
+/** Maximum number of stack frames in a stall backtrace */
+#define WATCHDOG_MAX_FRAMES		32
+
+/**
+ * How long to wait for the mainloop to take the backtrace;
+ * in milliseconds
+ */
+#define WATCHDOG_BACKTRACE_TIMEOUT	100
+
+/** Name of mainloop watchdog configuration group */
+#define MCE_CONF_WATCHDOG_GROUP		"Watchdog"
+
+/** Name of configuration key for the dispatch time budget */
+#define MCE_CONF_WATCHDOG_BUDGET	"StallBudget"
+
+/** Name of configuration key for stall backtraces */
+#define MCE_CONF_WATCHDOG_BACKTRACE	"Backtrace"
+
+/** Default dispatch time budget, in milliseconds; 0 to disable */
+#define DEFAULT_WATCHDOG_BUDGET		50
+
+/**
+ * Default stall backtrace policy; off, since the helper thread
+ * is woken up at the start and end of every dispatch
+ */
+#define DEFAULT_WATCHDOG_BACKTRACE	FALSE
+
+void mce_watchdog_begin(const gchar *const source);
+gboolean mce_watchdog_end(const gchar *const source, gint64 elapsed);
+
+gboolean mce_watchdog_init(void);
+void mce_watchdog_exit(void);
+
+#endif /* _MCE_WATCHDOG_H_ */
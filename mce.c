@@ -122,6 +122,15 @@
 #include "modetransition.h"		/* mce_mode_init(),
 					 * mce_mode_exit()
 					 */
+#include "mce-timer.h"			/* mce_timer_init(),
+					 * mce_timer_exit()
+					 */
+#include "mce-wakeups.h"		/* mce_wakeups_init(),
+					 * mce_wakeups_exit()
+					 */
+#include "mce-watchdog.h"		/* mce_watchdog_init(),
+					 * mce_watchdog_exit()
+					 */
 
 /* "TBD" Modules; eventually this should be handled differently */
 #include "tklock.h"			/* mce_tklock_init(),
@@ -550,6 +559,21 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	/* Initialise the wakeup accounting
+	 * pre-requisite: mce_dbus_init()
+	 */
+	if (mce_wakeups_init() == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to initialise wakeup accounting");
+		mce_log_close();
+		exit(EXIT_FAILURE);
+	}
+
+	/* Initialise the mainloop stall detector
+	 * pre-requisite: mce_conf_init()
+	 */
+	(void)mce_watchdog_init();
+
 	/* Initialise GConf
 	 * pre-requisite: g_type_init()
 	 */
@@ -583,6 +607,8 @@ int main(int argc, char **argv)
 		       0, NULL);
 	setup_datapipe(&led_pattern_deactivate_pipe, READ_ONLY, FREE_CACHE,
 		       0, NULL);
+	setup_datapipe(&led_pattern_active_pipe, READ_ONLY, DONT_FREE_CACHE,
+		       0, GINT_TO_POINTER(FALSE));
 	setup_datapipe(&key_backlight_pipe, READ_WRITE, DONT_FREE_CACHE,
 		       0, GINT_TO_POINTER(0));
 	setup_datapipe(&keypress_pipe, READ_ONLY, FREE_CACHE,
@@ -626,6 +652,16 @@ int main(int argc, char **argv)
 	setup_datapipe(&heartbeat_pipe, READ_ONLY, DONT_FREE_CACHE,
 		       0, GINT_TO_POINTER(0));
 
+	/* Initialise the timeout scheduler
+	 * pre-requisite: mce_conf_init()
+	 * pre-requisite: display_state_pipe
+	 * pre-requisite: heartbeat_pipe
+	 */
+	if (mce_timer_init() == FALSE) {
+		status = EXIT_FAILURE;
+		goto EXIT;
+	}
+
 	/* Initialise mode management
 	 * pre-requisite: mce_gconf_init()
 	 * pre-requisite: mce_dbus_init()
@@ -703,6 +739,11 @@ EXIT:
 	mce_dsme_exit();
 	mce_mode_exit();
 
+	/* The timer wheel unbinds from the display state
+	 * and heartbeat datapipes, so it must go before them
+	 */
+	mce_timer_exit();
+
 	/* Free all datapipes */
 	free_datapipe(&thermal_state_pipe);
 	free_datapipe(&power_saving_mode_pipe);
@@ -723,6 +764,7 @@ EXIT:
 	free_datapipe(&touchscreen_pipe);
 	free_datapipe(&keypress_pipe);
 	free_datapipe(&key_backlight_pipe);
+	free_datapipe(&led_pattern_active_pipe);
 	free_datapipe(&led_pattern_deactivate_pipe);
 	free_datapipe(&led_pattern_activate_pipe);
 	free_datapipe(&led_brightness_pipe);
@@ -738,6 +780,8 @@ EXIT:
 
 	/* Call the exit function for all subsystems */
 	mce_gconf_exit();
+	mce_watchdog_exit();
+	mce_wakeups_exit();
 	mce_dbus_exit();
 	mce_conf_exit();
 
@@ -269,6 +269,8 @@ datapipe_struct device_inactive_pipe;
 datapipe_struct led_pattern_activate_pipe;
 /** LED pattern to deactivate; read only */
 datapipe_struct led_pattern_deactivate_pipe;
+/** Is an LED pattern being shown? read only */
+datapipe_struct led_pattern_active_pipe;
 /** State of display; read only */
 datapipe_struct display_state_pipe;
 /**
@@ -21,34 +21,207 @@
  */
 #include <glib.h>
 
+#include <string.h>			/* memcpy(), memset() */
+
 #include "median_filter.h"
 
+/**
+ * Compare-exchange two samples; the smaller one ends up in a;
+ * MIN() and MAX() compile to conditional moves or min/max
+ * instructions, so the kernels don't branch on the data
+ */
+#define MEDIAN_SORT(a, b)					\
+	do {							\
+		gint _min = MIN((a), (b));			\
+		gint _max = MAX((a), (b));			\
+		(a) = _min;					\
+		(b) = _max;					\
+	} while (0)
+
+/**
+ * Capacity of each of the two heaps; while the window is filling up,
+ * one heap can briefly hold one more than half of the window
+ */
+#define MEDIAN_HEAP_SIZE(window_size)	(((window_size) / 2) + 1)
+
+/**
+ * Median of 3 samples; sorting network
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+static gint median_kernel_3(const gint *window)
+{
+	gint p[3];
+
+	memcpy(p, window, sizeof (p));
+
+	MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[1], p[2]);
+	MEDIAN_SORT(p[0], p[1]);
+
+	return p[1];
+}
+
+/**
+ * Median of 5 samples; sorting network
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+static gint median_kernel_5(const gint *window)
+{
+	gint p[5];
+
+	memcpy(p, window, sizeof (p));
+
+	MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[3], p[4]);
+	MEDIAN_SORT(p[0], p[3]); MEDIAN_SORT(p[1], p[4]);
+	MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[2], p[3]);
+	MEDIAN_SORT(p[1], p[2]);
+
+	return p[2];
+}
+
+/**
+ * Median of 7 samples; sorting network
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+static gint median_kernel_7(const gint *window)
+{
+	gint p[7];
+
+	memcpy(p, window, sizeof (p));
+
+	MEDIAN_SORT(p[0], p[5]); MEDIAN_SORT(p[0], p[3]);
+	MEDIAN_SORT(p[1], p[6]); MEDIAN_SORT(p[2], p[4]);
+	MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[3], p[5]);
+	MEDIAN_SORT(p[2], p[6]); MEDIAN_SORT(p[2], p[3]);
+	MEDIAN_SORT(p[3], p[6]); MEDIAN_SORT(p[4], p[5]);
+	MEDIAN_SORT(p[1], p[4]); MEDIAN_SORT(p[1], p[3]);
+	MEDIAN_SORT(p[3], p[4]);
+
+	return p[3];
+}
+
+/**
+ * Median of 9 samples; sorting network
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+static gint median_kernel_9(const gint *window)
+{
+	gint p[9];
+
+	memcpy(p, window, sizeof (p));
+
+	MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[4], p[5]);
+	MEDIAN_SORT(p[7], p[8]); MEDIAN_SORT(p[0], p[1]);
+	MEDIAN_SORT(p[3], p[4]); MEDIAN_SORT(p[6], p[7]);
+	MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[4], p[5]);
+	MEDIAN_SORT(p[7], p[8]); MEDIAN_SORT(p[0], p[3]);
+	MEDIAN_SORT(p[5], p[8]); MEDIAN_SORT(p[4], p[7]);
+	MEDIAN_SORT(p[3], p[6]); MEDIAN_SORT(p[1], p[4]);
+	MEDIAN_SORT(p[2], p[5]); MEDIAN_SORT(p[4], p[7]);
+	MEDIAN_SORT(p[4], p[2]); MEDIAN_SORT(p[6], p[4]);
+	MEDIAN_SORT(p[4], p[2]);
+
+	return p[4];
+}
+
+/**
+ * Median of 11 samples; Batcher's odd-even merge sort network,
+ * pruned to the comparators that the median depends on
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+static gint median_kernel_11(const gint *window)
+{
+	gint p[11];
+
+	memcpy(p, window, sizeof (p));
+
+	MEDIAN_SORT(p[0], p[1]); MEDIAN_SORT(p[2], p[3]);
+	MEDIAN_SORT(p[4], p[5]); MEDIAN_SORT(p[6], p[7]);
+	MEDIAN_SORT(p[8], p[9]); MEDIAN_SORT(p[0], p[2]);
+	MEDIAN_SORT(p[1], p[3]); MEDIAN_SORT(p[4], p[6]);
+	MEDIAN_SORT(p[5], p[7]); MEDIAN_SORT(p[8], p[10]);
+	MEDIAN_SORT(p[1], p[2]); MEDIAN_SORT(p[5], p[6]);
+	MEDIAN_SORT(p[9], p[10]); MEDIAN_SORT(p[0], p[4]);
+	MEDIAN_SORT(p[1], p[5]); MEDIAN_SORT(p[2], p[6]);
+	MEDIAN_SORT(p[3], p[7]); MEDIAN_SORT(p[2], p[4]);
+	MEDIAN_SORT(p[3], p[5]); MEDIAN_SORT(p[1], p[2]);
+	MEDIAN_SORT(p[3], p[4]); MEDIAN_SORT(p[5], p[6]);
+	MEDIAN_SORT(p[9], p[10]); MEDIAN_SORT(p[0], p[8]);
+	MEDIAN_SORT(p[1], p[9]); MEDIAN_SORT(p[2], p[10]);
+	MEDIAN_SORT(p[4], p[8]); MEDIAN_SORT(p[5], p[9]);
+	MEDIAN_SORT(p[6], p[10]); MEDIAN_SORT(p[3], p[5]);
+	MEDIAN_SORT(p[6], p[8]); MEDIAN_SORT(p[5], p[6]);
+
+	return p[5];
+}
+
 /**
  * Initialise median filter
 
  * @param filter The median filter to initialise
  * @param window_size The window size to use
  *
- * @return FALSE if window_size is too big or filter is NULL,
+ * @return FALSE if window_size is 0 or filter is NULL,
  *         TRUE on success
  */
 gboolean median_filter_init(median_filter_struct *filter, gsize window_size)
 {
 	gboolean status = FALSE;
-	guint i;
 
-	if ((filter == NULL) || (window_size > MEDIAN_FILTER_MAX_WINDOW_SIZE))
+	if ((filter == NULL) || (window_size == 0))
 		goto EXIT;
 
-	filter->window_size = window_size;
+	/* Reuse the buffers when re-initialising */
+	if (filter->window_size != window_size) {
+		filter->window = g_renew(gint, filter->window, window_size);
+		filter->heap = g_renew(gsize, filter->heap,
+				       2 * MEDIAN_HEAP_SIZE(window_size));
+		filter->heap_pos = g_renew(gsize, filter->heap_pos,
+					   window_size);
+		filter->window_size = window_size;
+	}
+
+	memset(filter->window, 0, window_size * sizeof (gint));
+
+	switch (window_size) {
+	case 3:
+		filter->kernel = median_kernel_3;
+		break;
+
+	case 5:
+		filter->kernel = median_kernel_5;
+		break;
 
-	for (i = 0; i < filter->window_size; i++) {
-		filter->window[i] = 0;
-		filter->ordered_window[i] = 0;
+	case 7:
+		filter->kernel = median_kernel_7;
+		break;
+
+	case 9:
+		filter->kernel = median_kernel_9;
+		break;
+
+	case 11:
+		filter->kernel = median_kernel_11;
+		break;
+
+	default:
+		filter->kernel = NULL;
+		break;
 	}
 
 	filter->samples = 0;
 	filter->oldest = 0;
+	filter->low_samples = 0;
+	filter->high_samples = 0;
 
 	status = TRUE;
 
@@ -57,95 +230,220 @@ EXIT:
 }
 
 /**
- * Insert a new sample into the median filter
+ * Check whether a heap slot should be above another one
+ *
+ * @param filter The median filter
+ * @param low TRUE for the max-heap, FALSE for the min-heap
+ * @param a The ring buffer slot to check
+ * @param b The ring buffer slot to compare with
+ * @return TRUE if a belongs above b, FALSE otherwise
+ */
+static inline gboolean heap_above(const median_filter_struct *filter,
+				  gboolean low, gsize a, gsize b)
+{
+	return low ? (filter->window[a] > filter->window[b]) :
+		     (filter->window[a] < filter->window[b]);
+}
+
+/**
+ * Get the heap to use
+ *
+ * @param filter The median filter
+ * @param low TRUE for the max-heap, FALSE for the min-heap
+ * @param[out] count The number of samples in the heap
+ * @return The offset of the heap in filter->heap
+ */
+static inline gsize heap_get(median_filter_struct *filter,
+			     gboolean low, gsize **count)
+{
+	*count = low ? &filter->low_samples : &filter->high_samples;
+
+	return low ? 0 : MEDIAN_HEAP_SIZE(filter->window_size);
+}
+
+/**
+ * Place a ring buffer slot at a heap position
+ *
+ * @param filter The median filter
+ * @param pos The position in filter->heap
+ * @param slot The ring buffer slot
+ */
+static inline void heap_set(median_filter_struct *filter,
+			    gsize pos, gsize slot)
+{
+	filter->heap[pos] = slot;
+	filter->heap_pos[slot] = pos;
+}
+
+/**
+ * Restore the heap order after the value at a position has been
+ * replaced; moves the slot up or down as needed
+ *
+ * @param filter The median filter
+ * @param low TRUE for the max-heap, FALSE for the min-heap
+ * @param i The index within the heap
+ */
+static void heap_fix(median_filter_struct *filter, gboolean low, gsize i)
+{
+	gsize *count;
+	gsize base = heap_get(filter, low, &count);
+	gsize slot = filter->heap[base + i];
+
+	/* Move up */
+	while (i > 0) {
+		gsize parent = (i - 1) / 2;
+
+		if (heap_above(filter, low, slot,
+			       filter->heap[base + parent]) == FALSE)
+			break;
+
+		heap_set(filter, base + i, filter->heap[base + parent]);
+		i = parent;
+	}
+
+	/* Move down */
+	for (;;) {
+		gsize child = (2 * i) + 1;
+
+		if (child >= *count)
+			break;
+
+		if ((child + 1 < *count) &&
+		    (heap_above(filter, low, filter->heap[base + child + 1],
+				filter->heap[base + child]) == TRUE))
+			child++;
+
+		if (heap_above(filter, low, filter->heap[base + child],
+			       slot) == FALSE)
+			break;
+
+		heap_set(filter, base + i, filter->heap[base + child]);
+		i = child;
+	}
+
+	heap_set(filter, base + i, slot);
+}
+
+/**
+ * Add a ring buffer slot to a heap
+ *
+ * @param filter The median filter
+ * @param low TRUE for the max-heap, FALSE for the min-heap
+ * @param slot The ring buffer slot
+ */
+static void heap_push(median_filter_struct *filter,
+		      gboolean low, gsize slot)
+{
+	gsize *count;
+	gsize base = heap_get(filter, low, &count);
+	gsize i = (*count)++;
+
+	heap_set(filter, base + i, slot);
+	heap_fix(filter, low, i);
+}
+
+/**
+ * Remove the ring buffer slot at a heap position
+ *
+ * @param filter The median filter
+ * @param low TRUE for the max-heap, FALSE for the min-heap
+ * @param i The index within the heap
+ * @return The removed ring buffer slot
+ */
+static gsize heap_remove(median_filter_struct *filter, gboolean low, gsize i)
+{
+	gsize *count;
+	gsize base = heap_get(filter, low, &count);
+	gsize slot = filter->heap[base + i];
+
+	/* Fill the hole with the last slot of the heap */
+	if (i < --(*count)) {
+		heap_set(filter, base + i, filter->heap[base + *count]);
+		heap_fix(filter, low, i);
+	}
+
+	return slot;
+}
+
+/**
+ * Balance the heaps, so that the max-heap has as many samples as
+ * the min-heap, or one more; the tops of the heaps are then the
+ * middle samples of the window
+ *
+ * @param filter The median filter
+ */
+static void heap_balance(median_filter_struct *filter)
+{
+	if (filter->low_samples > filter->high_samples + 1)
+		heap_push(filter, FALSE, heap_remove(filter, TRUE, 0));
+	else if (filter->high_samples > filter->low_samples)
+		heap_push(filter, TRUE, heap_remove(filter, FALSE, 0));
+}
+
+/**
+ * Insert a new sample into the heaps
+ *
+ * Once the window is full, the new value takes over the ring buffer
+ * slot of the oldest value; if it belongs to the other half of the
+ * window, it trades places with the top of the other heap, so the
+ * heaps keep their sizes; each update takes O(log n) steps
  *
  * @param filter The median filter to insert the value into
  * @param value The value to insert
- * @param oldest The oldest value
  * @return The filtered value
  */
-static gint insert_ordered(median_filter_struct *filter,
-			   gint value, gint oldest)
+static gint insert_heap(median_filter_struct *filter, gint value)
 {
-	guint i;
+	gsize offset = MEDIAN_HEAP_SIZE(filter->window_size);
+	gsize slot = filter->oldest;
+	gint lower;
 
 	/* If the filter window hasn't been filled yet, insert the new value */
 	if (filter->samples < filter->window_size) {
-		/* Find insertion point */
-		for (i = 0; i < filter->samples; i++) {
-			if (filter->ordered_window[i] >= value) {
-				/* Found the insertion point */
-				for ( ; i < filter->samples; ++i) {
-					gint tmp;
-
-					/* Swap the value at insertion point
-					 * with the new value
-					 */
-					tmp = filter->ordered_window[i];
-					filter->ordered_window[i] = value;
-					value = tmp;
-				}
-
-				break;
-			}
-		}
+		filter->window[slot] = value;
+
+		if ((filter->low_samples == 0) ||
+		    (value <= filter->window[filter->heap[0]]))
+			heap_push(filter, TRUE, slot);
+		else
+			heap_push(filter, FALSE, slot);
 
-		/* Do the insertion */
-		filter->ordered_window[i] = value;
+		heap_balance(filter);
 		filter->samples++;
+		goto EXIT;
+	}
 
+	/* The filter window is full;
+	 * replace the oldest value with the new one
+	 */
+	if (filter->window[slot] == value)
 		goto EXIT;
-	} else {
-		/* The filter window is full;
-		 * remove the oldest value and insert new
-		 */
-		if (value == oldest) {
-			/* Do nothing */
-			goto EXIT;
+
+	filter->window[slot] = value;
+
+	if (filter->heap_pos[slot] < offset) {
+		gsize pos = filter->heap_pos[slot];
+
+		if ((filter->high_samples != 0) &&
+		    (value > filter->window[filter->heap[offset]])) {
+			/* Trade places with the smallest of the larger half */
+			heap_set(filter, pos, filter->heap[offset]);
+			heap_set(filter, offset, slot);
+			heap_fix(filter, FALSE, 0);
 		}
 
-		/* Find either the insertion point
-		 * and/or the deletion point
-		 */
-		for (i = 0; i < filter->window_size; i++) {
-			if (filter->ordered_window[i] >= value) {
-				/* Found the insertion point
-				 * (it might be the deletion point
-				 * as well!)
-				 */
-				for ( ; i < filter->window_size; i++) {
-					/* Swap value at insertion
-					 * point and the new value
-					 */
-					int tmp = filter->ordered_window[i];
-
-					filter->ordered_window[i] = value;
-					value = tmp;
-
-					if (value == oldest) {
-						/* Found the deletion point */
-						goto EXIT;
-					}
-				}
-
-				goto EXIT;
-			} else if (filter->ordered_window[i] == oldest) {
-				/* Found the deletion point */
-				for ( ; i < filter->window_size - 1; i++) {
-					if (filter->ordered_window[i + 1] >= value) {
-						/* Found the insertion point */
-						break;
-					}
-					/* Shift the window,
-					 * overwriting the value to delete
-					 */
-					filter->ordered_window[i] = filter->ordered_window[i + 1];
-				}
-				/* Insert */
-				filter->ordered_window[i] = value;
-				goto EXIT;
-			}
+		heap_fix(filter, TRUE, pos);
+	} else {
+		gsize pos = filter->heap_pos[slot] - offset;
+
+		if (value < filter->window[filter->heap[0]]) {
+			/* Trade places with the largest of the smaller half */
+			heap_set(filter, offset + pos, filter->heap[0]);
+			heap_set(filter, 0, slot);
+			heap_fix(filter, TRUE, 0);
 		}
+
+		heap_fix(filter, FALSE, pos);
 	}
 
 EXIT:
@@ -153,8 +451,11 @@ EXIT:
 	 * For even number of samples return the average
 	 * of the two middle ones
 	 */
-	return (filter->ordered_window[(filter->samples - 1) / 2] +
-		filter->ordered_window[filter->samples / 2]) / 2;
+	lower = filter->window[filter->heap[0]];
+
+	return (lower +
+		(((filter->samples % 2) != 0) ? lower :
+		 filter->window[filter->heap[offset]])) / 2;
 }
 
 /**
@@ -168,13 +469,45 @@ gint median_filter_map(median_filter_struct *filter, gint value)
 {
 	gint filtered_value;
 
-	/* Insert into the ordered array (deleting the oldest value) */
-	filtered_value = insert_ordered(filter, value,
-					filter->window[filter->oldest]);
-
 	/* Insert into the ring buffer (overwriting the oldest value) */
-	filter->window[filter->oldest] = value;
+	if ((filter->kernel != NULL) &&
+	    (filter->samples == filter->window_size)) {
+		/* The window is full; the kernel only needs the ring buffer */
+		filter->window[filter->oldest] = value;
+		filtered_value = filter->kernel(filter->window);
+	} else {
+		/* Insert into the heaps (deleting the oldest value) */
+		filtered_value = insert_heap(filter, value);
+	}
+
 	filter->oldest = (filter->oldest + 1) % filter->window_size;
 
 	return filtered_value;
 }
+
+/**
+ * Release the buffers of a median filter
+ *
+ * @param filter The median filter to release
+ */
+void median_filter_free(median_filter_struct *filter)
+{
+	if (filter == NULL)
+		goto EXIT;
+
+	g_free(filter->window);
+	filter->window = NULL;
+	g_free(filter->heap);
+	filter->heap = NULL;
+	g_free(filter->heap_pos);
+	filter->heap_pos = NULL;
+	filter->window_size = 0;
+	filter->samples = 0;
+	filter->oldest = 0;
+	filter->low_samples = 0;
+	filter->high_samples = 0;
+	filter->kernel = NULL;
+
+EXIT:
+	return;
+}
@@ -24,21 +24,52 @@
 
 #include <glib.h>
 
-/** Maximum window size of the median filter */
-#define MEDIAN_FILTER_MAX_WINDOW_SIZE	11
+/**
+ * Largest window size with a specialised median kernel;
+ * larger windows are supported, but use the generic path
+ */
+#define MEDIAN_FILTER_MAX_KERNEL_SIZE	11
 
-/** Median filter */
+/**
+ * Median kernel for a full window of a fixed size
+ *
+ * @param window The samples, in any order
+ * @return The median of the samples
+ */
+typedef gint (*median_filter_kernel_t)(const gint *window);
+
+/**
+ * Median filter
+ *
+ * The filter must be zero-initialised before the first call
+ * to median_filter_init(), and released with median_filter_free()
+ */
 typedef struct {
 	gsize window_size;				/**< Window size */
 	/** Current number of samples in the window */
 	gsize samples;
 	/** Index of the oldest sample in the window */
 	gsize oldest;
-	gint window[MEDIAN_FILTER_MAX_WINDOW_SIZE];	/**< Ring buffer */
-	gint ordered_window[MEDIAN_FILTER_MAX_WINDOW_SIZE];	/**< Ordered buffer */
+	gint *window;					/**< Ring buffer */
+	/** Ring buffer slots of the samples, kept as two heaps;
+	 * a max-heap of the smaller half of the samples,
+	 * followed by a min-heap of the larger half;
+	 * kept while the window isn't full,
+	 * or always if there's no kernel for the window size
+	 */
+	gsize *heap;
+	/** Position of each ring buffer slot in the heaps */
+	gsize *heap_pos;
+	/** Number of samples in the max-heap */
+	gsize low_samples;
+	/** Number of samples in the min-heap */
+	gsize high_samples;
+	/** Kernel for a full window; NULL to use the heaps */
+	median_filter_kernel_t kernel;
 } median_filter_struct;
 
 gboolean median_filter_init(median_filter_struct *filter, gsize window_size);
 gint median_filter_map(median_filter_struct *filter, gint value);
+void median_filter_free(median_filter_struct *filter);
 
 #endif /* _MEDIAN_FILTER_H_ */
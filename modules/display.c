@@ -24,9 +24,11 @@
 
 #include <errno.h>			/* errno */
 #include <fcntl.h>			/* open() */
+#include <math.h>			/* pow() */
 #include <stdio.h>			/* O_RDWR */
 #include <string.h>			/* strcmp() */
 #include <unistd.h>			/* close() */
+#include <linux/input.h>		/* struct input_event, KEY_POWER */
 #include <linux/fb.h>			/* FBIOBLANK,
 					 * FB_BLANK_POWERDOWN,
 					 * FB_BLANK_UNBLANK
@@ -60,11 +62,17 @@
 					 * mce_write_number_string_to_file()
 					 */
 #include "mce-lib.h"			/* strstr_delim(),
+					 * mce_get_monotonic_time_ms(),
 					 * mce_translate_string_to_int_with_default(),
 					 * mce_translation_t
 					 */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add(),
+					 * mce_timer_add_seconds(),
+					 * mce_timer_remove()
+					 */
 #include "mce-conf.h"			/* mce_conf_get_int(),
+					 * mce_conf_get_int_list(),
 					 * mce_conf_get_string()
 					 */
 #include "mce-dbus.h"			/* Direct:
@@ -110,7 +118,9 @@
 					 */
 #include "datapipe.h"			/* datapipe_get_gint(),
 					 * execute_datapipe(),
+					 * append_input_trigger_to_datapipe(),
 					 * append_output_trigger_to_datapipe(),
+					 * remove_input_trigger_from_datapipe(),
 					 * remove_output_trigger_from_datapipe()
 					 */
 #include "tklock.h"
@@ -250,8 +260,26 @@ static const gchar *cabc_mode = DEFAULT_CABC_MODE;
  */
 static const gchar *psm_cabc_mode = NULL;
 
-/** Fadeout step length */
-static gint brightness_fade_steplength = 2;
+/** Perceptual brightness level the fade started from */
+static gint brightness_fade_start_level = 0;
+/** Perceptual brightness level the fade ends at */
+static gint brightness_fade_target_level = 0;
+/** Monotonic time when the fade started, in milliseconds */
+static gint64 brightness_fade_start_time = 0;
+/** Duration of the fade, in milliseconds */
+static gint brightness_fade_duration = 0;
+/**
+ * Perceptual brightness level to raw brightness lookup table;
+ * level 0 is off, level BRIGHTNESS_LUT_SIZE - 1 is full brightness
+ */
+static gint brightness_lut[BRIGHTNESS_LUT_SIZE];
+/** Shortest time between fade updates, in milliseconds */
+static gint brightness_fade_interval =
+				1000 / DEFAULT_BRIGHTNESS_FADE_MAX_RATE;
+/** Number of fade updates during the current fade */
+static guint brightness_fade_wakeups = 0;
+/** Number of brightness writes during the current fade */
+static guint brightness_fade_writes = 0;
 
 /** Brightness fade timeout callback ID */
 static guint brightness_fade_timeout_cb_id = 0;
@@ -261,6 +289,8 @@ static guint dim_timeout_cb_id = 0;
 static guint lpm_timeout_cb_id = 0;
 /** Low power mode proximity blank timeout callback ID */
 static guint lpm_proximity_blank_timeout_cb_id = 0;
+/** Unblank pre-warm timeout callback ID */
+static guint prewarm_timeout_cb_id = 0;
 /** Display blanking timeout callback ID */
 static guint blank_timeout_cb_id = 0;
 
@@ -330,6 +360,52 @@ static const mce_translation_t brightness_change_policy_translation[] = {
 	}
 };
 
+/** Brightness fade easing curves */
+typedef enum {
+	/** Curve not set */
+	BRIGHTNESS_FADE_EASING_INVALID = MCE_INVALID_TRANSLATION,
+	/** Constant speed */
+	BRIGHTNESS_FADE_LINEAR = 0,
+	/** Start slow, end fast */
+	BRIGHTNESS_FADE_EASE_IN = 1,
+	/** Start fast, end slow */
+	BRIGHTNESS_FADE_EASE_OUT = 2,
+	/** Start and end slow */
+	BRIGHTNESS_FADE_EASE_IN_OUT = 3,
+	/** Default setting */
+	DEFAULT_BRIGHTNESS_FADE_EASING = BRIGHTNESS_FADE_LINEAR
+} brightness_fade_easing_t;
+
+/** Mapping of brightness fade easing integer <-> curve string */
+static const mce_translation_t brightness_fade_easing_translation[] = {
+	{
+		.number = BRIGHTNESS_FADE_LINEAR,
+		.string = "linear",
+	}, {
+		.number = BRIGHTNESS_FADE_EASE_IN,
+		.string = "easein",
+	}, {
+		.number = BRIGHTNESS_FADE_EASE_OUT,
+		.string = "easeout",
+	}, {
+		.number = BRIGHTNESS_FADE_EASE_IN_OUT,
+		.string = "easeinout",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** Brightness fade easing curve */
+static brightness_fade_easing_t brightness_fade_easing =
+					DEFAULT_BRIGHTNESS_FADE_EASING;
+
+/**
+ * How long to keep the panel pre-warmed waiting for an unblank,
+ * in milliseconds; 0 to disable pre-warming
+ */
+static gint prewarm_timeout = DEFAULT_PREWARM_TIMEOUT;
+
 /** Real display brightness setting */
 static gint real_disp_brightness = DEFAULT_DISP_BRIGHTNESS;
 
@@ -792,6 +868,585 @@ static void update_display_timers(gboolean force_flush)
 #define update_display_timers(x)			do {} while (0)
 #endif /* USE_LIBCAL */
 
+/** Number of display states accounted; MCE_DISPLAY_OFF - MCE_DISPLAY_ON */
+#define DISPLAY_ENERGY_STATES		(MCE_DISPLAY_ON + 1)
+
+/** Number of CABC modes accounted; the entries in cabc_mode_mapping */
+#define DISPLAY_ENERGY_CABC_MODES	((gint)G_N_ELEMENTS(cabc_mode_mapping) - 1)
+
+/** Display energy accounting counters */
+typedef struct {
+	/** Time spent in each display state; in milliseconds */
+	guint64 state_time[DISPLAY_ENERGY_STATES];
+	/**
+	 * Estimated backlight energy; the brightness integrated over
+	 * time, in permille of the maximum brightness times milliseconds
+	 */
+	guint64 backlight;
+	/** Time spent in high brightness mode; in milliseconds */
+	guint64 hbm_time;
+	/** Time spent in each CABC mode; in milliseconds */
+	guint64 cabc_time[DISPLAY_ENERGY_CABC_MODES];
+} display_energy_t;
+
+/** Display energy accounting counters */
+static display_energy_t display_energy;
+
+/**
+ * Time the display has been kept on by each blanking inhibit client,
+ * in milliseconds, by client name
+ */
+static GHashTable *energy_client_time = NULL;
+
+/**
+ * Clients with an active blanking pause;
+ * the client name by D-Bus sender
+ */
+static GHashTable *energy_pause_clients = NULL;
+
+/**
+ * Pending D-Bus sender to process name lookups;
+ * the D-Bus sender by call serial
+ */
+static GHashTable *energy_pending_lookups = NULL;
+
+/** Monotonic time of the last accounting update, in milliseconds */
+static gint64 energy_last_update = 0;
+
+/** Monotonic time of the last flush to disk, in milliseconds */
+static gint64 energy_last_flush = 0;
+
+/** Display state since the last accounting update */
+static display_state_t energy_display_state = MCE_DISPLAY_UNDEF;
+
+/** Brightness since the last accounting update */
+static gint energy_brightness = 0;
+
+/** High brightness mode level since the last accounting update */
+static gint energy_hbm_level = 0;
+
+/** CABC mode since the last accounting update */
+static const gchar *energy_cabc_mode = NULL;
+
+/**
+ * Add time to a blanking inhibit client
+ *
+ * @param name The name of the client
+ * @param elapsed The time to add, in milliseconds
+ */
+static void energy_add_client_time(const gchar *const name, guint64 elapsed)
+{
+	guint64 *time;
+
+	/* Don't create entries for clients that never kept the display on */
+	if (elapsed == 0)
+		goto EXIT;
+
+	if ((time = g_hash_table_lookup(energy_client_time, name)) == NULL) {
+		time = g_new0(guint64, 1);
+		g_hash_table_insert(energy_client_time, g_strdup(name), time);
+	}
+
+	*time += elapsed;
+
+EXIT:
+	return;
+}
+
+/**
+ * Check whether a client name is an unresolved D-Bus unique name
+ *
+ * @param name The name of the client
+ * @return TRUE if the name is a unique name, FALSE otherwise
+ */
+static gboolean energy_client_is_bus_name(const gchar *const name)
+{
+	return (name[0] == ':');
+}
+
+/**
+ * Update the display energy accounting
+ *
+ * The time since the last update is accounted to the state
+ * at the last update; call this whenever the display state,
+ * brightness, high brightness mode, CABC mode or
+ * blanking inhibit changes
+ */
+static void display_energy_update(void)
+{
+	gint64 now = mce_get_monotonic_time_ms();
+	guint64 elapsed;
+	gint i;
+
+	if (energy_client_time == NULL)
+		goto EXIT;
+
+	elapsed = (guint64)MAX(now - energy_last_update, 0);
+
+	if ((energy_display_state >= 0) &&
+	    (energy_display_state < DISPLAY_ENERGY_STATES))
+		display_energy.state_time[energy_display_state] += elapsed;
+
+	if ((energy_brightness > 0) && (maximum_display_brightness > 0))
+		display_energy.backlight += (elapsed * energy_brightness *
+					     1000) /
+					    maximum_display_brightness;
+
+	if (energy_hbm_level > 0)
+		display_energy.hbm_time += elapsed;
+
+	for (i = 0; i < DISPLAY_ENERGY_CABC_MODES; i++) {
+		if (cabc_mode_mapping[i].sysfs == energy_cabc_mode) {
+			display_energy.cabc_time[i] += elapsed;
+			break;
+		}
+	}
+
+	/* Attribute the time the display was kept on
+	 * to whoever was inhibiting blanking
+	 */
+	if ((blanking_inhibited == TRUE) &&
+	    ((energy_display_state == MCE_DISPLAY_ON) ||
+	     (energy_display_state == MCE_DISPLAY_DIM))) {
+		call_state_t call_state = datapipe_get_gint(call_state_pipe);
+		alarm_ui_state_t alarm_ui_state =
+				datapipe_get_gint(alarm_ui_state_pipe);
+
+		if ((blank_prevent_timeout_cb_id != 0) &&
+		    (g_hash_table_size(energy_pause_clients) != 0)) {
+			GHashTableIter iter;
+			gpointer value;
+
+			g_hash_table_iter_init(&iter, energy_pause_clients);
+
+			while (g_hash_table_iter_next(&iter, NULL,
+						      &value) == TRUE)
+				energy_add_client_time(value, elapsed);
+		} else if (call_state == CALL_STATE_RINGING) {
+			energy_add_client_time(DISPLAY_ENERGY_CLIENT_CALL,
+					       elapsed);
+		} else if (alarm_ui_state == MCE_ALARM_UI_RINGING_INT32) {
+			energy_add_client_time(DISPLAY_ENERGY_CLIENT_ALARM,
+					       elapsed);
+		} else {
+			energy_add_client_time(DISPLAY_ENERGY_CLIENT_SETTING,
+					       elapsed);
+		}
+	}
+
+	energy_last_update = now;
+	energy_display_state = datapipe_get_gint(display_state_pipe);
+	energy_brightness = MAX(cached_brightness, 0);
+	energy_hbm_level = set_hbm_level;
+	energy_cabc_mode = (cabc_supported == TRUE) ? cabc_mode : NULL;
+
+EXIT:
+	return;
+}
+
+/**
+ * Save the display energy accounting counters
+ */
+static void display_energy_save(void)
+{
+	GString *str = g_string_sized_new(512);
+	GHashTableIter iter;
+	GError *error = NULL;
+	gpointer key;
+	gpointer value;
+	gint i;
+
+	for (i = 0; i < DISPLAY_ENERGY_STATES; i++)
+		g_string_append_printf(str, "state%d %" G_GUINT64_FORMAT "\n",
+					i, display_energy.state_time[i]);
+
+	g_string_append_printf(str, "backlight %" G_GUINT64_FORMAT "\n",
+			       display_energy.backlight);
+	g_string_append_printf(str, "hbm %" G_GUINT64_FORMAT "\n",
+			       display_energy.hbm_time);
+
+	for (i = 0; i < DISPLAY_ENERGY_CABC_MODES; i++)
+		g_string_append_printf(str, "cabc%d %" G_GUINT64_FORMAT "\n",
+					i, display_energy.cabc_time[i]);
+
+	g_hash_table_iter_init(&iter, energy_client_time);
+
+	while (g_hash_table_iter_next(&iter, &key, &value) == TRUE) {
+		/* Unique names are never reused, so time left on them
+		 * is only kept while the process name lookup is pending;
+		 * it's never saved
+		 */
+		if (energy_client_is_bus_name(key) == TRUE) {
+			if (g_hash_table_lookup(energy_pause_clients,
+						key) == NULL)
+				g_hash_table_iter_remove(&iter);
+
+			continue;
+		}
+
+		g_string_append_printf(str, "client %" G_GUINT64_FORMAT
+				       " %s\n", *(guint64 *)value,
+				       (gchar *)key);
+	}
+
+	/* g_file_set_contents() replaces the file atomically */
+	if (g_file_set_contents(MCE_DISPLAY_ENERGY_PATH, str->str,
+				str->len, &error) == FALSE) {
+		mce_log(LL_ERR,
+			"Failed to save the display energy accounting; %s",
+			error->message);
+		g_error_free(error);
+	}
+
+	energy_last_flush = mce_get_monotonic_time_ms();
+
+	g_string_free(str, TRUE);
+}
+
+/**
+ * Restore the display energy accounting counters
+ */
+static void display_energy_restore(void)
+{
+	gchar *contents = NULL;
+	gchar **lines = NULL;
+	gint i;
+
+	/* A missing file just means we start from scratch */
+	if (g_file_get_contents(MCE_DISPLAY_ENERGY_PATH, &contents,
+				NULL, NULL) == FALSE)
+		goto EXIT;
+
+	lines = g_strsplit(contents, "\n", 0);
+
+	for (i = 0; lines[i] != NULL; i++) {
+		gchar **fields = g_strsplit(lines[i], " ", 3);
+		guint64 value;
+		gint index;
+
+		if ((fields[0] == NULL) || (fields[1] == NULL))
+			goto NEXT;
+
+		value = g_ascii_strtoull(fields[1], NULL, 10);
+
+		if (sscanf(fields[0], "state%d", &index) == 1) {
+			if ((index >= 0) && (index < DISPLAY_ENERGY_STATES))
+				display_energy.state_time[index] = value;
+		} else if (sscanf(fields[0], "cabc%d", &index) == 1) {
+			if ((index >= 0) &&
+			    (index < DISPLAY_ENERGY_CABC_MODES))
+				display_energy.cabc_time[index] = value;
+		} else if (strcmp(fields[0], "backlight") == 0) {
+			display_energy.backlight = value;
+		} else if (strcmp(fields[0], "hbm") == 0) {
+			display_energy.hbm_time = value;
+		} else if ((strcmp(fields[0], "client") == 0) &&
+			   (fields[2] != NULL) &&
+			   (energy_client_is_bus_name(fields[2]) == FALSE)) {
+			energy_add_client_time(fields[2], value);
+		}
+
+NEXT:
+		g_strfreev(fields);
+	}
+
+EXIT:
+	g_strfreev(lines);
+	g_free(contents);
+}
+
+/**
+ * D-Bus callback for the process ID of a blanking pause client
+ *
+ * @param pending_call The DBusPendingCall
+ * @param data Unused
+ */
+static void energy_client_pid_reply_dbus_cb(DBusPendingCall *pending_call,
+					    void *data)
+{
+	DBusMessage *reply;
+	dbus_uint32_t pid;
+	gpointer serial;
+	gchar *sender = NULL;
+	gchar *path = NULL;
+	gchar *cmdline = NULL;
+	gchar *name = NULL;
+	guint64 *time;
+	gsize length;
+
+	(void)data;
+
+	if ((reply = dbus_pending_call_steal_reply(pending_call)) == NULL)
+		goto EXIT;
+
+	serial = GUINT_TO_POINTER(dbus_message_get_reply_serial(reply));
+
+	if (g_hash_table_lookup_extended(energy_pending_lookups, serial,
+					 NULL, (gpointer *)&sender) == FALSE)
+		goto EXIT2;
+
+	g_hash_table_steal(energy_pending_lookups, serial);
+
+	if (dbus_message_get_args(reply, NULL,
+				  DBUS_TYPE_UINT32, &pid,
+				  DBUS_TYPE_INVALID) == FALSE)
+		goto EXIT2;
+
+	/* Name the client after its executable */
+	path = g_strdup_printf("/proc/%u/cmdline", pid);
+
+	if ((g_file_get_contents(path, &cmdline, &length, NULL) == FALSE) ||
+	    (length == 0) || (cmdline[0] == '\0'))
+		goto EXIT2;
+
+	name = g_path_get_basename(cmdline);
+
+	/* Move the time charged to the bus name so far to the new name */
+	display_energy_update();
+
+	if ((time = g_hash_table_lookup(energy_client_time, sender)) != NULL) {
+		energy_add_client_time(name, *time);
+		g_hash_table_remove(energy_client_time, sender);
+	}
+
+	/* ...and account the time from here on to it too,
+	 * unless the blanking pause has already ended
+	 */
+	if (g_hash_table_lookup(energy_pause_clients, sender) != NULL) {
+		g_hash_table_insert(energy_pause_clients, g_strdup(sender),
+				    name);
+		name = NULL;
+	}
+
+EXIT2:
+	g_free(name);
+	g_free(cmdline);
+	g_free(path);
+	g_free(sender);
+	dbus_message_unref(reply);
+
+EXIT:
+	dbus_pending_call_unref(pending_call);
+
+	return;
+}
+
+/**
+ * Start accounting display on time to a blanking pause client
+ *
+ * @param sender The D-Bus sender of the blanking pause request
+ */
+static void energy_add_pause_client(const gchar *const sender)
+{
+	DBusMessage *msg;
+
+	if ((energy_pause_clients == NULL) ||
+	    (g_hash_table_lookup(energy_pause_clients, sender) != NULL))
+		goto EXIT;
+
+	display_energy_update();
+
+	/* Use the bus name until we know the process name */
+	g_hash_table_insert(energy_pause_clients,
+			    g_strdup(sender), g_strdup(sender));
+
+	msg = dbus_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+				   DBUS_INTERFACE_DBUS,
+				   "GetConnectionUnixProcessID");
+
+	if (dbus_message_append_args(msg,
+				     DBUS_TYPE_STRING, &sender,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		dbus_message_unref(msg);
+		goto EXIT;
+	}
+
+	/* The serial is only assigned when the message is sent */
+	dbus_message_ref(msg);
+
+	if (dbus_send_message_with_reply_handler(msg,
+			energy_client_pid_reply_dbus_cb) == TRUE)
+		g_hash_table_insert(energy_pending_lookups,
+				    GUINT_TO_POINTER(dbus_message_get_serial(msg)),
+				    g_strdup(sender));
+
+	dbus_message_unref(msg);
+
+EXIT:
+	return;
+}
+
+/**
+ * Stop accounting display on time to blanking pause clients
+ *
+ * @param sender The D-Bus sender of the blanking pause request;
+ *               NULL to remove all clients
+ */
+static void energy_remove_pause_client(const gchar *const sender)
+{
+	if (energy_pause_clients == NULL)
+		goto EXIT;
+
+	display_energy_update();
+
+	if (sender != NULL)
+		g_hash_table_remove(energy_pause_clients, sender);
+	else
+		g_hash_table_remove_all(energy_pause_clients);
+
+EXIT:
+	return;
+}
+
+/**
+ * Flush the display energy accounting to disk,
+ * unless that was done recently
+ */
+static void display_energy_flush(void)
+{
+	if (energy_client_time == NULL)
+		goto EXIT;
+
+	display_energy_update();
+
+	if ((mce_get_monotonic_time_ms() - energy_last_flush) <
+	    DISPLAY_ENERGY_FLUSH_INTERVAL * 1000)
+		goto EXIT;
+
+	display_energy_save();
+
+EXIT:
+	return;
+}
+
+/**
+ * D-Bus callback for the display energy accounting get method call
+ *
+ * @param msg The D-Bus message to reply to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean display_energy_get_dbus_cb(DBusMessage *const msg)
+{
+	dbus_uint64_t state_time_array[DISPLAY_ENERGY_STATES];
+	dbus_uint64_t cabc_time_array[DISPLAY_ENERGY_CABC_MODES];
+	dbus_uint64_t *state_times = state_time_array;
+	dbus_uint64_t *cabc_times = cabc_time_array;
+	dbus_uint64_t backlight;
+	dbus_uint64_t hbm_time;
+	const gchar *cabc_modes[DISPLAY_ENERGY_CABC_MODES];
+	const gchar **clients;
+	dbus_uint64_t *client_times;
+	DBusMessage *reply = NULL;
+	gboolean status = FALSE;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	gint count;
+	gint i;
+
+	mce_log(LL_DEBUG, "Received display energy accounting get request");
+
+	display_energy_update();
+
+	for (i = 0; i < DISPLAY_ENERGY_STATES; i++)
+		state_time_array[i] = display_energy.state_time[i];
+
+	for (i = 0; i < DISPLAY_ENERGY_CABC_MODES; i++) {
+		cabc_modes[i] = cabc_mode_mapping[i].dbus;
+		cabc_time_array[i] = display_energy.cabc_time[i];
+	}
+
+	backlight = display_energy.backlight;
+	hbm_time = display_energy.hbm_time;
+
+	count = g_hash_table_size(energy_client_time);
+	clients = g_new0(const gchar *, count + 1);
+	client_times = g_new0(dbus_uint64_t, count + 1);
+
+	g_hash_table_iter_init(&iter, energy_client_time);
+
+	for (i = 0; g_hash_table_iter_next(&iter, &key, &value) == TRUE; i++) {
+		clients[i] = key;
+		client_times[i] = *(guint64 *)value;
+	}
+
+	/* Create a reply */
+	reply = dbus_new_method_reply(msg);
+
+	if (dbus_message_append_args(reply,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64,
+				     &state_times, DISPLAY_ENERGY_STATES,
+				     DBUS_TYPE_UINT64, &backlight,
+				     DBUS_TYPE_UINT64, &hbm_time,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+				     &cabc_modes, DISPLAY_ENERGY_CABC_MODES,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64,
+				     &cabc_times, DISPLAY_ENERGY_CABC_MODES,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+				     &clients, count,
+				     DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64,
+				     &client_times, count,
+				     DBUS_TYPE_INVALID) == FALSE) {
+		mce_log(LL_CRIT,
+			"Failed to append reply arguments to D-Bus message "
+			"for %s.%s",
+			MCE_REQUEST_IF, MCE_DISPLAY_ENERGY_GET);
+		dbus_message_unref(reply);
+		goto EXIT;
+	}
+
+	/* Send the message */
+	status = dbus_send_message(reply);
+
+EXIT:
+	g_free(clients);
+	g_free(client_times);
+
+	return status;
+}
+
+/**
+ * Init function for the display energy accounting
+ */
+static void display_energy_init(void)
+{
+	energy_client_time = g_hash_table_new_full(g_str_hash, g_str_equal,
+						   g_free, g_free);
+	energy_pause_clients = g_hash_table_new_full(g_str_hash, g_str_equal,
+						     g_free, g_free);
+	energy_pending_lookups = g_hash_table_new_full(g_direct_hash,
+						       g_direct_equal,
+						       NULL, g_free);
+
+	display_energy_restore();
+
+	energy_last_update = mce_get_monotonic_time_ms();
+	energy_last_flush = energy_last_update;
+	display_energy_update();
+}
+
+/**
+ * Exit function for the display energy accounting
+ */
+static void display_energy_exit(void)
+{
+	if (energy_client_time == NULL)
+		goto EXIT;
+
+	display_energy_update();
+	display_energy_save();
+
+	g_hash_table_destroy(energy_pending_lookups);
+	energy_pending_lookups = NULL;
+	g_hash_table_destroy(energy_pause_clients);
+	energy_pause_clients = NULL;
+	g_hash_table_destroy(energy_client_time);
+	energy_client_time = NULL;
+
+EXIT:
+	return;
+}
+
 /**
  * Timeout callback for the high brightness mode
  *
@@ -808,6 +1463,7 @@ static gboolean hbm_timeout_cb(gpointer data)
 	(void)mce_write_number_string_to_file(high_brightness_mode_file, 0, &high_brightness_mode_fp, TRUE, FALSE);
 	set_hbm_level = 0;
 	update_display_timers(FALSE);
+	display_energy_update();
 
 	return FALSE;
 }
@@ -819,7 +1475,7 @@ static void cancel_hbm_timeout(void)
 {
 	/* Remove the timeout source for the high brightness mode */
 	if (hbm_timeout_cb_id != 0) {
-		g_source_remove(hbm_timeout_cb_id);
+		mce_timer_remove(hbm_timeout_cb_id);
 		hbm_timeout_cb_id = 0;
 	}
 }
@@ -832,7 +1488,7 @@ static void setup_hbm_timeout(void)
 	cancel_hbm_timeout();
 
 	/* Setup new timeout */
-	hbm_timeout_cb_id = g_timeout_add_seconds(DEFAULT_HBM_TIMEOUT,
+	hbm_timeout_cb_id = mce_timer_add_seconds(DEFAULT_HBM_TIMEOUT,
 						  hbm_timeout_cb, NULL);
 }
 
@@ -856,11 +1512,13 @@ static void update_high_brightness_mode(gint hbm_level)
 			(void)mce_write_number_string_to_file(high_brightness_mode_file, 0, &high_brightness_mode_fp, TRUE, FALSE);
 			set_hbm_level = 0;
 			update_display_timers(FALSE);
+			display_energy_update();
 		}
 	} else if (set_hbm_level != hbm_level) {
 		(void)mce_write_number_string_to_file(high_brightness_mode_file, hbm_level, &high_brightness_mode_fp, TRUE, FALSE);
 		set_hbm_level = hbm_level;
 		update_display_timers(FALSE);
+		display_energy_update();
 	}
 
 	/**
@@ -922,6 +1580,7 @@ static void set_cabc_mode(const gchar *const mode)
 			if (psm_cabc_mode == NULL)
 				cabc_mode = tmp;
 
+			display_energy_update();
 			break;
 		}
 	}
@@ -994,33 +1653,170 @@ EXIT:
 }
 
 /**
- * Timeout callback for the brightness fade
+ * Build the perceptual brightness lookup table for the panel
  *
- * @param data Unused
- * @return Returns TRUE to repeat, until the cached brightness has reached
- *         the destination value; when this happens, FALSE is returned
+ * The table is generated from [Display] BrightnessGamma,
+ * or from the [Display] BrightnessCurve control points if
+ * the gamma is 0; the raw values are scaled to the maximum
+ * brightness of the panel
  */
-static gboolean brightness_fade_timeout_cb(gpointer data)
+static void build_brightness_lut(void)
 {
-	gboolean retval = TRUE;
+	const gint last = BRIGHTNESS_LUT_SIZE - 1;
+	gint *curve = NULL;
+	gsize points = 0;
+	gint gamma;
+	gint i;
 
-	(void)data;
+	gamma = mce_conf_get_int(MCE_CONF_DISPLAY_GROUP,
+				 MCE_CONF_BRIGHTNESS_GAMMA,
+				 DEFAULT_BRIGHTNESS_GAMMA,
+				 NULL);
 
-	if ((cached_brightness <= 0) && (target_brightness != 0)) {
-		backlight_ioctl(FB_BLANK_UNBLANK);
+	if (gamma <= 0) {
+		curve = mce_conf_get_int_list(MCE_CONF_DISPLAY_GROUP,
+					      MCE_CONF_BRIGHTNESS_CURVE,
+					      &points, NULL);
+
+		if ((curve == NULL) || (points < 2)) {
+			mce_log(LL_WARN,
+				"Invalid brightness curve; "
+				"using the default gamma");
+			gamma = DEFAULT_BRIGHTNESS_GAMMA;
+		}
 	}
 
-	if ((cached_brightness == -1) ||
-	    (ABS(cached_brightness -
-		 target_brightness) < brightness_fade_steplength)) {
-		cached_brightness = target_brightness;
-		retval = FALSE;
-	} else if (target_brightness > cached_brightness) {
-		cached_brightness += brightness_fade_steplength;
-	} else {
-		cached_brightness -= brightness_fade_steplength;
+	for (i = 0; i <= last; i++) {
+		gint raw;
+
+		if (gamma > 0) {
+			raw = (gint)(maximum_display_brightness *
+				     pow((gdouble)i / last,
+					 gamma / 100.0) + 0.5);
+		} else {
+			/* Interpolate between evenly spaced control points,
+			 * given in percent of the maximum brightness
+			 */
+			gint pos = i * (points - 1);
+			gint seg = pos / last;
+			gint frac = pos % last;
+			gint pct = curve[seg] * last;
+
+			if (frac != 0)
+				pct += (curve[seg + 1] - curve[seg]) * frac;
+
+			raw = (maximum_display_brightness * pct +
+			       (last * 100) / 2) / (last * 100);
+		}
+
+		raw = CLAMP(raw, 0, maximum_display_brightness);
+
+		/* Keep the table monotonic, and only level 0 off */
+		if (i > 0)
+			raw = MAX(raw, MAX(brightness_lut[i - 1], 1));
+
+		brightness_lut[i] = raw;
 	}
 
+	brightness_lut[0] = 0;
+
+	g_free(curve);
+}
+
+/**
+ * Map a brightness percentage to a raw brightness value
+ *
+ * @param percent The brightness, in percent
+ * @return The raw brightness value
+ */
+static gint brightness_percent_to_raw(gint percent)
+{
+	percent = CLAMP(percent, 0, 100);
+
+	return brightness_lut[(percent * (BRIGHTNESS_LUT_SIZE - 1) + 50) /
+			      100];
+}
+
+/**
+ * Map a raw brightness value to a perceptual brightness level
+ *
+ * @param raw The raw brightness value
+ * @return The lowest level with at least the given brightness
+ */
+static gint brightness_raw_to_level(gint raw)
+{
+	gint lo = 0;
+	gint hi = BRIGHTNESS_LUT_SIZE - 1;
+
+	while (lo < hi) {
+		gint mid = (lo + hi) / 2;
+
+		if (brightness_lut[mid] < raw)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/**
+ * Apply the easing curve to the progress of the fade
+ *
+ * @param progress The elapsed part of the fade,
+ *                 0 - BRIGHTNESS_FADE_PRECISION
+ * @return The faded part of the brightness difference,
+ *         0 - BRIGHTNESS_FADE_PRECISION
+ */
+static gint brightness_fade_ease(gint progress)
+{
+	const gint one = BRIGHTNESS_FADE_PRECISION;
+	gint eased;
+
+	switch (brightness_fade_easing) {
+	case BRIGHTNESS_FADE_EASE_IN:
+		eased = (progress * progress) / one;
+		break;
+
+	case BRIGHTNESS_FADE_EASE_OUT:
+		eased = one - ((one - progress) * (one - progress)) / one;
+		break;
+
+	case BRIGHTNESS_FADE_EASE_IN_OUT:
+		if (progress < one / 2)
+			eased = (2 * progress * progress) / one;
+		else
+			eased = one - (2 * (one - progress) *
+				       (one - progress)) / one;
+		break;
+
+	case BRIGHTNESS_FADE_LINEAR:
+	default:
+		eased = progress;
+		break;
+	}
+
+	return eased;
+}
+
+/**
+ * Write a new brightness during a fade; unchanged values are skipped
+ *
+ * @param brightness The brightness to write
+ */
+static void brightness_fade_write(gint brightness)
+{
+	if (brightness == cached_brightness)
+		goto EXIT;
+
+	if ((cached_brightness <= 0) && (brightness != 0)) {
+		backlight_ioctl(FB_BLANK_UNBLANK);
+	}
+
+	cached_brightness = brightness;
+	brightness_fade_writes++;
+	display_energy_update();
+
 	mce_write_number_string_to_file(brightness_file,
 					cached_brightness,
 					&brightness_fp, TRUE, FALSE);
@@ -1029,10 +1825,70 @@ static gboolean brightness_fade_timeout_cb(gpointer data)
 		backlight_ioctl(FB_BLANK_POWERDOWN);
 	}
 
-	if (retval == FALSE)
-		 brightness_fade_timeout_cb_id = 0;
+EXIT:
+	return;
+}
+
+/**
+ * Timeout callback for the brightness fade
+ *
+ * The brightness is computed from the time elapsed since the fade
+ * started, so late or skipped updates don't slow the fade down;
+ * the fade is rescheduled no more often than brightness_fade_interval,
+ * and never past the end of the fade
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean brightness_fade_timeout_cb(gpointer data)
+{
+	gint64 elapsed = mce_get_monotonic_time_ms() -
+			 brightness_fade_start_time;
+	gint delta = brightness_fade_target_level -
+		     brightness_fade_start_level;
+	gint progress;
+	gint delay;
+
+	(void)data;
+
+	brightness_fade_timeout_cb_id = 0;
+	brightness_fade_wakeups++;
+
+	if ((cached_brightness == -1) ||
+	    (elapsed >= brightness_fade_duration)) {
+		brightness_fade_write(target_brightness);
+
+		mce_log(LL_DEBUG,
+			"Brightness fade to %d done in %lld ms; "
+			"%u wakeups, %u writes",
+			target_brightness, (long long)elapsed,
+			brightness_fade_wakeups, brightness_fade_writes);
+		goto EXIT;
+	}
+
+	progress = (gint)((elapsed * BRIGHTNESS_FADE_PRECISION) /
+			  brightness_fade_duration);
+	brightness_fade_write(brightness_lut[brightness_fade_start_level +
+					     (delta *
+					      brightness_fade_ease(progress)) /
+					     BRIGHTNESS_FADE_PRECISION]);
+
+	/* There's no point in updating more often than
+	 * the brightness can change on average
+	 */
+	delay = MAX(brightness_fade_interval,
+		    brightness_fade_duration /
+		    MAX(MIN(ABS(delta),
+			    ABS(target_brightness -
+				brightness_lut[brightness_fade_start_level])),
+			1));
+	delay = MIN(delay, brightness_fade_duration - (gint)elapsed);
+
+	brightness_fade_timeout_cb_id =
+		mce_timer_add(delay, brightness_fade_timeout_cb, NULL);
 
-	return retval;
+EXIT:
+	return FALSE;
 }
 
 /**
@@ -1042,7 +1898,7 @@ static void cancel_brightness_fade_timeout(void)
 {
 	/* Remove the timeout source for the display brightness fade */
 	if (brightness_fade_timeout_cb_id != 0) {
-		g_source_remove(brightness_fade_timeout_cb_id);
+		mce_timer_remove(brightness_fade_timeout_cb_id);
 		brightness_fade_timeout_cb_id = 0;
 	}
 }
@@ -1050,15 +1906,43 @@ static void cancel_brightness_fade_timeout(void)
 /**
  * Setup the brightness fade timeout
  *
- * @param step_time The time between each brightness step
+ * @param duration The duration of the fade, in milliseconds
  */
-static void setup_brightness_fade_timeout(gint step_time)
+static void setup_brightness_fade_timeout(gint duration)
 {
 	cancel_brightness_fade_timeout();
 
+	brightness_fade_start_level =
+		brightness_raw_to_level(cached_brightness);
+	brightness_fade_target_level =
+		brightness_raw_to_level(target_brightness);
+	brightness_fade_start_time = mce_get_monotonic_time_ms();
+	brightness_fade_duration = duration;
+	brightness_fade_wakeups = 0;
+	brightness_fade_writes = 0;
+
 	/* Setup new timeout */
 	brightness_fade_timeout_cb_id =
-		g_timeout_add(step_time, brightness_fade_timeout_cb, NULL);
+		mce_timer_add(brightness_fade_interval,
+			      brightness_fade_timeout_cb, NULL);
+}
+
+/**
+ * Get the duration of a fade with the step-time policy
+ *
+ * @param step_time The step time in milliseconds
+ * @param steps The number of brightness levels to fade
+ * @return The duration of the fade in milliseconds
+ */
+static gint get_step_time_fade_duration(gint step_time, gint steps)
+{
+	/* Special case; a step time of 5 has always meant
+	 * 2 levels every 2 ms, that is, 1 ms per level
+	 */
+	if (step_time == 5)
+		step_time = 1;
+
+	return step_time * steps;
 }
 
 /**
@@ -1071,7 +1955,8 @@ static void setup_brightness_fade_timeout(gint step_time)
 static void update_brightness_fade(gint new_brightness)
 {
 	gboolean increase = (new_brightness >= cached_brightness);
-	gint step_time = 10;
+	gint steps = ABS(new_brightness - cached_brightness);
+	gint duration;
 
 	/* This should never happen, but just in case */
 	if (cached_brightness == new_brightness)
@@ -1092,6 +1977,7 @@ static void update_brightness_fade(gint new_brightness)
 		mce_write_number_string_to_file(brightness_file,
 						new_brightness,
 						&brightness_fp, TRUE, FALSE);
+		display_energy_update();
 		goto EXIT;
 	}
 
@@ -1105,29 +1991,19 @@ static void update_brightness_fade(gint new_brightness)
 
 	if (increase == TRUE) {
 		if (brightness_increase_policy == BRIGHTNESS_CHANGE_STEP_TIME)
-			step_time = brightness_increase_step_time;
-		else {
-			step_time = brightness_increase_constant_time /
-				    (new_brightness - cached_brightness);
-		}
+			duration = get_step_time_fade_duration(
+				brightness_increase_step_time, steps);
+		else
+			duration = brightness_increase_constant_time;
 	} else {
 		if (brightness_decrease_policy == BRIGHTNESS_CHANGE_STEP_TIME)
-			step_time = brightness_decrease_step_time;
-		else {
-			step_time = brightness_decrease_constant_time /
-				    (cached_brightness - new_brightness);
-		}
-	}
-
-	/* Special case */
-	if (step_time == 5) {
-		step_time = 2;
-		brightness_fade_steplength = 2;
-	} else {
-		brightness_fade_steplength = 1;
+			duration = get_step_time_fade_duration(
+				brightness_decrease_step_time, steps);
+		else
+			duration = brightness_decrease_constant_time;
 	}
 
-	setup_brightness_fade_timeout(step_time);
+	setup_brightness_fade_timeout(duration);
 
 EXIT:
 	return;
@@ -1144,6 +2020,7 @@ static void display_blank(void)
 	mce_write_number_string_to_file(brightness_file, 0,
 					&brightness_fp, TRUE, FALSE);
 	backlight_ioctl(FB_BLANK_POWERDOWN);
+	display_energy_update();
 }
 
 /**
@@ -1170,6 +2047,7 @@ static void display_dim(void)
 		mce_write_number_string_to_file(brightness_file,
 						dim_brightness,
 						&brightness_fp, TRUE, FALSE);
+		display_energy_update();
 	} else {
 		update_brightness_fade(dim_brightness);
 	}
@@ -1190,11 +2068,86 @@ static void display_unblank(void)
 		mce_write_number_string_to_file(brightness_file,
 						set_brightness,
 						&brightness_fp, TRUE, FALSE);
+		display_energy_update();
 	} else {
 		update_brightness_fade(set_brightness);
 	}
 }
 
+/**
+ * Timeout callback for the unblank pre-warm;
+ * powers the panel down again, since no unblank followed
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean prewarm_timeout_cb(gpointer data)
+{
+	display_state_t display_state = datapipe_get_gint(display_state_pipe);
+
+	(void)data;
+
+	prewarm_timeout_cb_id = 0;
+
+	if ((display_state == MCE_DISPLAY_OFF) ||
+	    (display_state == MCE_DISPLAY_LPM_OFF)) {
+		mce_log(LL_DEBUG, "No unblank after pre-warm; "
+			"powering the panel down");
+		backlight_ioctl(FB_BLANK_POWERDOWN);
+	}
+
+	return FALSE;
+}
+
+/**
+ * Cancel the unblank pre-warm timeout
+ */
+static void cancel_prewarm_timeout(void)
+{
+	if (prewarm_timeout_cb_id != 0) {
+		mce_timer_remove(prewarm_timeout_cb_id);
+		prewarm_timeout_cb_id = 0;
+	}
+}
+
+/**
+ * Pre-warm the display for an unblank that's likely to follow
+ *
+ * Powers up the panel while the backlight stays off,
+ * and makes sure the brightness file is open,
+ * so that the unblank itself only needs the brightness write;
+ * if no unblank follows within prewarm_timeout,
+ * the panel is powered down again
+ */
+static void display_prewarm(void)
+{
+	display_state_t display_state = datapipe_get_gint(display_state_pipe);
+
+	if ((prewarm_timeout == 0) ||
+	    ((display_state != MCE_DISPLAY_OFF) &&
+	     (display_state != MCE_DISPLAY_LPM_OFF)))
+		goto EXIT;
+
+	if (prewarm_timeout_cb_id == 0) {
+		mce_log(LL_DEBUG, "Pre-warming the panel for unblank");
+
+		if (brightness_fp == NULL)
+			mce_write_number_string_to_file(brightness_file, 0,
+							&brightness_fp,
+							TRUE, FALSE);
+
+		backlight_ioctl(FB_BLANK_UNBLANK);
+	} else {
+		mce_timer_remove(prewarm_timeout_cb_id);
+	}
+
+	prewarm_timeout_cb_id = mce_timer_add(prewarm_timeout,
+					      prewarm_timeout_cb, NULL);
+
+EXIT:
+	return;
+}
+
 /**
  * Display brightness trigger
  *
@@ -1220,7 +2173,7 @@ static void display_brightness_trigger(gconstpointer data)
 	/* Adjust the value, since it's a percentage value, and filter out
 	 * the high brightness setting
 	 */
-	new_brightness = (maximum_display_brightness * new_brightness) / 100;
+	new_brightness = brightness_percent_to_raw(new_brightness);
 
 	/* If we're just rehashing the same brightness value, don't bother */
 	if ((new_brightness == cached_brightness) &&
@@ -1275,7 +2228,7 @@ static void cancel_blank_timeout(void)
 {
 	/* Remove the timeout source for display blanking */
 	if (blank_timeout_cb_id != 0) {
-		g_source_remove(blank_timeout_cb_id);
+		mce_timer_remove(blank_timeout_cb_id);
 		blank_timeout_cb_id = 0;
 	}
 }
@@ -1307,7 +2260,7 @@ static void setup_blank_timeout(void)
 
 	/* Setup new timeout */
 	blank_timeout_cb_id =
-		g_timeout_add_seconds(timeout, blank_timeout_cb, NULL);
+		mce_timer_add_seconds(timeout, blank_timeout_cb, NULL);
 
 EXIT:
 	return;
@@ -1339,7 +2292,7 @@ static void cancel_lpm_proximity_blank_timeout(void)
 {
 	/* Remove the timeout source for low power mode */
 	if (lpm_proximity_blank_timeout_cb_id != 0) {
-		g_source_remove(lpm_proximity_blank_timeout_cb_id);
+		mce_timer_remove(lpm_proximity_blank_timeout_cb_id);
 		lpm_proximity_blank_timeout_cb_id = 0;
 	}
 }
@@ -1363,7 +2316,7 @@ static void setup_lpm_proximity_blank_timeout(void)
 		timeout = 0;
 
 	lpm_proximity_blank_timeout_cb_id =
-		g_timeout_add_seconds(timeout,
+		mce_timer_add_seconds(timeout,
 				      lpm_proximity_blank_timeout_cb, NULL);
 }
 
@@ -1393,7 +2346,7 @@ static void cancel_lpm_timeout(void)
 {
 	/* Remove the timeout source for low power mode */
 	if (lpm_timeout_cb_id != 0) {
-		g_source_remove(lpm_timeout_cb_id);
+		mce_timer_remove(lpm_timeout_cb_id);
 		lpm_timeout_cb_id = 0;
 	}
 }
@@ -1415,7 +2368,7 @@ static void setup_lpm_timeout(void)
 	     (is_dismiss_low_power_mode_enabled() == FALSE))) {
 		/* Setup new timeout */
 		lpm_timeout_cb_id =
-			g_timeout_add_seconds(disp_lpm_timeout,
+			mce_timer_add_seconds(disp_lpm_timeout,
 					      lpm_timeout_cb, NULL);
 	} else {
 		setup_blank_timeout();
@@ -1445,7 +2398,7 @@ static void cancel_adaptive_dimming_timeout(void)
 {
 	/* Remove the timeout source for adaptive dimming */
 	if (adaptive_dimming_timeout_cb_id != 0) {
-		g_source_remove(adaptive_dimming_timeout_cb_id);
+		mce_timer_remove(adaptive_dimming_timeout_cb_id);
 		adaptive_dimming_timeout_cb_id = 0;
 	}
 }
@@ -1460,9 +2413,11 @@ static void setup_adaptive_dimming_timeout(void)
 	if (adaptive_dimming_enabled == FALSE)
 		goto EXIT;
 
-	/* Setup new timeout */
+	/* Setup new timeout; it only runs while the display is dimmed,
+	 * so it never gets held like the display-on timeouts
+	 */
 	adaptive_dimming_timeout_cb_id =
-		g_timeout_add_seconds(adaptive_dimming_threshold,
+		mce_timer_add_seconds(adaptive_dimming_threshold,
 				      adaptive_dimming_timeout_cb, NULL);
 
 EXIT:
@@ -1506,7 +2461,7 @@ static void cancel_dim_timeout(void)
 {
 	/* Remove the timeout source for display dimming */
 	if (dim_timeout_cb_id != 0) {
-		g_source_remove(dim_timeout_cb_id);
+		mce_timer_remove(dim_timeout_cb_id);
 		dim_timeout_cb_id = 0;
 	}
 }
@@ -1540,7 +2495,7 @@ static void setup_dim_timeout(void)
 
 	/* Setup new timeout */
 	dim_timeout_cb_id =
-		g_timeout_add_seconds(dim_timeout,
+		mce_timer_add_seconds(dim_timeout,
 				      dim_timeout_cb, NULL);
 }
 
@@ -1558,6 +2513,7 @@ static gboolean blank_prevent_timeout_cb(gpointer data)
 
 	/* Remove all name monitors for the blanking pause requester */
 	mce_dbus_owner_monitor_remove_all(&blanking_pause_monitor_list);
+	energy_remove_pause_client(NULL);
 
 	update_blanking_inhibit(FALSE);
 
@@ -1570,7 +2526,7 @@ static gboolean blank_prevent_timeout_cb(gpointer data)
 static void cancel_blank_prevent(void)
 {
 	if (blank_prevent_timeout_cb_id != 0) {
-		g_source_remove(blank_prevent_timeout_cb_id);
+		mce_timer_remove(blank_prevent_timeout_cb_id);
 		blank_prevent_timeout_cb_id = 0;
 	}
 }
@@ -1585,7 +2541,7 @@ static void request_display_blanking_pause(void)
 
 	/* Setup new timeout */
 	blank_prevent_timeout_cb_id =
-		g_timeout_add_seconds(blank_prevent_timeout,
+		mce_timer_add_seconds(blank_prevent_timeout,
 				      blank_prevent_timeout_cb, NULL);
 }
 
@@ -1647,6 +2603,8 @@ static void update_blanking_inhibit(gboolean timed_inhibit)
 		dimming_inhibited = FALSE;
 	}
 
+	display_energy_update();
+
 	/* Reprogram timeouts, if necessary */
 	if (display_state == MCE_DISPLAY_ON)
 		setup_dim_timeout();
@@ -2187,6 +3145,7 @@ static gboolean remove_blanking_pause(const gchar *name)
 	 */
 	count = mce_dbus_owner_monitor_remove(name,
 					      &blanking_pause_monitor_list);
+	energy_remove_pause_client(name);
 
 	if (count == 0) {
 		cancel_blank_prevent();
@@ -2301,6 +3260,7 @@ static gboolean display_blanking_pause_req_dbus_cb(DBusMessage *const msg)
 
 	request_display_blanking_pause();
 	inhibit_devicelock();
+	energy_add_pause_client(sender);
 
 	if (mce_dbus_owner_monitor_add(sender,
 				       blanking_pause_owner_monitor_dbus_cb,
@@ -2663,6 +3623,11 @@ static void display_state_trigger(gconstpointer data)
 	if (cached_display_state == display_state)
 		goto EXIT;
 
+	/* The unblank consumes the pre-warmed panel;
+	 * anything else blanks or keeps it powered anyway
+	 */
+	cancel_prewarm_timeout();
+
 	update_high_brightness_mode(cached_hbm_level);
 
 	switch (display_state) {
@@ -2697,6 +3662,13 @@ static void display_state_trigger(gconstpointer data)
 	/* Update display on timers */
 	update_display_timers(FALSE);
 
+	/* Save the energy accounting while the display is off anyway */
+	if ((display_state == MCE_DISPLAY_OFF) ||
+	    (display_state == MCE_DISPLAY_LPM_OFF))
+		display_energy_flush();
+	else
+		display_energy_update();
+
 EXIT:
 	return;
 }
@@ -2887,6 +3859,18 @@ static void proximity_sensor_trigger(gconstpointer data)
 	} else {
 		cancel_lpm_proximity_blank_timeout();
 
+		/* Uncovering the proximity sensor during a call
+		 * is likely to unblank the display
+		 */
+		if (proximity_sensor_state == COVER_OPEN) {
+			call_state_t call_state =
+				datapipe_get_gint(call_state_pipe);
+
+			if ((call_state == CALL_STATE_RINGING) ||
+			    (call_state == CALL_STATE_ACTIVE))
+				display_prewarm();
+		}
+
 		if (display_state == MCE_DISPLAY_LPM_OFF) {
 			(void)execute_datapipe(&display_state_pipe,
 					       GINT_TO_POINTER(MCE_DISPLAY_LPM_ON),
@@ -2895,6 +3879,44 @@ static void proximity_sensor_trigger(gconstpointer data)
 	}
 }
 
+/**
+ * Pre-warm the display when the power key is pressed;
+ * this runs before the powerkey logic decides what the press means
+ *
+ * @param data The keypress event
+ */
+static void keypress_trigger(gconstpointer const data)
+{
+	struct input_event const *const *evp;
+	struct input_event const *ev;
+
+	/* Don't dereference until we know it's safe */
+	if (data == NULL)
+		goto EXIT;
+
+	evp = data;
+	ev = *evp;
+
+	if ((ev != NULL) && (ev->code == KEY_POWER) && (ev->value == 1))
+		display_prewarm();
+
+EXIT:
+	return;
+}
+
+/**
+ * Pre-warm the display when the keyboard slide is opened
+ *
+ * @param data The keyboard slide state stored in a pointer
+ */
+static void keyboard_slide_trigger(gconstpointer const data)
+{
+	cover_state_t kbd_slide_state = GPOINTER_TO_INT(data);
+
+	if (kbd_slide_state == COVER_OPEN)
+		display_prewarm();
+}
+
 /**
  * Handle alarm UI state change
  *
@@ -2922,6 +3944,7 @@ const gchar *g_module_check_init(GModule *module)
 	display_state_t init_display_state = MCE_DISPLAY_ON;
 	submode_t submode = mce_get_submode_int32();
 	gchar *str = NULL;
+	gint fade_max_rate;
 	gulong tmp;
 
 	(void)module;
@@ -2961,6 +3984,10 @@ const gchar *g_module_check_init(GModule *module)
 					  proximity_sensor_trigger);
 	append_output_trigger_to_datapipe(&alarm_ui_state_pipe,
 					  alarm_ui_state_trigger);
+	append_input_trigger_to_datapipe(&keypress_pipe,
+					 keypress_trigger);
+	append_input_trigger_to_datapipe(&keyboard_slide_pipe,
+					 keyboard_slide_trigger);
 
 	/* Get maximum brightness */
 	if (mce_read_number_string_from_file(max_brightness_file,
@@ -2975,8 +4002,8 @@ const gchar *g_module_check_init(GModule *module)
 	}
 
 	maximum_display_brightness = tmp;
-	dim_brightness = (maximum_display_brightness *
-			  DEFAULT_DIM_BRIGHTNESS) / 100;
+	build_brightness_lut();
+	dim_brightness = brightness_percent_to_raw(DEFAULT_DIM_BRIGHTNESS);
 
 	set_cabc_mode(DEFAULT_CABC_MODE);
 
@@ -3045,6 +4072,17 @@ const gchar *g_module_check_init(GModule *module)
 				 cabc_mode_req_dbus_cb) == NULL)
 		goto EXIT;
 
+	/* The energy accounting must be set up before its getter */
+	display_energy_init();
+
+	/* get_display_energy_stats */
+	if (mce_dbus_handler_add(MCE_REQUEST_IF,
+				 MCE_DISPLAY_ENERGY_GET,
+				 NULL,
+				 DBUS_MESSAGE_TYPE_METHOD_CALL,
+				 display_energy_get_dbus_cb) == NULL)
+		goto EXIT;
+
 	/* Desktop readiness signal */
 	if (mce_dbus_handler_add("com.nokia.startup.signal",
 				 "desktop_visible",
@@ -3237,6 +4275,32 @@ const gchar *g_module_check_init(GModule *module)
 				 DEFAULT_BRIGHTNESS_DECREASE_CONSTANT_TIME,
 				 NULL);
 
+	prewarm_timeout = mce_conf_get_int(MCE_CONF_DISPLAY_GROUP,
+					   MCE_CONF_PREWARM_TIMEOUT,
+					   DEFAULT_PREWARM_TIMEOUT,
+					   NULL);
+
+	if (prewarm_timeout < 0)
+		prewarm_timeout = 0;
+
+	str = mce_conf_get_string(MCE_CONF_DISPLAY_GROUP,
+				  MCE_CONF_BRIGHTNESS_FADE_EASING,
+				  "",
+				  NULL);
+
+	brightness_fade_easing = mce_translate_string_to_int_with_default(brightness_fade_easing_translation, str, DEFAULT_BRIGHTNESS_FADE_EASING);
+	g_free(str);
+
+	fade_max_rate = mce_conf_get_int(MCE_CONF_DISPLAY_GROUP,
+					 MCE_CONF_BRIGHTNESS_FADE_MAX_RATE,
+					 DEFAULT_BRIGHTNESS_FADE_MAX_RATE,
+					 NULL);
+
+	if (fade_max_rate <= 0)
+		fade_max_rate = DEFAULT_BRIGHTNESS_FADE_MAX_RATE;
+
+	brightness_fade_interval = MAX(1000 / fade_max_rate, 1);
+
 	(void)execute_datapipe(&display_state_pipe,
 			       GINT_TO_POINTER(init_display_state),
 			       USE_INDATA, CACHE_INDATA);
@@ -3260,7 +4324,14 @@ void g_module_unload(GModule *module)
 	/* Write display on timers to CAL */
 	update_display_timers(TRUE);
 
+	/* Save the display energy accounting */
+	display_energy_exit();
+
 	/* Remove triggers/filters from datapipes */
+	remove_input_trigger_from_datapipe(&keyboard_slide_pipe,
+					   keyboard_slide_trigger);
+	remove_input_trigger_from_datapipe(&keypress_pipe,
+					   keypress_trigger);
 	remove_output_trigger_from_datapipe(&alarm_ui_state_pipe,
 					    alarm_ui_state_trigger);
 	remove_output_trigger_from_datapipe(&proximity_sensor_pipe,
@@ -3306,6 +4377,7 @@ void g_module_unload(GModule *module)
 	cancel_dim_timeout();
 	cancel_adaptive_dimming_timeout();
 	cancel_blank_timeout();
+	cancel_prewarm_timeout();
 
 	return;
 }
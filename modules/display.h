@@ -21,6 +21,38 @@
 #ifndef _DISPLAY_H_
 #define _DISPLAY_H_
 
+/**
+ * Query the display energy accounting
+ *
+ * Reply arguments:
+ * array of uint64 milliseconds spent in each display state,
+ * from MCE_DISPLAY_OFF to MCE_DISPLAY_ON,
+ * uint64 estimated backlight energy, in permille of the maximum
+ * brightness times milliseconds,
+ * uint64 milliseconds spent in high brightness mode,
+ * array of string CABC mode names,
+ * array of uint64 milliseconds spent in each CABC mode,
+ * array of string blanking inhibit client names,
+ * array of uint64 milliseconds each client kept the display on
+ */
+#define MCE_DISPLAY_ENERGY_GET			"get_display_energy_stats"
+
+/** Path to the display energy accounting file */
+#define MCE_DISPLAY_ENERGY_PATH		G_STRINGIFY(MCE_VAR_DIR) "/display_energy"
+
+/**
+ * Minimum time between saves of the display energy accounting;
+ * in seconds
+ */
+#define DISPLAY_ENERGY_FLUSH_INTERVAL		(60 * 10)
+
+/** Blanking inhibit client name for incoming calls */
+#define DISPLAY_ENERGY_CLIENT_CALL		"mce:call"
+/** Blanking inhibit client name for alarms */
+#define DISPLAY_ENERGY_CLIENT_ALARM		"mce:alarm"
+/** Blanking inhibit client name for the blanking inhibit setting */
+#define DISPLAY_ENERGY_CLIENT_SETTING		"mce:setting"
+
 /** Name of Display configuration group */
 #define MCE_CONF_DISPLAY_GROUP			"Display"
 
@@ -42,6 +74,21 @@
 /** Name of the configuration key for the constant time brightness decrease */
 #define MCE_CONF_CONSTANT_TIME_DECREASE		"ConstantTimeDecrease"
 
+/** Name of the configuration key for the brightness fade easing curve */
+#define MCE_CONF_BRIGHTNESS_FADE_EASING		"FadeEasing"
+
+/** Name of the configuration key for the brightness fade update rate */
+#define MCE_CONF_BRIGHTNESS_FADE_MAX_RATE	"FadeMaxRate"
+
+/** Name of the configuration key for the brightness curve gamma */
+#define MCE_CONF_BRIGHTNESS_GAMMA		"BrightnessGamma"
+
+/** Name of the configuration key for the brightness curve points */
+#define MCE_CONF_BRIGHTNESS_CURVE		"BrightnessCurve"
+
+/** Name of the configuration key for the unblank pre-warm timeout */
+#define MCE_CONF_PREWARM_TIMEOUT		"PrewarmTimeout"
+
 /** Default brightness increase step-time */
 #define DEFAULT_BRIGHTNESS_INCREASE_STEP_TIME		5
 
@@ -54,6 +101,21 @@
 /** Default brightness decrease constant time */
 #define DEFAULT_BRIGHTNESS_DECREASE_CONSTANT_TIME	3000
 
+/** Default maximum brightness fade update rate; in Hz */
+#define DEFAULT_BRIGHTNESS_FADE_MAX_RATE		60
+
+/** Default brightness curve gamma, in hundredths; 100 is linear */
+#define DEFAULT_BRIGHTNESS_GAMMA			100
+
+/** Number of perceptual brightness levels */
+#define BRIGHTNESS_LUT_SIZE				256
+
+/** Default unblank pre-warm timeout, in milliseconds; 0 to disable */
+#define DEFAULT_PREWARM_TIMEOUT				1000
+
+/** Fixed point precision of the brightness fade progress */
+#define BRIGHTNESS_FADE_PRECISION			1024
+
 /** Default timeout for the high brightness mode; in seconds */
 #define DEFAULT_HBM_TIMEOUT				1800	/* 30 min */
 
@@ -65,6 +65,9 @@
 					 * mce_translation_t
 					 */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add_seconds(),
+					 * mce_timer_remove()
+					 */
 #include "mce-conf.h"			/* mce_conf_get_int(),
 					 * mce_conf_get_string()
 					 */
@@ -677,7 +680,7 @@ static void cancel_blank_timeout(void)
 	/* Remove the timeout source for display blanking */
 	log_debug("started\n")
 	if (blank_timeout_cb_id != 0) {
-		g_source_remove(blank_timeout_cb_id);
+		mce_timer_remove(blank_timeout_cb_id);
 		blank_timeout_cb_id = 0;
 	}
 }
@@ -695,7 +698,7 @@ static void setup_blank_timeout(void)
         disp_timeout = get_display_blank_timeout();
 		/* Setup new timeout */
 		blank_timeout_cb_id =
-			g_timeout_add_seconds(disp_timeout,
+			mce_timer_add_seconds(disp_timeout,
 						  blank_timeout_cb, NULL);
 	}
 }
@@ -723,7 +726,7 @@ static void cancel_blank_prevent(void)
 {
 	log_debug("started\n");
 	if (blank_prevent_timeout_cb_id != 0) {
-		g_source_remove(blank_prevent_timeout_cb_id);
+		mce_timer_remove(blank_prevent_timeout_cb_id);
 		blank_prevent_timeout_cb_id = 0;
 	}
 }
@@ -738,7 +741,7 @@ static void request_display_blanking_pause(void)
 	update_blanking_inhibit(TRUE);
 	/* Setup new timeout */
 	blank_prevent_timeout_cb_id =
-		g_timeout_add_seconds(blank_prevent_timeout,
+		mce_timer_add_seconds(blank_prevent_timeout,
 				      blank_prevent_timeout_cb, NULL);
 }
 
@@ -23,32 +23,51 @@
  */
 #include <glib.h>
 #include <gmodule.h>
-#include <glib/gstdio.h>		/* g_access */
+#include <glib/gstdio.h>		/* g_access(), g_stat() */
 
 #include <errno.h>			/* errno */
-#include <fcntl.h>			/* O_NONBLOCK */
+#include <fcntl.h>			/* open(), O_RDWR, O_NONBLOCK */
 #include <unistd.h>			/* R_OK */
-#include <stdlib.h>			/* free() */
-#include <string.h>			/* memcpy() */
+#include <stdlib.h>			/* free(), qsort(), strtol() */
+#include <string.h>			/* memcpy(), strcmp() */
+
+#include <sys/stat.h>			/* struct stat, S_ISFIFO() */
 
 #include "mce.h"
 #include "filter-brightness-als.h"
 
 #include "mce-io.h"			/* mce_close_file(),
-					 * mce_read_chunk_from_file(),
+					 * mce_close_fd(),
+					 * mce_read_string_from_file(),
 					 * mce_read_number_string_from_file(),
 					 * mce_write_string_to_file(),
 					 * mce_write_number_string_to_file(),
-					 * mce_register_io_monitor_chunk(),
+					 * mce_register_io_monitor_string(),
 					 * mce_unregister_io_monitor()
 					 */
 #include "mce-lib.h"			/* mce_translate_string_to_int_with_default(),
+					 * mce_translate_string_to_int(),
+					 * mce_translate_int_to_string(),
+					 * mce_get_monotonic_time_ms(),
 					 * mce_translation_t
 					 */
 #include "mce-hal.h"			/* get_sysinfo_value() */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-sensorhub.h"		/* mce_sensorhub_attach(),
+					 * mce_sensorhub_detach(),
+					 * mce_sensorhub_read(),
+					 * SENSORHUB_CHANNEL_ALS
+					 */
+#include "mce-timer.h"			/* mce_timer_add_aligned(),
+					 * mce_timer_add_seconds_class(),
+					 * mce_timer_remove(),
+					 * MCE_TIMER_DEFERRABLE,
+					 * MCE_TIMER_DISPLAY_ON
+					 */
 #include "mce-conf.h"			/* mce_conf_get_int(),
-					 * mce_conf_get_string()
+					 * mce_conf_get_string(),
+					 * mce_conf_get_bool(),
+					 * mce_conf_get_int_list()
 					 */
 #include "mce-gconf.h"			/* mce_gconf_get_bool(),
 					 * mce_gconf_notifier_add(),
@@ -77,11 +96,27 @@
 #include "datapipe.h"			/* execute_datapipe(),
 					 * append_output_trigger_to_datapipe(),
 					 * append_filter_to_datapipe(),
+					 * append_refcount_trigger_to_datapipe(),
 					 * remove_filter_from_datapipe(),
-					 * remove_output_trigger_from_datapipe()
+					 * remove_output_trigger_from_datapipe(),
+					 * remove_refcount_trigger_from_datapipe(),
+					 * datapipe_get_gint()
 					 */
-#include "median_filter.h"		/* median_filter_init(),
-					 * median_filter_map()
+#include "als_filter.h"			/* als_profile_compile(),
+					 * als_profile_lookup(),
+					 * als_filter_chain_setup(),
+					 * als_filter_chain_append(),
+					 * als_filter_chain_reset(),
+					 * als_filter_chain_map(),
+					 * als_filter_chain_free(),
+					 * als_poll_set_range(),
+					 * als_poll_reset(),
+					 * als_poll_adapt(),
+					 * als_filter_chain_t,
+					 * als_filter_params_t,
+					 * als_level_table_t,
+					 * als_poll_t,
+					 * ALS_FILTER_*, ALS_PROFILE_*
 					 */
 
 /** Request enabling of ALS; reference counted */
@@ -130,6 +165,9 @@ static guint als_enabled_gconf_cb_id = 0;
 /** ID for the ALS I/O monitor */
 static gconstpointer als_iomon_id = NULL;
 
+/** Is the ALS attached to the sensor hub? */
+static gboolean als_hub_attached = FALSE;
+
 /** Path to the ALS device file entry */
 static const gchar *als_device_path = NULL;
 /** Path to the ALS lux sysfs entry */
@@ -140,14 +178,18 @@ static const gchar *als_calib0_path = NULL;
 static const gchar *als_calib1_path = NULL;
 /** Path to the ALS threshold range sysfs entry */
 static const gchar *als_threshold_range_path = NULL;
+/** Path to the display hardware revision entry */
+static const gchar *display_hw_revision_path = DISPLAY_HARDWARE_REVISION_PATH;
 /** Maximum als threshold value */
 static gint als_threshold_max = -1;
 /** Is there an ALS available? */
 static gboolean als_available = TRUE;
 /** Filter things through ALS? */
 static gboolean als_enabled = TRUE;
-/** Pass input through a median filter? */
-static gboolean use_median_filter = FALSE;
+/** Configuration key for the smoothing chain of the ALS */
+static const gchar *als_filter_chain_key = NULL;
+/** Default smoothing chain of the ALS */
+static const gchar *als_filter_chain_default = "";
 /** Lux reading from the ALS */
 static gint als_lux = -1;
 /** Lux cache for delayed brightness stepdown */
@@ -192,11 +234,37 @@ static gchar *display_id = NULL;
 /** Display state */
 static display_state_t display_state = MCE_DISPLAY_UNDEF;
 
-/** Median filter */
-static median_filter_struct median_filter;
+/** Compiled ALS profiles for the display */
+static als_level_table_t display_als_tables[ALS_PROFILE_MAXIMUM + 1];
+/** Compiled ALS profiles for the LED */
+static als_level_table_t led_als_tables[ALS_PROFILE_MAXIMUM + 1];
+/** Compiled ALS profiles for the keyboard backlight */
+static als_level_table_t kbd_als_tables[ALS_PROFILE_MAXIMUM + 1];
+
+/** Compiled colour phase profile */
+static cpa_table_t display_cpa_table = {
+	.profile = NULL,
+	.count = 0,
+	.bounds = NULL,
+	.entries = NULL,
+	.level = -1
+};
+
+/** ALS poll schedule; the interval adapts to the lux variance */
+static als_poll_t als_poll = {
+	.interval = ALS_DISPLAY_ON_POLL_MIN,
+	.min = ALS_DISPLAY_ON_POLL_MIN,
+	.max = ALS_DISPLAY_ON_POLL_MAX
+};
 
-/** ALS poll interval */
-static gint als_poll_interval = ALS_DISPLAY_ON_POLL_FREQ;
+/** Shortest ALS poll interval when the display is on */
+static gint als_poll_on_min = ALS_DISPLAY_ON_POLL_MIN;
+/** Longest ALS poll interval when the display is on */
+static gint als_poll_on_max = ALS_DISPLAY_ON_POLL_MAX;
+/** Shortest ALS poll interval when the display is dimmed */
+static gint als_poll_dim_min = ALS_DISPLAY_DIM_POLL_MIN;
+/** Longest ALS poll interval when the display is dimmed */
+static gint als_poll_dim_max = ALS_DISPLAY_DIM_POLL_MAX;
 
 /** ID for ALS poll timer source */
 static guint als_poll_timer_cb_id = 0;
@@ -210,6 +278,85 @@ static guint brightness_delay_timer_cb_id = 0;
 /** FILE * for the ambient_light_sensor */
 static FILE *als_fp = NULL;
 
+/** Buffer for reads from the Avago ALS device */
+static struct avago_als als_avago_data;
+
+/** Buffer for reads from the Dipro ALS device */
+static struct dipro_als als_dipro_data;
+
+/** Built-in profiles that the simulated ALS can use */
+typedef struct {
+	/** Name of the device the profiles are for */
+	const gchar *name;
+	/** ALS profiles for the display */
+	als_profile_struct *display;
+	/** ALS profiles for the LED */
+	als_profile_struct *led;
+	/** ALS profiles for the keyboard backlight; NULL if none */
+	als_profile_struct *kbd;
+	/** Colour phase profile; NULL if none */
+	cpa_profile_struct *cpa;
+} als_simulated_profiles_t;
+
+/** Profiles for the simulated ALS; the first one is the default */
+static const als_simulated_profiles_t als_simulated_profiles[] = {
+	{
+		.name = "rm696",
+		.display = display_als_profiles_rm696,
+		.led = led_als_profiles_rm696,
+		.kbd = NULL,
+		.cpa = rm696_phase_profile
+	}, {
+		.name = "rm680",
+		.display = display_als_profiles_rm680,
+		.led = led_als_profiles_rm680,
+		.kbd = kbd_als_profiles_rm680,
+		.cpa = rm680_phase_profile
+	}, {
+		.name = "rx51",
+		.display = display_als_profiles_rx51,
+		.led = led_als_profiles_rx51,
+		.kbd = kbd_als_profiles_rx51,
+		.cpa = NULL
+	}, {
+		.name = "rx44",
+		.display = display_als_profiles_rx44,
+		.led = led_als_profiles_rx44,
+		.kbd = kbd_als_profiles_rx44,
+		.cpa = NULL
+	}, {
+		.name = NULL
+	}
+};
+
+/** Simulated ALS device; NULL when the real sensor is used */
+static gchar *als_simulated_device = NULL;
+/** Is the simulated ALS device a FIFO rather than a trace file? */
+static gboolean als_simulated_fifo = FALSE;
+/** Descriptor for the simulated ALS FIFO; -1 if not open */
+static gint als_simulated_fd = -1;
+/** Last lux value read from the simulated ALS FIFO; -1 if none */
+static gint als_simulated_lux = -1;
+/** Simulated threshold range sysfs entry */
+static gchar *als_simulated_threshold_range_path = NULL;
+/** Simulated colour phase adjustment enabling sysfs entry */
+static gchar *als_simulated_cpa_enable_path = NULL;
+/** Simulated colour phase adjustment coefficients sysfs entry */
+static gchar *als_simulated_cpa_coefficients_path = NULL;
+/** Simulated display hardware revision entry */
+static gchar *als_simulated_hw_revision_path = NULL;
+
+/** Timestamps of the simulated ALS trace, in ms from its start */
+static gint64 *als_trace_time = NULL;
+/** Lux values of the simulated ALS trace */
+static gint *als_trace_lux = NULL;
+/** Number of samples in the simulated ALS trace */
+static gsize als_trace_length = 0;
+/** Current sample of the simulated ALS trace */
+static gsize als_trace_pos = 0;
+/** Start of the replay of the simulated ALS trace, in ms */
+static gint64 als_trace_start = 0;
+
 /** Ambient Light Sensor type */
 typedef enum {
 	/** ALS type unset */
@@ -223,12 +370,88 @@ typedef enum {
 	/** Dipro (BH1770GLC/SFH7770) type ALS */
 	ALS_TYPE_DIPRO = 3,
 	/** Avago (APDS990x (QPDS-T900)) type ALS */
-	ALS_TYPE_AVAGO = 4
+	ALS_TYPE_AVAGO = 4,
+	/** Simulated ALS, fed from a FIFO or a trace file */
+	ALS_TYPE_SIMULATED = 5
 } als_type_t;
 
+/** How new Ambient Light Sensor readings are noticed */
+typedef enum {
+	/** No ALS backend */
+	ALS_BACKEND_NONE = 0,
+	/** The device signals readings outside the threshold window */
+	ALS_BACKEND_DEVICE = 1,
+	/** The driver notifies changes of the sysfs lux entry */
+	ALS_BACKEND_NOTIFY = 2,
+	/** The sysfs lux entry is polled */
+	ALS_BACKEND_POLL = 3
+} als_backend_t;
+
+/** Mapping of ALS backends to names, for logging */
+static const mce_translation_t als_backend_translation[] = {
+	{
+		.number = ALS_BACKEND_NONE,
+		.string = "none",
+	}, {
+		.number = ALS_BACKEND_DEVICE,
+		.string = "device",
+	}, {
+		.number = ALS_BACKEND_NOTIFY,
+		.string = "notify",
+	}, {
+		.number = ALS_BACKEND_POLL,
+		.string = "poll",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** The ALS backend in use */
+static als_backend_t als_backend = ALS_BACKEND_NONE;
+
+/**
+ * Lower end of the current threshold window;
+ * readings inside the window don't change anything,
+ * so they are ignored even if the sensor can't filter them;
+ * -1 if there's no window
+ */
+static gint als_window_lower = -1;
+/** Upper end of the current threshold window; -1 if there's no window */
+static gint als_window_upper = -1;
+
+/** Mapping of ALS smoothing stage types to configuration names */
+static const mce_translation_t als_filter_type_translation[] = {
+	{
+		.number = ALS_FILTER_MEDIAN,
+		.string = "median",
+	}, {
+		.number = ALS_FILTER_EWMA,
+		.string = "ewma",
+	}, {
+		.number = ALS_FILTER_HYSTERESIS,
+		.string = "hysteresis",
+	}, {
+		.number = ALS_FILTER_SPIKE,
+		.string = "spike",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** The ALS smoothing chain */
+static als_filter_chain_t als_filter_chain;
+
+/** Number of ALS wakeups since als_wakeups_start */
+static guint als_wakeups = 0;
+/** Monotonic time when the ALS wakeup counting started, in milliseconds */
+static gint64 als_wakeups_start = 0;
+
 static void cancel_als_poll_timer(void);
 static void cancel_brightness_delay_timer(void);
 static void als_iomon_common(gint lux, gboolean no_delay);
+static void als_thresholds_changed(void);
 static gboolean set_color_profile(const gchar *id);
 static gboolean save_color_profile(const gchar *id);
 static gboolean is_raw_color_profile_valid(const gint *raw_color_profile,
@@ -267,6 +490,13 @@ static brightness_step_policy_t brightness_step_down_policy =
 /** External reference count for ALS */
 static guint als_external_refcount = 0;
 
+/** Number of consumers of the LED brightness */
+static guint led_brightness_consumers = 0;
+/** Number of consumers of the keyboard backlight brightness */
+static guint kbd_brightness_consumers = 0;
+/** Is a lux change being dispatched? */
+static gboolean als_dispatching = FALSE;
+
 /** List of monitored als owners */
 static GSList *als_owner_monitor_list = NULL;
 
@@ -282,6 +512,146 @@ static const cpa_profile_struct *display_cpa_profile(void)
 		display_cpa_profile_static);
 }
 
+/**
+ * Compare two integers, for qsort()
+ *
+ * @param a The first integer
+ * @param b The second integer
+ * @return Less than, equal to or greater than 0
+ *         if a is less than, equal to or greater than b
+ */
+static int compare_gint(const void *a, const void *b)
+{
+	gint x = *(const gint *)a;
+	gint y = *(const gint *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Release a compiled colour phase profile
+ */
+static void free_cpa_table(void)
+{
+	g_free(display_cpa_table.bounds);
+	display_cpa_table.bounds = NULL;
+	g_free(display_cpa_table.entries);
+	display_cpa_table.entries = NULL;
+	display_cpa_table.count = 0;
+	display_cpa_table.profile = NULL;
+	display_cpa_table.level = -1;
+}
+
+/**
+ * Compile a colour phase profile for binary search
+ *
+ * The lux axis is split into intervals at every range edge;
+ * each interval gets the first range that covers it,
+ * just like a linear walk through the profile would find
+ *
+ * @param profile The profile to compile
+ */
+static void compile_cpa_profile(const cpa_profile_struct *profile)
+{
+	gint count = 0;
+	gint ranges;
+	gint i;
+	gint j;
+
+	free_cpa_table();
+
+	for (ranges = 0; profile[ranges].range[0] != -1; ranges++)
+		/* Just count */;
+
+	display_cpa_table.bounds = g_new(gint, (ranges * 2) + 1);
+	display_cpa_table.entries = g_new(gint, (ranges * 2) + 1);
+
+	for (i = 0; i < ranges; i++) {
+		display_cpa_table.bounds[count++] = profile[i].range[0];
+
+		if (profile[i].range[1] != -1)
+			display_cpa_table.bounds[count++] = profile[i].range[1];
+	}
+
+	qsort(display_cpa_table.bounds, count, sizeof (gint), compare_gint);
+
+	/* Drop duplicates, and find the range of each interval */
+	for (i = 0, j = 0; i < count; i++) {
+		gint bound = display_cpa_table.bounds[i];
+		gint k;
+
+		if ((j > 0) && (display_cpa_table.bounds[j - 1] == bound))
+			continue;
+
+		display_cpa_table.bounds[j] = bound;
+		display_cpa_table.entries[j] = -1;
+
+		for (k = 0; k < ranges; k++) {
+			if ((bound >= profile[k].range[0]) &&
+			    ((bound < profile[k].range[1]) ||
+			     (profile[k].range[1] == -1))) {
+				display_cpa_table.entries[j] = k;
+				break;
+			}
+		}
+
+		j++;
+	}
+
+	display_cpa_table.count = j;
+	display_cpa_table.profile = profile;
+}
+
+/**
+ * Adjust the colour phase coefficients to the ambient light;
+ * the coefficients are only written when the range changes
+ */
+static void update_cpa_level(void)
+{
+	const cpa_profile_struct *profile = display_cpa_profile();
+	gint first = 0;
+	gint last;
+	gint level;
+
+	if (profile == NULL)
+		goto EXIT;
+
+	if (profile != display_cpa_table.profile)
+		compile_cpa_profile(profile);
+
+	/* Find the last interval that starts at or below the lux value */
+	last = display_cpa_table.count;
+
+	while (first < last) {
+		gint mid = first + ((last - first) / 2);
+
+		if (als_lux < display_cpa_table.bounds[mid])
+			last = mid;
+		else
+			first = mid + 1;
+	}
+
+	level = (first == 0) ? -1 : display_cpa_table.entries[first - 1];
+
+	if ((level == -1) || (level == display_cpa_table.level))
+		goto EXIT;
+
+	display_cpa_table.level = level;
+
+	mce_write_string_to_file(display_cpa_coefficients_path,
+				 profile[level].coefficients);
+
+	/* If this is the first time we adjust the colour phase
+	 * coefficients, enable cpa adjustment
+	 */
+	if (display_cpa_enabled == FALSE) {
+		mce_write_string_to_file(display_cpa_enable_path, "1");
+	}
+
+EXIT:
+	return;
+}
+
 /**
  * GConf callback for ALS settings
  *
@@ -321,6 +691,304 @@ EXIT:
 	return;
 }
 
+/**
+ * Parse a sample of the simulated ALS
+ *
+ * @param str A `time_ms,lux' or `lux' line
+ * @param[out] time_ms The timestamp; -1 if there's none
+ * @param[out] lux The lux value
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean parse_simulated_sample(const gchar *str,
+				       gint64 *time_ms, gint *lux)
+{
+	gboolean status = FALSE;
+	gchar *endptr = NULL;
+	glong first;
+
+	errno = 0;
+	first = strtol(str, &endptr, 10);
+
+	if ((errno != 0) || (endptr == str))
+		goto EXIT;
+
+	if (*endptr == ',') {
+		str = endptr + 1;
+		*time_ms = first;
+		first = strtol(str, &endptr, 10);
+
+		if ((errno != 0) || (endptr == str))
+			goto EXIT;
+	} else {
+		*time_ms = -1;
+	}
+
+	*lux = (gint)CLAMP(first, 0, G_MAXINT);
+	status = TRUE;
+
+EXIT:
+	errno = 0;
+
+	return status;
+}
+
+/**
+ * Load the trace of the simulated ALS; the replay starts now
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean load_als_trace(void)
+{
+	gboolean status = FALSE;
+	gchar *contents = NULL;
+	gchar **lines = NULL;
+	gsize count;
+	gsize i;
+
+	if (mce_read_string_from_file(als_simulated_device,
+				      &contents) == FALSE)
+		goto EXIT;
+
+	lines = g_strsplit(contents, "\n", 0);
+	count = g_strv_length(lines);
+
+	als_trace_time = g_new(gint64, count);
+	als_trace_lux = g_new(gint, count);
+	als_trace_length = 0;
+	als_trace_pos = 0;
+
+	for (i = 0; i < count; i++) {
+		gchar *str = g_strstrip(lines[i]);
+		gint64 time_ms;
+		gint lux;
+
+		/* Skip empty lines and comments */
+		if ((*str == '\0') || (*str == '#'))
+			continue;
+
+		if ((parse_simulated_sample(str, &time_ms, &lux) == FALSE) ||
+		    (time_ms == -1)) {
+			mce_log(LL_WARN,
+				"Invalid sample `%s' in `%s'; "
+				"expected `time_ms,lux'",
+				str, als_simulated_device);
+			continue;
+		}
+
+		/* The replay only moves forward */
+		if (als_trace_length > 0)
+			time_ms = MAX(time_ms,
+				      als_trace_time[als_trace_length - 1]);
+
+		als_trace_time[als_trace_length] = time_ms;
+		als_trace_lux[als_trace_length] = lux;
+		als_trace_length++;
+	}
+
+	if (als_trace_length == 0) {
+		mce_log(LL_ERR,
+			"No samples in the ALS trace `%s'",
+			als_simulated_device);
+		goto EXIT;
+	}
+
+	als_trace_start = mce_get_monotonic_time_ms();
+
+	mce_log(LL_INFO,
+		"Replaying %zu ALS samples from `%s'",
+		als_trace_length, als_simulated_device);
+
+	status = TRUE;
+
+EXIT:
+	g_strfreev(lines);
+	g_free(contents);
+
+	return status;
+}
+
+/**
+ * Read the current lux value of the simulated ALS
+ *
+ * @param[out] lux The lux value
+ * @return TRUE on success, FALSE if there's no reading yet
+ */
+static gboolean read_simulated_als(gulong *lux)
+{
+	gboolean status = FALSE;
+	gint64 elapsed;
+
+	/* A FIFO can't be read on demand; use the last reading */
+	if (als_simulated_fifo == TRUE) {
+		if (als_simulated_lux == -1)
+			goto EXIT;
+
+		*lux = als_simulated_lux;
+		status = TRUE;
+		goto EXIT;
+	}
+
+	if (als_trace_length == 0)
+		goto EXIT;
+
+	elapsed = mce_get_monotonic_time_ms() - als_trace_start;
+
+	/* The last sample is held once the trace ends */
+	while ((als_trace_pos + 1 < als_trace_length) &&
+	       (als_trace_time[als_trace_pos + 1] <= elapsed))
+		als_trace_pos++;
+
+	*lux = als_trace_lux[als_trace_pos];
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Release the resources of the simulated ALS
+ */
+static void free_simulated_als(void)
+{
+	g_free(als_trace_time);
+	als_trace_time = NULL;
+	g_free(als_trace_lux);
+	als_trace_lux = NULL;
+	als_trace_length = 0;
+
+	g_free(als_simulated_threshold_range_path);
+	als_simulated_threshold_range_path = NULL;
+	g_free(als_simulated_cpa_enable_path);
+	als_simulated_cpa_enable_path = NULL;
+	g_free(als_simulated_cpa_coefficients_path);
+	als_simulated_cpa_coefficients_path = NULL;
+	g_free(als_simulated_hw_revision_path);
+	als_simulated_hw_revision_path = NULL;
+
+	g_free(als_simulated_device);
+	als_simulated_device = NULL;
+}
+
+/**
+ * Set up the simulated ALS, if one is configured
+ *
+ * The simulated ALS uses the paths of a real ALS, but its
+ * sysfs entries live in a directory of their own, so that
+ * the brightness, colour phase and threshold handling can be
+ * run and checked on any machine
+ *
+ * @return TRUE if the simulated ALS is used, FALSE otherwise
+ */
+static gboolean get_simulated_als(void)
+{
+	const als_simulated_profiles_t *profiles;
+	gboolean status = FALSE;
+	gchar *name = NULL;
+	gchar *dir = NULL;
+	struct stat st;
+
+	als_simulated_device = mce_conf_get_string(MCE_CONF_ALS_GROUP,
+						   MCE_CONF_ALS_SIMULATED_DEVICE,
+						   DEFAULT_ALS_SIMULATED_DEVICE,
+						   NULL);
+
+	if ((als_simulated_device == NULL) || (*als_simulated_device == '\0'))
+		goto EXIT;
+
+	if (g_stat(als_simulated_device, &st) == -1) {
+		mce_log(LL_ERR,
+			"Cannot access the simulated ALS `%s'; %s",
+			als_simulated_device, g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	als_simulated_fifo = S_ISFIFO(st.st_mode) ? TRUE : FALSE;
+
+	if ((als_simulated_fifo == FALSE) && (load_als_trace() == FALSE))
+		goto EXIT;
+
+	name = mce_conf_get_string(MCE_CONF_ALS_GROUP,
+				   MCE_CONF_ALS_SIMULATED_PROFILES,
+				   DEFAULT_ALS_SIMULATED_PROFILES,
+				   NULL);
+
+	for (profiles = als_simulated_profiles;
+	     profiles->name != NULL; profiles++) {
+		if ((name != NULL) && (strcmp(profiles->name, name) == 0))
+			break;
+	}
+
+	if (profiles->name == NULL) {
+		mce_log(LL_WARN,
+			"Unknown simulated ALS profiles `%s'; using `%s'",
+			name, als_simulated_profiles[0].name);
+		profiles = &als_simulated_profiles[0];
+	}
+
+	als_device_path = als_simulated_device;
+	als_threshold_max = ALS_THRESHOLD_MAX_SIMULATED;
+	display_als_profiles = profiles->display;
+	led_als_profiles = profiles->led;
+	kbd_als_profiles = profiles->kbd;
+	als_filter_chain_key = MCE_CONF_ALS_FILTER_CHAIN_SIMULATED;
+	als_filter_chain_default = DEFAULT_ALS_FILTER_CHAIN_SIMULATED;
+
+	dir = mce_conf_get_string(MCE_CONF_ALS_GROUP,
+				  MCE_CONF_ALS_SIMULATED_SYSFS_DIR,
+				  DEFAULT_ALS_SIMULATED_SYSFS_DIR,
+				  NULL);
+
+	/* Without a sysfs directory, the threshold window
+	 * is only emulated and there's no colour phase adjustment
+	 */
+	if ((dir != NULL) && (*dir != '\0')) {
+		als_simulated_threshold_range_path =
+			g_build_filename(dir, ALS_THRESHOLD_RANGE_SIMULATED,
+					 NULL);
+		als_simulated_cpa_enable_path =
+			g_build_filename(dir, COLOUR_PHASE_ENABLE_SIMULATED,
+					 NULL);
+		als_simulated_cpa_coefficients_path =
+			g_build_filename(dir,
+					 COLOUR_PHASE_COEFFICIENTS_SIMULATED,
+					 NULL);
+		als_simulated_hw_revision_path =
+			g_build_filename(dir,
+					 DISPLAY_HARDWARE_REVISION_SIMULATED,
+					 NULL);
+
+		als_threshold_range_path = als_simulated_threshold_range_path;
+		display_cpa_enable_path = als_simulated_cpa_enable_path;
+		display_cpa_coefficients_path =
+			als_simulated_cpa_coefficients_path;
+		display_hw_revision_path = als_simulated_hw_revision_path;
+
+		if (g_access(display_cpa_enable_path, W_OK) == 0) {
+			display_cpa_profile_static = profiles->cpa;
+		}
+	}
+
+	mce_log(LL_INFO,
+		"Using the simulated ALS `%s' (%s) with the %s profiles",
+		als_simulated_device,
+		(als_simulated_fifo == TRUE) ? "FIFO" : "trace",
+		profiles->name);
+
+	status = TRUE;
+
+EXIT:
+	if (status == FALSE) {
+		g_free(als_simulated_device);
+		als_simulated_device = NULL;
+	}
+
+	g_free(name);
+	g_free(dir);
+
+	return status;
+}
+
 /**
  * Get the ALS type
  *
@@ -334,7 +1002,9 @@ static als_type_t get_als_type(void)
 	if (als_type != ALS_TYPE_UNSET)
 		goto EXIT;
 
-	if (g_access(ALS_DEVICE_PATH_AVAGO, R_OK) == 0) {
+	if (get_simulated_als() == TRUE) {
+		als_type = ALS_TYPE_SIMULATED;
+	} else if (g_access(ALS_DEVICE_PATH_AVAGO, R_OK) == 0) {
 		als_type = ALS_TYPE_AVAGO;
 		als_device_path = ALS_DEVICE_PATH_AVAGO;
 		als_calib0_path = ALS_CALIB_PATH_AVAGO;
@@ -342,7 +1012,8 @@ static als_type_t get_als_type(void)
 		als_threshold_max = ALS_THRESHOLD_MAX_AVAGO;
 		display_als_profiles = display_als_profiles_rm696;
 		led_als_profiles = led_als_profiles_rm696;
-		use_median_filter = FALSE;
+		als_filter_chain_key = MCE_CONF_ALS_FILTER_CHAIN_AVAGO;
+		als_filter_chain_default = DEFAULT_ALS_FILTER_CHAIN_AVAGO;
 
 		display_cpa_enable_path = COLOUR_PHASE_ENABLE_PATH;
 		display_cpa_coefficients_path = COLOUR_PHASE_COEFFICIENTS_PATH;
@@ -359,7 +1030,8 @@ static als_type_t get_als_type(void)
 		display_als_profiles = display_als_profiles_rm680;
 		led_als_profiles = led_als_profiles_rm680;
 		kbd_als_profiles = kbd_als_profiles_rm680;
-		use_median_filter = FALSE;
+		als_filter_chain_key = MCE_CONF_ALS_FILTER_CHAIN_DIPRO;
+		als_filter_chain_default = DEFAULT_ALS_FILTER_CHAIN_DIPRO;
 
 		display_cpa_enable_path = COLOUR_PHASE_ENABLE_PATH;
 		display_cpa_coefficients_path = COLOUR_PHASE_COEFFICIENTS_PATH;
@@ -375,7 +1047,11 @@ static als_type_t get_als_type(void)
 		display_als_profiles = display_als_profiles_rx51;
 		led_als_profiles = led_als_profiles_rx51;
 		kbd_als_profiles = kbd_als_profiles_rx51;
-		use_median_filter = TRUE;
+		als_filter_chain_key = MCE_CONF_ALS_FILTER_CHAIN_TSL2563;
+		als_filter_chain_default = DEFAULT_ALS_FILTER_CHAIN_TSL2563;
+
+		/* The threshold window is only emulated */
+		als_threshold_max = G_MAXINT;
 	} else if (g_access(ALS_LUX_PATH_TSL2562, R_OK) == 0) {
 		als_type = ALS_TYPE_TSL2562;
 		als_lux_path = ALS_LUX_PATH_TSL2562;
@@ -384,7 +1060,11 @@ static als_type_t get_als_type(void)
 		display_als_profiles = display_als_profiles_rx44;
 		led_als_profiles = led_als_profiles_rx44;
 		kbd_als_profiles = kbd_als_profiles_rx44;
-		use_median_filter = TRUE;
+		als_filter_chain_key = MCE_CONF_ALS_FILTER_CHAIN_TSL2562;
+		als_filter_chain_default = DEFAULT_ALS_FILTER_CHAIN_TSL2562;
+
+		/* The threshold window is only emulated */
+		als_threshold_max = G_MAXINT;
 	} else {
 		als_type = ALS_TYPE_NONE;
 	}
@@ -403,6 +1083,142 @@ EXIT:
 	return als_type;
 }
 
+/**
+ * Choose how new ALS readings are noticed;
+ * sensors that signal readings outside the threshold window
+ * are preferred, then lux entries that support sysfs notification;
+ * polling is the last resort
+ *
+ * @return The ALS backend to use
+ */
+static als_backend_t get_als_backend(void)
+{
+	als_backend_t backend = ALS_BACKEND_NONE;
+
+	switch (get_als_type()) {
+	case ALS_TYPE_AVAGO:
+	case ALS_TYPE_DIPRO:
+		backend = ALS_BACKEND_DEVICE;
+		break;
+
+	case ALS_TYPE_SIMULATED:
+		/* A FIFO is monitored like a device node,
+		 * a trace file is polled like a lux entry
+		 */
+		if (als_simulated_fifo == TRUE)
+			backend = ALS_BACKEND_DEVICE;
+		else
+			backend = ALS_BACKEND_POLL;
+
+		break;
+
+	case ALS_TYPE_TSL2563:
+	case ALS_TYPE_TSL2562:
+		/* Not every lux driver notifies changes,
+		 * and there's no way to tell in advance
+		 */
+		if (mce_conf_get_bool(MCE_CONF_ALS_GROUP,
+				      MCE_CONF_ALS_LUX_NOTIFY,
+				      DEFAULT_ALS_LUX_NOTIFY,
+				      NULL) == TRUE)
+			backend = ALS_BACKEND_NOTIFY;
+		else
+			backend = ALS_BACKEND_POLL;
+
+		break;
+
+	case ALS_TYPE_NONE:
+	default:
+		break;
+	}
+
+	mce_log(LL_DEBUG, "ALS backend: %s",
+		mce_translate_int_to_string(als_backend_translation,
+					    backend));
+
+	return backend;
+}
+
+/**
+ * Get an ALS poll interval range from the configuration
+ *
+ * @param key The configuration key
+ * @param[in,out] min The shortest interval; holds the default on entry
+ * @param[in,out] max The longest interval; holds the default on entry
+ */
+static void get_als_poll_range(const gchar *key, gint *min, gint *max)
+{
+	gint *range = NULL;
+	gsize count = 0;
+
+	range = mce_conf_get_int_list(MCE_CONF_ALS_GROUP, key, &count, NULL);
+
+	if (range == NULL)
+		goto EXIT;
+
+	if ((count != 2) || (range[0] <= 0) || (range[0] > range[1])) {
+		mce_log(LL_WARN,
+			"Invalid ALS poll interval range for %s; "
+			"using the default", key);
+		goto EXIT;
+	}
+
+	*min = range[0];
+	*max = range[1];
+
+EXIT:
+	g_free(range);
+
+	return;
+}
+
+/**
+ * Account an ALS wakeup; the wakeup rate is logged
+ * when a report interval has passed, so that the
+ * accounting doesn't need any wakeups of its own
+ */
+static void als_count_wakeup(void)
+{
+	gint64 now = mce_get_monotonic_time_ms();
+	gint64 elapsed;
+
+	if (als_wakeups_start == 0)
+		als_wakeups_start = now;
+
+	als_wakeups++;
+	elapsed = now - als_wakeups_start;
+
+	if (elapsed < ALS_WAKEUP_REPORT_INTERVAL * 1000)
+		goto EXIT;
+
+	mce_log(LL_INFO,
+		"ALS wakeups: %u in %lld s; %u per hour (%s)",
+		als_wakeups, (long long)(elapsed / 1000),
+		(guint)((als_wakeups * G_GINT64_CONSTANT(3600000)) / elapsed),
+		mce_translate_int_to_string(als_backend_translation,
+					    als_backend));
+
+	als_wakeups = 0;
+	als_wakeups_start = now;
+
+EXIT:
+	return;
+}
+
+/**
+ * Check whether a reading is inside the threshold window;
+ * the window excludes its upper end, since that is where
+ * the profile lookup moves up a level
+ *
+ * @param lux The filtered lux value
+ * @return TRUE if the reading is inside the window, FALSE otherwise
+ */
+static gboolean als_lux_in_window(gint lux)
+{
+	return ((als_window_lower != -1) &&
+		(lux >= als_window_lower) && (lux < als_window_upper));
+}
+
 /**
  * Calibrate the ALS using calibration values from CAL
  */
@@ -475,11 +1291,49 @@ EXIT:
 	return;
 }
 
+/**
+ * Compile ALS profiles into threshold arrays for binary search
+ *
+ * @param profiles The profiles to compile; may be NULL
+ * @param[out] tables The compiled profiles
+ */
+static void compile_als_profiles(const als_profile_struct *profiles,
+				 als_level_table_t *tables)
+{
+	gint profile;
+
+	if (profiles == NULL)
+		goto EXIT;
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		gint problems = als_profile_compile(&profiles[profile],
+						    &tables[profile],
+						    als_threshold_max);
+
+		if ((problems & ALS_PROFILE_UNTERMINATED) != 0) {
+			/* This is a programming error! */
+			mce_log(LL_CRIT,
+				"The ALS profile %d lacks terminating { -1, -1 }",
+				profile);
+		}
+
+		if ((problems & ALS_PROFILE_UNSORTED) != 0) {
+			mce_log(LL_ERR,
+				"The ranges of ALS profile %d are unsorted",
+				profile);
+		}
+	}
+
+EXIT:
+	return;
+}
+
 /**
  * Use the ALS profiles to calculate proper ALS modified values;
  * also reprogram the sensor thresholds if the sensor supports such
  *
- * @param profiles The profile struct to use for calculations
+ * @param tables The compiled profiles to use for calculations
  * @param profile The profile to use
  * @param lux The lux value
  * @param[in,out] level The old level; will be replaced by the new level
@@ -487,40 +1341,11 @@ EXIT:
  * @param[out] upper The new upper ALS interrupt threshold
  * @return The brightness in % of maximum
  */
-static gint filter_data(als_profile_struct *profiles, als_profile_t profile,
-			gint lux, gint *level, gint *lower, gint *upper)
+static gint filter_data(const als_level_table_t *tables,
+			als_profile_t profile, gint lux,
+			gint *level, gint *lower, gint *upper)
 {
-	gint tmp = *level;
-	gint i;
-
-	if (tmp == -1)
-		tmp = 0;
-	else if (tmp > ALS_RANGES)
-		tmp = ALS_RANGES;
-
-	for (i = 0; i < ALS_RANGES; i++) {
-		*level = i;
-
-		if (profiles[profile].range[i][0] == -1)
-			break;
-
-		if (lux < profiles[profile].range[i][(((i + 1) - tmp) > 0) ? 1 : 0])
-			break;
-	}
-
-	*lower = (i == 0) ? 0 : profiles[profile].range[i - 1][0];
-
-	if (i >= ALS_RANGES) {
-		/* This is a programming error! */
-		mce_log(LL_CRIT,
-			"The ALS profile %d lacks terminating { -1, -1 }",
-			profile);
-		*upper = als_threshold_max;
-	} else {
-		*upper = (profiles[profile].range[i][1] == -1) ? als_threshold_max : profiles[profile].range[i][1];
-	}
-
-	return profiles[profile].value[*level];
+	return als_profile_lookup(&tables[profile], lux, level, lower, upper);
 }
 
 /**
@@ -556,11 +1381,17 @@ static gpointer display_brightness_filter(gpointer data)
 		/* Not true percentage,
 		 * since this value may be boosted by high brightness mode
 		 */
-		gint percentage = filter_data(display_als_profiles, raw,
+		gint lower = display_brightness_lower;
+		gint upper = display_brightness_upper;
+		gint percentage = filter_data(display_als_tables, raw,
 					      als_lux, &display_als_level,
 					      &display_brightness_lower,
 					      &display_brightness_upper);
 
+		if ((lower != display_brightness_lower) ||
+		    (upper != display_brightness_upper))
+			als_thresholds_changed();
+
 		raw = percentage;
 	} else {
 		raw = (raw + 1) * 20;
@@ -585,12 +1416,19 @@ static gpointer led_brightness_filter(gpointer data)
 	gint brightness;
 
 	if ((als_enabled == TRUE) && (led_als_profiles != NULL)) {
+		gint lower = led_brightness_lower;
+		gint upper = led_brightness_upper;
 		/* XXX: this always uses the NORMAL profile */
-		gint percentage = filter_data(led_als_profiles,
+		gint percentage = filter_data(led_als_tables,
 					      ALS_PROFILE_NORMAL,
 					      als_lux, &led_als_level,
 					      &led_brightness_lower,
 					      &led_brightness_upper);
+
+		if ((lower != led_brightness_lower) ||
+		    (upper != led_brightness_upper))
+			als_thresholds_changed();
+
 		brightness = (GPOINTER_TO_INT(data) * percentage) / 100;
 	} else {
 		brightness = GPOINTER_TO_INT(data);
@@ -612,58 +1450,161 @@ static gpointer key_backlight_filter(gpointer data)
 	gint brightness = 0;
 
 	if ((als_enabled == TRUE) && (kbd_als_profiles != NULL)) {
+		gint lower = kbd_brightness_lower;
+		gint upper = kbd_brightness_upper;
 		/* XXX: this always uses the NORMAL profile */
-		gint percentage = filter_data(kbd_als_profiles,
+		gint percentage = filter_data(kbd_als_tables,
 					      ALS_PROFILE_NORMAL,
 					      als_lux, &kbd_als_level,
 					      &kbd_brightness_lower,
 					      &kbd_brightness_upper);
+
+		if ((lower != kbd_brightness_lower) ||
+		    (upper != kbd_brightness_upper))
+			als_thresholds_changed();
+
 		brightness = (GPOINTER_TO_INT(data) * percentage) / 100;
 	} else {
 		brightness = GPOINTER_TO_INT(data);
 	}
 
-	return GINT_TO_POINTER(brightness);
+	return GINT_TO_POINTER(brightness);
+}
+
+/**
+ * Reset the state of the ALS smoothing chain
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean als_filter_init(void)
+{
+	gboolean status = als_filter_chain_reset(&als_filter_chain);
+
+	if (status == FALSE) {
+		mce_log(LL_CRIT, "als_filter_chain_reset() failed");
+		als_enabled = FALSE;
+	}
+
+	return status;
+}
+
+/**
+ * Set up the ALS smoothing chain from the configuration
+ */
+static void als_filter_setup(void)
+{
+	als_filter_params_t params;
+	gchar **names = NULL;
+	gchar *str = NULL;
+	guint i;
+
+	als_filter_chain.count = 0;
+
+	if (als_filter_chain_key == NULL)
+		goto EXIT;
+
+	params.median_window = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+						MCE_CONF_ALS_MEDIAN_WINDOW,
+						DEFAULT_ALS_MEDIAN_WINDOW,
+						NULL);
+	params.ewma_weight = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					      MCE_CONF_ALS_EWMA_WEIGHT,
+					      DEFAULT_ALS_EWMA_WEIGHT,
+					      NULL);
+	params.hysteresis_band = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+						  MCE_CONF_ALS_HYSTERESIS_BAND,
+						  DEFAULT_ALS_HYSTERESIS_BAND,
+						  NULL);
+	params.hysteresis_min = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+						 MCE_CONF_ALS_HYSTERESIS_MIN,
+						 DEFAULT_ALS_HYSTERESIS_MIN,
+						 NULL);
+	params.spike_ratio = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					      MCE_CONF_ALS_SPIKE_RATIO,
+					      DEFAULT_ALS_SPIKE_RATIO,
+					      NULL);
+	params.spike_min = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					    MCE_CONF_ALS_SPIKE_MIN,
+					    DEFAULT_ALS_SPIKE_MIN,
+					    NULL);
+	params.spike_hold = mce_conf_get_int(MCE_CONF_ALS_GROUP,
+					     MCE_CONF_ALS_SPIKE_HOLD,
+					     DEFAULT_ALS_SPIKE_HOLD,
+					     NULL);
+
+	if (params.median_window < 1)
+		params.median_window = DEFAULT_ALS_MEDIAN_WINDOW;
+
+	/* The remaining parameters are clamped by the chain */
+	als_filter_chain_setup(&als_filter_chain, &params);
+
+	str = mce_conf_get_string(MCE_CONF_ALS_GROUP,
+				  als_filter_chain_key,
+				  als_filter_chain_default,
+				  NULL);
+
+	if (str == NULL)
+		goto EXIT;
+
+	names = g_strsplit(str, ";", 0);
+
+	for (i = 0; names[i] != NULL; i++) {
+		gint type;
+
+		if (*g_strstrip(names[i]) == '\0')
+			continue;
+
+		type = mce_translate_string_to_int(als_filter_type_translation,
+						   names[i]);
+
+		if (type == ALS_FILTER_INVALID) {
+			mce_log(LL_WARN,
+				"Unknown ALS filter stage `%s'; ignored",
+				names[i]);
+			continue;
+		}
+
+		if (als_filter_chain_append(&als_filter_chain,
+					    type) == FALSE) {
+			mce_log(LL_WARN,
+				"Too many ALS filter stages; "
+				"only using the first %d",
+				ALS_FILTER_MAX_STAGES);
+			break;
+		}
+
+		mce_log(LL_DEBUG, "ALS filter stage %u: %s",
+			als_filter_chain.count, names[i]);
+	}
+
+EXIT:
+	g_strfreev(names);
+	g_free(str);
+
+	return;
 }
 
 /**
- * Wrapper function for median_filter_init()
- *
- * @return TRUE on success, FALSE on failure
+ * Release the ALS smoothing chain
  */
-static gboolean als_median_filter_init(void)
+static void als_filter_free(void)
 {
-	gboolean status = TRUE;
-
-	if (use_median_filter == FALSE)
-		goto EXIT;
-
-	/* Re-initialise the median filter */
-	if (median_filter_init(&median_filter,
-			       MEDIAN_FILTER_WINDOW_SIZE) == FALSE) {
-		mce_log(LL_CRIT, "median_filter_init() failed");
-		als_enabled = FALSE;
-		status = FALSE;
-	}
-
-EXIT:
-	return status;
+	als_filter_chain_free(&als_filter_chain);
 }
 
 /**
- * Wrapper function for median_filter_map()
+ * Pass a reading through the ALS smoothing chain
  *
  * @param value The value to insert
  * @return The filtered value
  */
-static gint als_median_filter_map(gint value)
+static gint als_filter_map(gint value)
 {
-	return (use_median_filter == TRUE) ?
-		median_filter_map(&median_filter, value) : value;
+	return als_filter_chain_map(&als_filter_chain, value);
 }
 
 /**
- * Read a value from the ALS and update the median filter
+ * Read a value from the ALS and update the smoothing chain
  *
  * @return the filtered result of the read,
  *         -1 on failure,
@@ -672,18 +1613,16 @@ static gint als_median_filter_map(gint value)
 static gint als_read_value_filtered(void)
 {
 	gint filtered_read = -2;
-	void *tmp = NULL;
 	gulong lux;
 
 	if (als_enabled == FALSE)
 		goto EXIT;
 
 	if (get_als_type() == ALS_TYPE_AVAGO) {
-		struct avago_als *als;
+		struct avago_als *als = &als_avago_data;
 		gssize len = sizeof (struct avago_als);
 
-		if (mce_read_chunk_from_file(als_device_path, &tmp, &len,
-					     0) == FALSE) {
+		if (mce_sensorhub_read(als_device_path, als, &len) == FALSE) {
 			filtered_read = -1;
 			goto EXIT;
 		}
@@ -696,19 +1635,16 @@ static gint als_read_value_filtered(void)
 			goto EXIT;
 		}
 
-		als = (struct avago_als *)tmp;
-
 		if ((als->status & APDS990X_ALS_SATURATED) != 0) {
 			lux = G_MAXINT;
 		} else {
 			lux = als->lux;
 		}
 	} else if (get_als_type() == ALS_TYPE_DIPRO) {
-		struct dipro_als *als;
+		struct dipro_als *als = &als_dipro_data;
 		gssize len = sizeof (struct dipro_als);
 
-		if (mce_read_chunk_from_file(als_device_path, &tmp, &len,
-					     0) == FALSE) {
+		if (mce_sensorhub_read(als_device_path, als, &len) == FALSE) {
 			filtered_read = -1;
 			goto EXIT;
 		}
@@ -721,8 +1657,12 @@ static gint als_read_value_filtered(void)
 			goto EXIT;
 		}
 
-		als = (struct dipro_als *)tmp;
 		lux = als->lux;
+	} else if (get_als_type() == ALS_TYPE_SIMULATED) {
+		if (read_simulated_als(&lux) == FALSE) {
+			filtered_read = -1;
+			goto EXIT;
+		}
 	} else {
 		/* Read lux value from ALS */
 		if (mce_read_number_string_from_file(als_lux_path,
@@ -733,11 +1673,9 @@ static gint als_read_value_filtered(void)
 		}
 	}
 
-	filtered_read = als_median_filter_map(lux);
+	filtered_read = als_filter_map(lux);
 
 EXIT:
-	g_free(tmp);
-
 	return filtered_read;
 }
 
@@ -757,10 +1695,6 @@ static void adjust_als_thresholds(gint lower, gint upper)
 	static gint cached_upper = -1;
 	gchar *str;
 
-	/* Only adjust thresholds if there's support for doing so */
-	if (als_threshold_range_path == NULL)
-		goto EXIT;
-
 	/* Special cases */
 	if ((lower > upper) || ((lower == upper) && (lower == 0))) {
 		/* If the lower threshold is higher than the upper threshold,
@@ -786,6 +1720,19 @@ static void adjust_als_thresholds(gint lower, gint upper)
 		cached_upper = upper;
 	}
 
+	/* Emulate the window for sensors that can't filter themselves */
+	if ((lower == 0) && (upper == 0)) {
+		als_window_lower = -1;
+		als_window_upper = -1;
+	} else {
+		als_window_lower = lower;
+		als_window_upper = upper;
+	}
+
+	/* Only adjust thresholds if there's support for doing so */
+	if (als_threshold_range_path == NULL)
+		goto EXIT;
+
 	str = g_strdup_printf("%d %d", lower, upper);
 	mce_write_string_to_file(als_threshold_range_path, str);
 	g_free(str);
@@ -794,6 +1741,131 @@ EXIT:
 	return;
 }
 
+/**
+ * Check whether the display brightness depends on the ambient light
+ *
+ * @return TRUE if the display is on or dimmed, FALSE otherwise
+ */
+static gboolean display_uses_als(void)
+{
+	return ((display_als_profiles != NULL) &&
+		((display_state == MCE_DISPLAY_ON) ||
+		 (display_state == MCE_DISPLAY_DIM)));
+}
+
+/**
+ * Check whether the LED brightness depends on the ambient light;
+ * the LED brightness setting is nearly always non-zero,
+ * so this goes by whether a pattern is being shown
+ *
+ * @return TRUE if the LED is showing a pattern, FALSE otherwise
+ */
+static gboolean led_uses_als(void)
+{
+	return ((led_als_profiles != NULL) &&
+		(led_brightness_consumers != 0) &&
+		(datapipe_get_gint(led_pattern_active_pipe) != 0));
+}
+
+/**
+ * Check whether the keyboard backlight brightness
+ * depends on the ambient light
+ *
+ * @return TRUE if the keyboard backlight is lit, FALSE otherwise
+ */
+static gboolean kbd_uses_als(void)
+{
+	return ((kbd_als_profiles != NULL) &&
+		(kbd_brightness_consumers != 0) &&
+		(datapipe_get_gint(key_backlight_pipe) != 0));
+}
+
+/**
+ * Program the ALS threshold window for all outputs
+ * that depend on the ambient light
+ */
+static void update_als_thresholds(void)
+{
+	gint lower;
+	gint upper;
+
+	/* While the display is off, ALS interrupts are disabled */
+	if ((als_external_refcount != 0) || (display_uses_als() == FALSE))
+		goto EXIT;
+
+	/* The lower threshold is the largest of the lower thresholds,
+	 * the upper threshold is the smallest of the upper thresholds
+	 */
+	lower = display_brightness_lower;
+	upper = display_brightness_upper;
+
+	if (led_uses_als() == TRUE) {
+		lower = MAX(lower, led_brightness_lower);
+		upper = MIN(upper, led_brightness_upper);
+	}
+
+	if (kbd_uses_als() == TRUE) {
+		lower = MAX(lower, kbd_brightness_lower);
+		upper = MIN(upper, kbd_brightness_upper);
+	}
+
+	adjust_als_thresholds(lower, upper);
+
+EXIT:
+	return;
+}
+
+/**
+ * Reprogram the threshold window when an output was re-filtered
+ * outside of a lux change, for instance when it was switched on
+ */
+static void als_thresholds_changed(void)
+{
+	if (als_dispatching == FALSE)
+		update_als_thresholds();
+}
+
+/**
+ * Recompute the outputs that depend on the ambient light
+ * after a lux change; outputs that are off are skipped,
+ * and get re-filtered by their own datapipe once switched on
+ */
+static void als_lux_changed(void)
+{
+	als_dispatching = TRUE;
+
+	if (display_uses_als() == TRUE)
+		(void)execute_datapipe(&display_brightness_pipe, NULL,
+				       USE_CACHE, DONT_CACHE_INDATA);
+
+	if (led_uses_als() == TRUE)
+		(void)execute_datapipe(&led_brightness_pipe, NULL,
+				       USE_CACHE, DONT_CACHE_INDATA);
+
+	if (kbd_uses_als() == TRUE)
+		(void)execute_datapipe(&key_backlight_pipe, NULL,
+				       USE_CACHE, DONT_CACHE_INDATA);
+
+	als_dispatching = FALSE;
+
+	/* Adjust the colour phase coefficients */
+	update_cpa_level();
+
+	update_als_thresholds();
+}
+
+/**
+ * Count the consumers of the LED and keyboard backlight brightness;
+ * called when triggers are added to or removed from their datapipes
+ */
+static void als_consumers_trigger(void)
+{
+	led_brightness_consumers =
+		g_slist_length(led_brightness_pipe.output_triggers);
+	kbd_brightness_consumers =
+		g_slist_length(key_backlight_pipe.output_triggers);
+}
+
 /**
  * Timer callback for polling of the Ambient Light Sensor
  *
@@ -804,81 +1876,33 @@ EXIT:
 static gboolean als_poll_timer_cb(gpointer data)
 {
 	gboolean status = FALSE;
-	gint new_lux;
-	gint lower;
-	gint upper;
+	gint new_lux = -1;
 
 	(void)data;
 
+	als_count_wakeup();
+
 	/* Read lux value from ALS */
 	if ((new_lux = als_read_value_filtered()) == -2)
 		goto EXIT;
 
 	/* There's no point in readjusting the brightness
 	 * if the read failed; also no readjustment is needed
-	 * if the read is identical to the old value, unless
-	 * we've never set the threshold values before
+	 * if the read is inside the threshold window or
+	 * identical to the old value, unless we've never
+	 * set the threshold values before, or readjustment
+	 * is forced
 	 */
 	if ((new_lux == -1) ||
-	    ((als_lux == new_lux) && (display_brightness_lower != -1)))
+	    (((als_lux == new_lux) ||
+	      (als_lux_in_window(new_lux) == TRUE)) &&
+	     (display_brightness_lower != -1)))
 		goto EXIT2;
 
 	als_lux = new_lux;
 
-	/* Re-filter the brightness */
-	(void)execute_datapipe(&display_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&led_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&key_backlight_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-
-	/* Adjust the colour phase coefficients */
-	if (display_cpa_profile() != NULL) {
-		gint level = -1;
-		gint i;
-
-		for (i = 0; display_cpa_profile()[i].range[0] != -1; i++) {
-			if ((als_lux >= display_cpa_profile()[i].range[0]) &&
-			    ((als_lux < display_cpa_profile()[i].range[1]) ||
-			     (display_cpa_profile()[i].range[1] == -1))) {
-				level = i;
-				break;
-			}
-		}
-
-		if (level != -1) {
-			mce_write_string_to_file(display_cpa_coefficients_path, display_cpa_profile()[level].coefficients);
-
-			/* If this is the first time we adjust the colour phase
-			 * coefficients, enable cpa adjustment
-			 */
-			if (display_cpa_enabled == FALSE) {
-				mce_write_string_to_file(display_cpa_enable_path, "1");
-			}
-		}
-	}
-
-	/* The lower threshold is the largest of the lower thresholds */
-	lower = display_brightness_lower;
-
-	if (led_als_profiles != NULL)
-		lower = MAX(lower, led_brightness_lower);
-
-	if (kbd_als_profiles != NULL)
-		lower = MAX(lower, kbd_brightness_lower);
-
-	/* The upper threshold is the smallest of the upper thresholds */
-	upper = display_brightness_upper;
-
-	if (led_als_profiles != NULL)
-		upper = MIN(upper, led_brightness_upper);
-
-	if (kbd_als_profiles != NULL)
-		upper = MIN(upper, kbd_brightness_upper);
-
-	if (als_external_refcount == 0)
-		adjust_als_thresholds(lower, upper);
+	/* Recompute the outputs that depend on the ambient light */
+	als_lux_changed();
 
 EXIT2:
 	status = TRUE;
@@ -887,6 +1911,16 @@ EXIT:
 	if (status == FALSE)
 		als_poll_timer_cb_id = 0;
 
+	/* Replace this timer if the poll interval changed */
+	if ((status == TRUE) && (als_poll_adapt(&als_poll, new_lux) == TRUE)) {
+		mce_log(LL_DEBUG, "ALS poll interval: %d ms", als_poll.interval);
+		als_poll_timer_cb_id =
+			mce_timer_add_aligned(MCE_TIMER_DEFERRABLE,
+					      als_poll.interval,
+					      als_poll_timer_cb, NULL);
+		status = FALSE;
+	}
+
 	return status;
 }
 
@@ -902,6 +1936,8 @@ static gboolean brightness_delay_timer_cb(gpointer data)
 
 	(void)data;
 
+	als_count_wakeup();
+
 	brightness_delay_timer_cb_id = 0;
 	/* No delay for lux setting this time, as we already waited. */
 	als_iomon_common(delayed_lux, TRUE);
@@ -920,18 +1956,20 @@ static void als_iomon_common(gint lux, gboolean no_delay)
 	cover_state_t proximity_sensor_state =
 				datapipe_get_gint(proximity_sensor_pipe);
 	gint new_lux;
-	gint lower;
-	gint upper;
 
-	new_lux = als_median_filter_map(lux);
+	new_lux = als_filter_map(lux);
 
 	/* There's no point in readjusting the brightness
 	 * if the read failed; also no readjustment is needed
-	 * if the read is identical to the old value, unless
-	 * we've never set the threshold values before
+	 * if the read is inside the threshold window or
+	 * identical to the old value, unless we've never
+	 * set the threshold values before, or readjustment
+	 * is forced
 	 */
 	if ((new_lux == -1) ||
-	    ((als_lux == new_lux) && (display_brightness_lower != -1)))
+	    (((als_lux == new_lux) ||
+	      (als_lux_in_window(new_lux) == TRUE)) &&
+	     (display_brightness_lower != -1)))
 		goto EXIT;
 
 	/* Don't readjust the brightness if there's proximity,
@@ -949,8 +1987,9 @@ static void als_iomon_common(gint lux, gboolean no_delay)
 			 */
 			if (brightness_delay_timer_cb_id == 0) {
 				brightness_delay_timer_cb_id =
-					g_timeout_add_seconds(brightness_stepdown_delay,
-										  brightness_delay_timer_cb, NULL);
+					mce_timer_add_seconds_class(MCE_TIMER_DISPLAY_ON,
+								    brightness_stepdown_delay,
+								    brightness_delay_timer_cb, NULL);
 			}
 			delayed_lux = lux;
 			goto EXIT;
@@ -962,61 +2001,8 @@ static void als_iomon_common(gint lux, gboolean no_delay)
 
 	als_lux = new_lux;
 
-	/* Re-filter the brightness */
-	(void)execute_datapipe(&display_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&led_brightness_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-	(void)execute_datapipe(&key_backlight_pipe, NULL,
-			       USE_CACHE, DONT_CACHE_INDATA);
-
-	/* Adjust the colour phase coefficients */
-	if (display_cpa_profile() != NULL) {
-		gint level = -1;
-		gint i;
-
-		for (i = 0; display_cpa_profile()[i].range[0] != -1; i++) {
-			if ((als_lux >= display_cpa_profile()[i].range[0]) &&
-			    ((als_lux < display_cpa_profile()[i].range[1]) ||
-			     (display_cpa_profile()[i].range[1] == -1))) {
-				level = i;
-				break;
-			}
-		}
-
-		if (level != -1) {
-			mce_write_string_to_file(display_cpa_coefficients_path, display_cpa_profile()[level].coefficients);
-
-			/* If this is the first time we adjust the colour phase
-			 * coefficients, enable cpa adjustment
-			 */
-			if (display_cpa_enabled == FALSE) {
-				mce_write_string_to_file(display_cpa_enable_path, "1");
-			}
-		}
-	}
-
-	/* The lower threshold is the largest of the lower thresholds */
-	lower = display_brightness_lower;
-
-	if (led_als_profiles != NULL)
-		lower = MAX(lower, led_brightness_lower);
-
-	if (kbd_als_profiles != NULL)
-		lower = MAX(lower, kbd_brightness_lower);
-
-	/* The upper threshold is the smallest of the upper thresholds */
-	upper = display_brightness_upper;
-
-	if (led_als_profiles != NULL)
-		upper = MIN(upper, led_brightness_upper);
-
-	if (kbd_als_profiles != NULL)
-		upper = MIN(upper, kbd_brightness_upper);
-
-	if (als_external_refcount == 0)
-		adjust_als_thresholds(lower, upper);
-
+	/* Recompute the outputs that depend on the ambient light */
+	als_lux_changed();
 
 EXIT:
 	return;
@@ -1034,6 +2020,8 @@ static gboolean als_dipro_iomon_cb(gpointer data, gsize bytes_read)
 {
 	struct dipro_als *als;
 
+	als_count_wakeup();
+
 	/* Don't process invalid reads */
 	if (bytes_read != sizeof (struct dipro_als)) {
 		als_poll_timer_cb_id = 0;
@@ -1060,6 +2048,8 @@ static gboolean als_avago_iomon_cb(gpointer data, gsize bytes_read)
 {
 	struct avago_als *als;
 
+	als_count_wakeup();
+
 	/* Don't process invalid reads */
 	if (bytes_read != sizeof (struct avago_als)) {
 		als_poll_timer_cb_id = 0;
@@ -1083,6 +2073,71 @@ EXIT:
 	return FALSE;
 }
 
+/**
+ * I/O monitor callback for sysfs notifications of the lux entry
+ *
+ * @param data The new data
+ * @param bytes_read Unused
+ * @return Always returns FALSE to return remaining chunks (if any)
+ */
+static gboolean als_notify_iomon_cb(gpointer data, gsize bytes_read)
+{
+	gchar *endptr = NULL;
+	gulong lux;
+
+	(void)bytes_read;
+
+	als_count_wakeup();
+
+	errno = 0;
+	lux = strtoul(data, &endptr, 10);
+
+	/* Don't process invalid reads */
+	if ((errno != 0) || (endptr == data)) {
+		mce_log(LL_ERR,
+			"Invalid lux value `%s' from `%s'",
+			(gchar *)data, als_lux_path);
+		errno = 0;
+		goto EXIT;
+	}
+
+	als_iomon_common((gint)MIN(lux, G_MAXINT), FALSE);
+
+EXIT:
+	return FALSE;
+}
+
+/**
+ * I/O monitor callback for the simulated Ambient Light Sensor FIFO
+ *
+ * @param data The new data
+ * @param bytes_read Unused
+ * @return Always returns FALSE to return remaining chunks (if any)
+ */
+static gboolean als_simulated_iomon_cb(gpointer data, gsize bytes_read)
+{
+	gint64 time_ms;
+	gint lux;
+
+	(void)bytes_read;
+
+	als_count_wakeup();
+
+	/* Don't process invalid reads */
+	if (parse_simulated_sample(data, &time_ms, &lux) == FALSE) {
+		mce_log(LL_ERR,
+			"Invalid lux value `%s' from `%s'",
+			g_strstrip(data), als_simulated_device);
+		goto EXIT;
+	}
+
+	als_simulated_lux = lux;
+	als_iomon_common(lux, FALSE);
+
+EXIT:
+	return FALSE;
+}
+
 /**
  * Cancel Ambient Light Sensor poll timer
  */
@@ -1094,20 +2149,61 @@ static void cancel_als_poll_timer(void)
 		als_iomon_id = NULL;
 	}
 
+	/* The I/O monitor doesn't close descriptors it didn't open */
+	(void)mce_close_fd(als_simulated_device, &als_simulated_fd);
+
+	/* Let go of the sensor */
+	if (als_hub_attached == TRUE) {
+		mce_sensorhub_detach(SENSORHUB_CHANNEL_ALS);
+		als_hub_attached = FALSE;
+	}
+
 	/* Disable old ALS timer */
 	if (als_poll_timer_cb_id != 0) {
-		g_source_remove(als_poll_timer_cb_id);
+		mce_timer_remove(als_poll_timer_cb_id);
 		als_poll_timer_cb_id = 0;
 	}
 }
 
+/**
+ * Monitor the simulated Ambient Light Sensor FIFO
+ */
+static void monitor_simulated_als(void)
+{
+	/* Open the FIFO read-write, so that opening it
+	 * doesn't wait for a writer, and so that writers
+	 * coming and going don't hang it up
+	 */
+	if ((als_simulated_fd = open(als_simulated_device,
+				     O_RDWR | O_NONBLOCK)) == -1) {
+		mce_log(LL_ERR,
+			"Cannot open `%s'; %s",
+			als_simulated_device, g_strerror(errno));
+		errno = 0;
+		goto EXIT;
+	}
+
+	als_iomon_id = mce_register_io_monitor_string(als_simulated_fd,
+						      als_simulated_device,
+						      MCE_IO_ERROR_POLICY_WARN,
+						      G_IO_IN | G_IO_ERR,
+						      FALSE,
+						      als_simulated_iomon_cb);
+
+	if (als_iomon_id == NULL)
+		(void)mce_close_fd(als_simulated_device, &als_simulated_fd);
+
+EXIT:
+	return;
+}
+
 /**
  * Setup Ambient Light Sensor poll timer
  */
 static void setup_als_poll_timer(void)
 {
 	/* If we don't want polling to take place, disable it */
-	if (als_poll_interval == 0) {
+	if (als_poll.interval == 0) {
 		cancel_als_poll_timer();
 
 		/* Close the file pointer when we disable the als polling
@@ -1117,36 +2213,70 @@ static void setup_als_poll_timer(void)
 		goto EXIT;
 	}
 
+	/* The lux entry notifies changes; no polling needed */
+	if (als_backend == ALS_BACKEND_NOTIFY) {
+		if (als_iomon_id != NULL)
+			goto EXIT;
+
+		als_iomon_id = mce_register_io_monitor_string(-1, als_lux_path, MCE_IO_ERROR_POLICY_WARN, G_IO_PRI | G_IO_ERR, TRUE, als_notify_iomon_cb);
+		goto EXIT;
+	}
+
 	switch (get_als_type()) {
 	case ALS_TYPE_AVAGO:
-		/* If we already have have an I/O monitor registered,
+		/* If we are already attached to the sensor,
 		 * we can skip this
 		 */
-		if (als_iomon_id != NULL)
+		if (als_hub_attached == TRUE)
 			goto EXIT;
 
-		/* Register ALS I/O monitor */
-		als_iomon_id = mce_register_io_monitor_chunk(-1, als_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, als_avago_iomon_cb, sizeof (struct avago_als));
+		/* Monitor the ALS; shared with the proximity sensor */
+		als_hub_attached =
+			mce_sensorhub_attach(SENSORHUB_CHANNEL_ALS,
+					     als_device_path,
+					     sizeof (struct avago_als),
+					     als_avago_iomon_cb);
 		break;
 
 	case ALS_TYPE_DIPRO:
-		/* If we already have have an I/O monitor registered,
+		/* If we are already attached to the sensor,
 		 * we can skip this
 		 */
-		if (als_iomon_id != NULL)
+		if (als_hub_attached == TRUE)
 			goto EXIT;
 
-		/* Register ALS I/O monitor */
-		als_iomon_id = mce_register_io_monitor_chunk(-1, als_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, als_dipro_iomon_cb, sizeof (struct dipro_als));
+		/* Monitor the ALS */
+		als_hub_attached =
+			mce_sensorhub_attach(SENSORHUB_CHANNEL_ALS,
+					     als_device_path,
+					     sizeof (struct dipro_als),
+					     als_dipro_iomon_cb);
 		break;
 
+	case ALS_TYPE_SIMULATED:
+		/* A FIFO is monitored like a device node */
+		if (als_simulated_fifo == TRUE) {
+			if (als_iomon_id == NULL)
+				monitor_simulated_als();
+
+			break;
+		}
+
+		/* Trace files are polled; fall-through */
+
 	default:
 		/* Setup new timer;
-		 * for light sensors that we don't use polling for
+		 * for light sensors that we have to poll.
+		 * While the display is off, the slow poll only matters
+		 * for the LED brightness, so don't wake up just for it;
+		 * the poll doesn't need to be exact either, so let it
+		 * share wakeups with other work
 		 */
 		cancel_als_poll_timer();
-		als_poll_timer_cb_id = g_timeout_add(als_poll_interval,
-						     als_poll_timer_cb, NULL);
+		als_poll_timer_cb_id =
+			mce_timer_add_aligned(MCE_TIMER_DEFERRABLE,
+					      als_poll.interval,
+					      als_poll_timer_cb, NULL);
 		break;
 	}
 
@@ -1160,11 +2290,30 @@ EXIT:
 static void cancel_brightness_delay_timer(void)
 {
 	if (brightness_delay_timer_cb_id != 0) {
-		g_source_remove(brightness_delay_timer_cb_id);
+		mce_timer_remove(brightness_delay_timer_cb_id);
 		brightness_delay_timer_cb_id = 0;
 	}
 }
 
+/**
+ * Handle LED pattern activity changes
+ *
+ * @param data TRUE if an LED pattern is being shown, FALSE if not,
+ *             stored in a pointer
+ */
+static void led_pattern_active_trigger(gconstpointer data)
+{
+	/* The LED brightness isn't re-filtered while no pattern
+	 * is shown, so bring it up to date with the current lux
+	 */
+	if ((GPOINTER_TO_INT(data) != 0) && (led_uses_als() == TRUE))
+		(void)execute_datapipe(&led_brightness_pipe, NULL,
+				       USE_CACHE, DONT_CACHE_INDATA);
+
+	/* Take the LED threshold window into account, or drop it */
+	als_thresholds_changed();
+}
+
 /**
  * Handle display state change
  *
@@ -1173,30 +2322,36 @@ static void cancel_brightness_delay_timer(void)
 static void display_state_trigger(gconstpointer data)
 {
 	static display_state_t old_display_state = MCE_DISPLAY_UNDEF;
-	gint old_als_poll_interval = als_poll_interval;
+	gint old_als_poll_interval = als_poll.interval;
 	display_state = GPOINTER_TO_INT(data);
 
 	if (als_enabled == FALSE)
 		goto EXIT;
 
-	old_als_poll_interval = als_poll_interval;
+	old_als_poll_interval = als_poll.interval;
 
-	/* Update poll timeout */
+	/* Update poll timeout; start polling quickly in the new state
+	 * unless the current interval fits it, the interval backs off
+	 * if the light is stable
+	 */
 	switch (display_state) {
 	case MCE_DISPLAY_OFF:
 	case MCE_DISPLAY_LPM_OFF:
 	case MCE_DISPLAY_LPM_ON:
-		als_poll_interval = ALS_DISPLAY_OFF_POLL_FREQ;
+		als_poll_set_range(&als_poll, ALS_DISPLAY_OFF_POLL_FREQ,
+				   ALS_DISPLAY_OFF_POLL_FREQ);
 		break;
 
 	case MCE_DISPLAY_DIM:
-		als_poll_interval = ALS_DISPLAY_DIM_POLL_FREQ;
+		als_poll_set_range(&als_poll, als_poll_dim_min,
+				   als_poll_dim_max);
 		break;
 
 	case MCE_DISPLAY_UNDEF:
 	case MCE_DISPLAY_ON:
 	default:
-		als_poll_interval = ALS_DISPLAY_ON_POLL_FREQ;
+		als_poll_set_range(&als_poll, als_poll_on_min,
+				   als_poll_on_max);
 		break;
 	}
 
@@ -1211,8 +2366,8 @@ static void display_state_trigger(gconstpointer data)
 		cancel_als_poll_timer();
 
 #ifdef ALS_DISPLAY_OFF_FLUSH_FILTER
-		/* Re-initialise the median filter */
-		if (als_median_filter_init() == FALSE)
+		/* Re-initialise the smoothing chain */
+		if (als_filter_init() == FALSE)
 			goto EXIT;
 #endif /* ALS_DISPLAY_OFF_FLUSH_FILTER */
 
@@ -1227,15 +2382,14 @@ static void display_state_trigger(gconstpointer data)
 		    ((als_lux != new_lux) ||
 		     (brightness_step_down_policy ==
 		      BRIGHTNESS_STEP_UNBLANK))) {
-			/* Re-filter the brightness */
-			(void)execute_datapipe(&display_brightness_pipe, NULL, USE_CACHE, DONT_CACHE_INDATA);
-			(void)execute_datapipe(&led_brightness_pipe, NULL, USE_CACHE, DONT_CACHE_INDATA);
-			(void)execute_datapipe(&key_backlight_pipe, NULL, USE_CACHE, DONT_CACHE_INDATA);
-		}
+			als_lux = new_lux;
 
-		/* Restore threshold values */
-		if (als_external_refcount == 0)
+			/* Re-filter the brightness */
+			als_lux_changed();
+		} else if (als_external_refcount == 0) {
+			/* Restore threshold values */
 			adjust_als_thresholds(-1, -1);
+		}
 	} else if (((old_display_state == MCE_DISPLAY_ON) ||
 	            (old_display_state == MCE_DISPLAY_DIM)) &&
 		   ((display_state == MCE_DISPLAY_OFF) ||
@@ -1250,8 +2404,9 @@ static void display_state_trigger(gconstpointer data)
 	}
 
 	/* Reprogram timer, if needed */
-	if ((als_poll_interval != old_als_poll_interval) ||
-	    ((als_poll_timer_cb_id == 0) && (als_iomon_id == NULL)))
+	if ((als_poll.interval != old_als_poll_interval) ||
+	    ((als_poll_timer_cb_id == 0) && (als_iomon_id == NULL) &&
+	     (als_hub_attached == FALSE)))
 		setup_als_poll_timer();
 
 EXIT:
@@ -1746,6 +2901,7 @@ static gboolean set_color_profile(const gchar *id)
 	current_color_profile_id = color_profile->name;
 	display_cpa_profile_dynamic = color_profile->profiles;
 
+	display_cpa_table.level = -1; /* To force rewriting the coefficients */
 	display_brightness_lower = -1; /* To force readjustment */
 	als_iomon_common(als_lux, TRUE);
 
@@ -1837,7 +2993,7 @@ static gboolean init_display_id(void)
 	gchar *display_manufacturer = NULL;
 	gchar *dot = NULL;
 
-	if (mce_read_string_from_file(DISPLAY_HARDWARE_REVISION_PATH,
+	if (mce_read_string_from_file(display_hw_revision_path,
 				      &display_manufacturer) == FALSE)
 		return FALSE;
 
@@ -1979,6 +3135,13 @@ const gchar *g_module_check_init(GModule *module)
 				  key_backlight_filter);
 	append_output_trigger_to_datapipe(&display_state_pipe,
 					  display_state_trigger);
+	append_output_trigger_to_datapipe(&led_pattern_active_pipe,
+					  led_pattern_active_trigger);
+	append_refcount_trigger_to_datapipe(&led_brightness_pipe,
+					    als_consumers_trigger);
+	append_refcount_trigger_to_datapipe(&key_backlight_pipe,
+					    als_consumers_trigger);
+	als_consumers_trigger();
 
 	/* req_als_enable */
 	if (mce_dbus_handler_add(MCE_REQUEST_IF,
@@ -2035,6 +3198,10 @@ const gchar *g_module_check_init(GModule *module)
 
 	(void)get_als_type();
 
+	compile_als_profiles(display_als_profiles, display_als_tables);
+	compile_als_profiles(led_als_profiles, led_als_tables);
+	compile_als_profiles(kbd_als_profiles, kbd_als_tables);
+
 	if ((display_cpa_profile_static != NULL) &&
 	    (init_display_id() != FALSE) &&
 	    (init_color_profiles() != FALSE)) {
@@ -2054,12 +3221,21 @@ const gchar *g_module_check_init(GModule *module)
 			goto EXIT;
 	}
 
+	als_backend = get_als_backend();
+
+	get_als_poll_range(MCE_CONF_ALS_POLL_INTERVAL_ON,
+			   &als_poll_on_min, &als_poll_on_max);
+	get_als_poll_range(MCE_CONF_ALS_POLL_INTERVAL_DIM,
+			   &als_poll_dim_min, &als_poll_dim_max);
+
 	/* Do we have an ALS at all?
 	 * If so, make an initial read
 	 */
 	if (get_als_type() != ALS_TYPE_NONE) {
-		/* Initialise the median filter */
-		if (als_median_filter_init() == FALSE) {
+		/* Initialise the smoothing chain */
+		als_filter_setup();
+
+		if (als_filter_init() == FALSE) {
 			goto EXIT;
 		}
 
@@ -2069,7 +3245,9 @@ const gchar *g_module_check_init(GModule *module)
 		/* Initial read of lux value from ALS */
 		if ((als_lux = als_read_value_filtered()) >= 0) {
 			/* Set initial polling interval */
-			als_poll_interval = ALS_DISPLAY_ON_POLL_FREQ;
+			als_poll_set_range(&als_poll, als_poll_on_min,
+					   als_poll_on_max);
+			als_poll_reset(&als_poll);
 
 			/* Setup ALS polling */
 			setup_als_poll_timer();
@@ -2121,6 +3299,7 @@ void g_module_unload(GModule *module)
 
 	display_cpa_profile_dynamic = NULL;
 	current_color_profile_id = NULL;
+	free_cpa_table();
 	free_color_profiles(display_cpa_profiles);
 	display_cpa_profiles = NULL;
 
@@ -2133,6 +3312,12 @@ void g_module_unload(GModule *module)
 	(void)mce_close_file(als_lux_path, &als_fp);
 
 	/* Remove triggers/filters from datapipes */
+	remove_refcount_trigger_from_datapipe(&key_backlight_pipe,
+					      als_consumers_trigger);
+	remove_refcount_trigger_from_datapipe(&led_brightness_pipe,
+					      als_consumers_trigger);
+	remove_output_trigger_from_datapipe(&led_pattern_active_pipe,
+					    led_pattern_active_trigger);
 	remove_output_trigger_from_datapipe(&display_state_pipe,
 					    display_state_trigger);
 	remove_filter_from_datapipe(&key_backlight_pipe,
@@ -2146,5 +3331,9 @@ void g_module_unload(GModule *module)
 	cancel_als_poll_timer();
 	cancel_brightness_delay_timer();
 
+	als_filter_free();
+
+	free_simulated_als();
+
 	return;
 }
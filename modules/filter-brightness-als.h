@@ -23,6 +23,8 @@
 #ifndef _FILTER_BRIGHTNESS_ALS_H_
 #define _FILTER_BRIGHTNESS_ALS_H_
 
+#include "als_filter.h"			/* als_profile_struct, ALS_RANGES */
+
 /** Path to get the display manufacturer */
 #define DISPLAY_HARDWARE_REVISION_PATH "/sys/devices/omapdss/display0/hw_revision"
 
@@ -44,6 +46,96 @@
 /** Name of the configuration key for the brightness level step-down policy */
 #define MCE_CONF_STEP_DOWN_POLICY		"StepDownPolicy"
 
+/** Name of configuration key for sysfs notification of lux changes */
+#define MCE_CONF_ALS_LUX_NOTIFY			"LuxNotify"
+
+/** Default policy for sysfs notification of lux changes */
+#define DEFAULT_ALS_LUX_NOTIFY			FALSE
+
+/**
+ * Name of configuration key for the ALS poll interval range
+ * when the display is on
+ */
+#define MCE_CONF_ALS_POLL_INTERVAL_ON		"PollIntervalOn"
+
+/**
+ * Name of configuration key for the ALS poll interval range
+ * when the display is dimmed
+ */
+#define MCE_CONF_ALS_POLL_INTERVAL_DIM		"PollIntervalDim"
+
+/** Name of configuration key for the Avago ALS smoothing chain */
+#define MCE_CONF_ALS_FILTER_CHAIN_AVAGO		"FilterChainAvago"
+/** Name of configuration key for the Dipro ALS smoothing chain */
+#define MCE_CONF_ALS_FILTER_CHAIN_DIPRO		"FilterChainDipro"
+/** Name of configuration key for the TSL2563 ALS smoothing chain */
+#define MCE_CONF_ALS_FILTER_CHAIN_TSL2563	"FilterChainTSL2563"
+/** Name of configuration key for the TSL2562 ALS smoothing chain */
+#define MCE_CONF_ALS_FILTER_CHAIN_TSL2562	"FilterChainTSL2562"
+/** Name of configuration key for the simulated ALS smoothing chain */
+#define MCE_CONF_ALS_FILTER_CHAIN_SIMULATED	"FilterChainSimulated"
+
+/** Name of configuration key for the simulated ALS device */
+#define MCE_CONF_ALS_SIMULATED_DEVICE		"SimulatedDevice"
+/** Name of configuration key for the profiles of the simulated ALS */
+#define MCE_CONF_ALS_SIMULATED_PROFILES		"SimulatedProfiles"
+/** Name of configuration key for the simulated sysfs directory */
+#define MCE_CONF_ALS_SIMULATED_SYSFS_DIR	"SimulatedSysfsDir"
+
+/** Name of configuration key for the median window size */
+#define MCE_CONF_ALS_MEDIAN_WINDOW		"MedianWindow"
+/** Name of configuration key for the moving average weight */
+#define MCE_CONF_ALS_EWMA_WEIGHT		"EwmaWeight"
+/** Name of configuration key for the hysteresis band */
+#define MCE_CONF_ALS_HYSTERESIS_BAND		"HysteresisBand"
+/** Name of configuration key for the minimum hysteresis band */
+#define MCE_CONF_ALS_HYSTERESIS_MIN		"HysteresisMin"
+/** Name of configuration key for the spike ratio */
+#define MCE_CONF_ALS_SPIKE_RATIO		"SpikeRatio"
+/** Name of configuration key for the minimum spike */
+#define MCE_CONF_ALS_SPIKE_MIN			"SpikeMin"
+/** Name of configuration key for the number of spikes to reject */
+#define MCE_CONF_ALS_SPIKE_HOLD			"SpikeHold"
+
+/**
+ * Default Avago ALS smoothing chain;
+ * the sensor only reports readings outside the threshold window
+ */
+#define DEFAULT_ALS_FILTER_CHAIN_AVAGO		""
+/**
+ * Default Dipro ALS smoothing chain;
+ * the sensor only reports readings outside the threshold window
+ */
+#define DEFAULT_ALS_FILTER_CHAIN_DIPRO		""
+/** Default TSL2563 ALS smoothing chain */
+#define DEFAULT_ALS_FILTER_CHAIN_TSL2563	"median"
+/** Default TSL2562 ALS smoothing chain */
+#define DEFAULT_ALS_FILTER_CHAIN_TSL2562	"median"
+/** Default simulated ALS smoothing chain */
+#define DEFAULT_ALS_FILTER_CHAIN_SIMULATED	""
+
+/** Default simulated ALS device; empty to use the real sensor */
+#define DEFAULT_ALS_SIMULATED_DEVICE		""
+/** Default profiles of the simulated ALS */
+#define DEFAULT_ALS_SIMULATED_PROFILES		"rm696"
+/** Default simulated sysfs directory; empty for none */
+#define DEFAULT_ALS_SIMULATED_SYSFS_DIR		""
+
+/** Default median window size */
+#define DEFAULT_ALS_MEDIAN_WINDOW		5
+/** Default moving average weight of new readings, in % */
+#define DEFAULT_ALS_EWMA_WEIGHT			50
+/** Default hysteresis band, in % of the last output */
+#define DEFAULT_ALS_HYSTERESIS_BAND		10
+/** Default minimum hysteresis band, in lux */
+#define DEFAULT_ALS_HYSTERESIS_MIN		2
+/** Default spike ratio, in % */
+#define DEFAULT_ALS_SPIKE_RATIO			400
+/** Default minimum spike, in lux */
+#define DEFAULT_ALS_SPIKE_MIN			20
+/** Default number of spikes in a row to reject */
+#define DEFAULT_ALS_SPIKE_HOLD			1
+
 /*  Paths for Avago APDS990x (QPDS-T900) ALS */
 
 /** Device path for Avago ALS */
@@ -104,6 +196,19 @@ struct dipro_als {
 /** Maximun threshold value for the Dipro ALS */
 #define ALS_THRESHOLD_MAX_DIPRO		65535
 
+/* Paths for the simulated ALS; relative to the simulated sysfs directory */
+
+/** ALS threshold range for the simulated ALS */
+#define ALS_THRESHOLD_RANGE_SIMULATED	"als_threshold_range"
+/** Maximum threshold value for the simulated ALS */
+#define ALS_THRESHOLD_MAX_SIMULATED	G_MAXINT
+/** Colour phase adjustment enabling entry for the simulated ALS */
+#define COLOUR_PHASE_ENABLE_SIMULATED	"cpr_enable"
+/** Colour phase adjustment coefficients entry for the simulated ALS */
+#define COLOUR_PHASE_COEFFICIENTS_SIMULATED	"cpr_coef"
+/** Display hardware revision entry for the simulated ALS */
+#define DISPLAY_HARDWARE_REVISION_SIMULATED	"hw_revision"
+
 /* Paths for the TSL2563 ALS */
 
 /** Base path to the TSL2563 ALS */
@@ -135,10 +240,28 @@ struct dipro_als {
 /** Path to the color profile GConf setting */
 #define MCE_GCONF_DISPLAY_COLOR_PROFILE_PATH	MCE_GCONF_DISPLAY_PATH "/color_profile"
 
-/** Default ALS polling frequency when the display is on */
-#define ALS_DISPLAY_ON_POLL_FREQ	1500		/* Milliseconds */
-/** Default ALS polling frequency when the display is dimmed */
-#define ALS_DISPLAY_DIM_POLL_FREQ	5000		/* Milliseconds */
+/**
+ * Default shortest ALS poll interval when the display is on;
+ * used while the ambient light changes
+ */
+#define ALS_DISPLAY_ON_POLL_MIN		500		/* Milliseconds */
+/**
+ * Default longest ALS poll interval when the display is on;
+ * the interval doubles up to this while the ambient light is stable
+ *
+ * Longer intervals save more polls, but the brightness lags
+ * further behind the ambient light than with the old fixed
+ * interval of 1500 ms; compare with alstune before changing this
+ */
+#define ALS_DISPLAY_ON_POLL_MAX		2000		/* Milliseconds */
+/**
+ * Default shortest ALS poll interval when the display is dimmed;
+ * adapting the interval doesn't pay off when dimmed,
+ * so the interval is fixed
+ */
+#define ALS_DISPLAY_DIM_POLL_MIN	5000		/* Milliseconds */
+/** Default longest ALS poll interval when the display is dimmed */
+#define ALS_DISPLAY_DIM_POLL_MAX	5000		/* Milliseconds */
 /**
  * Default ALS polling frequency when the display is off
  *
@@ -156,15 +279,12 @@ struct dipro_als {
 /** Brightness stepdown delay, secs */
 #define ALS_BRIGHTNESS_STEPDOWN_DELAY	5
 
-/** Window size for the median filter */
-#define MEDIAN_FILTER_WINDOW_SIZE	5
+/** How often to log the ALS wakeup rate; in seconds */
+#define ALS_WAKEUP_REPORT_INTERVAL	3600
 
 /** Sysinfo identifier for the ALS calibration values */
 #define ALS_CALIB_IDENTIFIER		"/device/als_calib"
 
-/** Number of ranges in ALS profile */
-#define ALS_RANGES			11
-
 /** Path to display manager */
 #define DISPLAY_MANAGER_PATH			"/sys/devices/platform/omapdss/manager0"
 /** Colour phase adjustment enable path */
@@ -172,14 +292,6 @@ struct dipro_als {
 /** Colour phase adjustment coefficients path */
 #define COLOUR_PHASE_COEFFICIENTS_PATH		DISPLAY_MANAGER_PATH "/cpr_coef"
 
-/** ALS profile */
-typedef struct {
-	/** Lower and upper bound for each brightness range */
-	const gint range[ALS_RANGES][2];
-	/** Brightness in % + possible HBM boost (boost level * 256) */
-	const gint value[ALS_RANGES + 1];
-} als_profile_struct;
-
 
 /** Colour phase adjustment matrix */
 typedef struct {
@@ -195,6 +307,20 @@ typedef struct {
 	const gchar *const coefficients;
 } cpa_profile_struct;
 
+/** Colour phase profile compiled for binary search */
+typedef struct {
+	/** The profile that was compiled */
+	const cpa_profile_struct *profile;
+	/** Number of lux intervals */
+	gint count;
+	/** Lower bound of each lux interval, in ascending order */
+	gint *bounds;
+	/** Profile entry for each lux interval; -1 for none */
+	gint *entries;
+	/** Profile entry in use; -1 for none */
+	gint level;
+} cpa_table_t;
+
 /** Colour profile */
 typedef struct {
 	/**
@@ -209,6 +335,12 @@ typedef struct {
 
 /* Colour phase adjustment matrices */
 
+/*
+ * Tools that only need the ALS profiles define ALS_PROFILES_ONLY
+ * before including this file, to leave the matrices out
+ */
+#ifndef ALS_PROFILES_ONLY
+
 /** Colour phase calibration for RM-696/RM-716 */
 static cpa_profile_struct rm696_phase_profile[] = {
 	{	/* 0-100 lux; */
@@ -259,6 +391,7 @@ static cpa_profile_struct rm680_phase_profile[] = {
 		NULL
 	}
 };
+#endif /* ALS_PROFILES_ONLY */
 
 /**
  * ALS profile for the display in:
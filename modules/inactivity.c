@@ -24,8 +24,14 @@
 #include <string.h>			/* strcmp() */
 
 #include "mce.h"
+#include "inactivity.h"
 
+#include "mce-lib.h"			/* mce_get_monotonic_time_ms() */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add(),
+					 * mce_timer_add_seconds(),
+					 * mce_timer_remove()
+					 */
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
@@ -47,6 +53,7 @@
 					 * MCE_REQUEST_IF
 					 * MCE_INACTIVITY_STATUS_GET,
 					 * MCE_INACTIVITY_SIG,
+					 * MCE_ACTIVITY_SIG,
 					 * MCE_ADD_ACTIVITY_CALLBACK_REQ,
 					 * MCE_REMOVE_ACTIVITY_CALLBACK_REQ
 					 */
@@ -97,9 +104,32 @@ static GSList *activity_cb_monitor_list = NULL;
 /** ID for inactivity timeout source */
 static guint inactivity_timeout_cb_id = 0;
 
+/** Monotonic time of the last activity, in milliseconds */
+static gint64 last_activity_time = 0;
+
+/** ID for the delayed activity signal source */
+static guint activity_signal_timeout_cb_id = 0;
+
+/** Monotonic time of the last activity signal, in milliseconds */
+static gint64 last_activity_signal_time = 0;
+
+/** Has there been activity since the last activity signal? */
+static gboolean activity_signal_pending = FALSE;
+
+/** Number of activity events seen */
+static guint activity_count = 0;
+
+/** Number of activity signals sent */
+static guint activity_signal_count = 0;
+
+/** Number of legacy activity callback method calls sent */
+static guint activity_callback_count = 0;
+
 /** Device inactivity state */
 static gboolean device_inactive = FALSE;
 
+static void arm_inactivity_timeout(gint64 delay);
+
 /**
  * Send an inactivity status reply or signal
  *
@@ -386,6 +416,19 @@ EXIT:
 	return status;
 }
 
+/**
+ * Log how many activity messages have been sent,
+ * and for how many activity events
+ */
+static void log_activity_counts(void)
+{
+	mce_log(LL_DEBUG,
+		"Activity messages sent; %u signals and %u callbacks "
+		"for %u activity events",
+		activity_signal_count, activity_callback_count,
+		activity_count);
+}
+
 /**
  * Call all activity callbacks, then unregister them
  */
@@ -393,6 +436,9 @@ static void call_activity_callbacks(void)
 {
 	GSList *tmp = activity_callbacks;
 
+	if (tmp == NULL)
+		goto EXIT;
+
 	while (tmp != NULL) {
 		activity_cb_t *cb;
 
@@ -403,6 +449,7 @@ static void call_activity_callbacks(void)
 				cb->interface, cb->method_name,
 				NULL,
 				DBUS_TYPE_INVALID);
+		activity_callback_count++;
 
 		g_free(cb->owner);
 		g_free(cb->service);
@@ -418,6 +465,102 @@ static void call_activity_callbacks(void)
 	activity_callbacks = NULL;
 
 	mce_dbus_owner_monitor_remove_all(&activity_cb_monitor_list);
+
+	log_activity_counts();
+
+EXIT:
+	return;
+}
+
+/**
+ * Send an activity signal
+ *
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean send_activity_signal(void)
+{
+	DBusMessage *msg;
+
+	activity_signal_pending = FALSE;
+	last_activity_signal_time = mce_get_monotonic_time_ms();
+	activity_signal_count++;
+
+	/* system_activity_ind */
+	msg = dbus_new_signal(MCE_SIGNAL_PATH, MCE_SIGNAL_IF,
+			      MCE_ACTIVITY_SIG);
+
+	return dbus_send_message(msg);
+}
+
+/**
+ * Timeout callback for the delayed activity signal
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean activity_signal_timeout_cb(gpointer data)
+{
+	(void)data;
+
+	activity_signal_timeout_cb_id = 0;
+
+	if (activity_signal_pending == TRUE)
+		(void)send_activity_signal();
+
+	return FALSE;
+}
+
+/**
+ * Cancel the delayed activity signal
+ */
+static void cancel_activity_signal_timeout(void)
+{
+	if (activity_signal_timeout_cb_id != 0) {
+		mce_timer_remove(activity_signal_timeout_cb_id);
+		activity_signal_timeout_cb_id = 0;
+	}
+}
+
+/**
+ * Broadcast activity; the first activity after a quiet period
+ * is signalled immediately, further activity within
+ * ACTIVITY_SIGNAL_INTERVAL is collapsed into a single signal
+ * sent at the end of the interval
+ */
+static void broadcast_activity(void)
+{
+	gint64 elapsed = last_activity_time - last_activity_signal_time;
+
+	activity_count++;
+
+	if ((last_activity_signal_time == 0) ||
+	    (elapsed >= ACTIVITY_SIGNAL_INTERVAL)) {
+		(void)send_activity_signal();
+	} else if (activity_signal_timeout_cb_id == 0) {
+		activity_signal_pending = TRUE;
+		activity_signal_timeout_cb_id =
+			mce_timer_add((guint)(ACTIVITY_SIGNAL_INTERVAL -
+					      elapsed),
+				      activity_signal_timeout_cb, NULL);
+	} else {
+		activity_signal_pending = TRUE;
+	}
+}
+
+/**
+ * Get the inactivity timeout
+ *
+ * @return The inactivity timeout in milliseconds
+ */
+static gint64 get_inactivity_timeout(void)
+{
+	gint timeout = datapipe_get_gint(inactivity_timeout_pipe);
+
+	/* Sanitise timeout */
+	if (timeout <= 0)
+		timeout = 30;
+
+	return (gint64)timeout * 1000;
 }
 
 /**
@@ -428,13 +571,25 @@ static void call_activity_callbacks(void)
  */
 static gboolean inactivity_timeout_cb(gpointer data)
 {
+	gint64 deadline = last_activity_time + get_inactivity_timeout();
+	gint64 now = mce_get_monotonic_time_ms();
+
 	(void)data;
 
 	inactivity_timeout_cb_id = 0;
 
+	/* If there has been activity since the timeout was set up,
+	 * wait for the rest of the inactivity timeout instead
+	 */
+	if (now < deadline) {
+		arm_inactivity_timeout(deadline - now);
+		goto EXIT;
+	}
+
 	(void)execute_datapipe(&device_inactive_pipe, GINT_TO_POINTER(TRUE),
 			       USE_INDATA, CACHE_INDATA);
 
+EXIT:
 	return FALSE;
 }
 
@@ -445,27 +600,49 @@ static void cancel_inactivity_timeout(void)
 {
 	/* Remove inactivity timeout source */
 	if (inactivity_timeout_cb_id != 0) {
-		g_source_remove(inactivity_timeout_cb_id);
+		mce_timer_remove(inactivity_timeout_cb_id);
 		inactivity_timeout_cb_id = 0;
 	}
 }
 
+/**
+ * Arm the inactivity timeout
+ *
+ * @param delay The delay in milliseconds
+ */
+static void arm_inactivity_timeout(gint64 delay)
+{
+	/* Round up, so that the timeout never fires early */
+	inactivity_timeout_cb_id =
+		mce_timer_add_seconds((guint)((delay + 999) / 1000),
+				      inactivity_timeout_cb, NULL);
+}
+
 /**
  * Setup inactivity timeout
  */
 static void setup_inactivity_timeout(void)
 {
-	gint timeout = datapipe_get_gint(inactivity_timeout_pipe);
-
 	cancel_inactivity_timeout();
 
-	/* Sanitise timeout */
-	if (timeout <= 0)
-		timeout = 30;
+	last_activity_time = mce_get_monotonic_time_ms();
 
 	/* Setup new timeout */
-	inactivity_timeout_cb_id =
-		g_timeout_add_seconds(timeout, inactivity_timeout_cb, NULL);
+	arm_inactivity_timeout(get_inactivity_timeout());
+}
+
+/**
+ * Register activity
+ * Only the time of the activity is stored; if the inactivity timeout
+ * is already running, it checks the time when it fires and extends
+ * itself as needed, rather than being set up again for every event
+ */
+static void register_activity(void)
+{
+	last_activity_time = mce_get_monotonic_time_ms();
+
+	if (inactivity_timeout_cb_id == 0)
+		arm_inactivity_timeout(get_inactivity_timeout());
 }
 
 /**
@@ -502,8 +679,9 @@ static gpointer device_inactive_filter(gpointer data)
 
 	/* We got activity; restart timeouts */
 	if (device_inactive == FALSE) {
+		register_activity();
+		broadcast_activity();
 		call_activity_callbacks();
-		setup_inactivity_timeout();
 	}
 
 	/* Only send the inactivity status if it changed */
@@ -601,6 +779,12 @@ void g_module_unload(GModule *module)
 
 	/* Remove all timer sources */
 	cancel_inactivity_timeout();
+	cancel_activity_signal_timeout();
+
+	/* The counts are otherwise only logged with the callbacks,
+	 * which there may never be any of
+	 */
+	log_activity_counts();
 
 	return;
 }
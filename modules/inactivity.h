@@ -0,0 +1,37 @@
+/**
+ * @file inactivity.h
+ * Headers for the inactivity module
+ * <p>
+ * Copyright © 2007-2011 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _INACTIVITY_H_
+#define _INACTIVITY_H_
+
+#ifndef MCE_ACTIVITY_SIG
+/**
+ * Signal sent on user activity; rate limited to at most
+ * one signal per ACTIVITY_SIGNAL_INTERVAL
+ */
+#define MCE_ACTIVITY_SIG		"system_activity_ind"
+#endif /* MCE_ACTIVITY_SIG */
+
+/**
+ * Minimum interval between activity signals; activity during
+ * the interval is reported by a single signal at the end of it;
+ * 1000 milliseconds
+ */
+#define ACTIVITY_SIGNAL_INTERVAL	1000
+
+#endif /* _INACTIVITY_H_ */
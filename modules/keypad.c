@@ -33,6 +33,9 @@
 #include "mce-hal.h"			/* get_product_id() */
 #include "mce-lib.h"			/* bin_to_string() */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add_seconds(),
+					 * mce_timer_remove()
+					 */
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
@@ -452,7 +455,7 @@ static gboolean key_backlight_timeout_cb(gpointer data)
 static void cancel_key_backlight_timeout(void)
 {
 	if (key_backlight_timeout_cb_id != 0) {
-		g_source_remove(key_backlight_timeout_cb_id);
+		mce_timer_remove(key_backlight_timeout_cb_id);
 		key_backlight_timeout_cb_id = 0;
 	}
 }
@@ -466,7 +469,7 @@ static void setup_key_backlight_timeout(void)
 
 	/* Setup a new timeout */
 	key_backlight_timeout_cb_id =
-		g_timeout_add_seconds(key_backlight_timeout,
+		mce_timer_add_seconds(key_backlight_timeout,
 				      key_backlight_timeout_cb, NULL);
 }
 
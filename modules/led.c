@@ -955,6 +955,24 @@ static void program_led(const pattern_struct *const pattern)
 	}
 }
 
+/**
+ * Let the other modules know whether an LED pattern is being shown
+ */
+static void update_led_pattern_active(void)
+{
+	gboolean active = (active_pattern != NULL);
+
+	if (datapipe_get_gint(led_pattern_active_pipe) == active)
+		goto EXIT;
+
+	(void)execute_datapipe(&led_pattern_active_pipe,
+			       GINT_TO_POINTER(active),
+			       USE_INDATA, CACHE_INDATA);
+
+EXIT:
+	return;
+}
+
 /**
  * Recalculate active pattern and update the pattern timer
  */
@@ -1055,6 +1073,8 @@ static void led_update_active_pattern(void)
 	active_pattern = new_active_pattern;
 
 EXIT:
+	update_led_pattern_active();
+
 	return;
 }
 
@@ -1518,6 +1538,7 @@ static gboolean led_disable_dbus_cb(DBusMessage *const msg)
 
 	led_disable();
 	active_pattern = NULL;
+	update_led_pattern_active();
 
 	if (no_reply == FALSE) {
 		DBusMessage *reply = dbus_new_method_reply(msg);
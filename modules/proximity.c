@@ -32,14 +32,16 @@
 #include "mce.h"
 #include "proximity.h"
 
-#include "mce-io.h"			/* mce_read_chunk_from_file(),
-					 * mce_write_string_to_file(),
-					 * mce_write_number_string_to_file(),
-					 * mce_register_io_monitor_chunk(),
-					 * mce_unregister_io_monitor()
+#include "mce-io.h"			/* mce_write_string_to_file(),
+					 * mce_write_number_string_to_file()
 					 */
 #include "mce-hal.h"			/* get_sysinfo_value() */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-sensorhub.h"		/* mce_sensorhub_attach(),
+					 * mce_sensorhub_detach(),
+					 * mce_sensorhub_read(),
+					 * SENSORHUB_CHANNEL_PS
+					 */
 #include "mce-dbus.h"			/* Direct:
 					 * ---
 					 * mce_dbus_handler_add(),
@@ -101,8 +103,14 @@ typedef enum {
 	PS_TYPE_AVAGO = 2
 } ps_type_t;
 
-/** ID for the proximity sensor I/O monitor */
-static gconstpointer proximity_sensor_iomon_id = NULL;
+/** Is the proximity sensor attached to the sensor hub? */
+static gboolean ps_hub_attached = FALSE;
+
+/** Buffer for reads from the Avago proximity sensor */
+static struct avago_ps ps_avago_data;
+
+/** Buffer for reads from the Dipro proximity sensor */
+static struct dipro_ps ps_dipro_data;
 
 /** Path to the proximity sensor device file entry */
 static const gchar *ps_device_path = NULL;
@@ -356,11 +364,10 @@ EXIT:
 static void update_proximity_sensor_state_avago(void)
 {
 	cover_state_t proximity_sensor_state;
-	struct avago_ps *ps;
-	void *tmp = NULL;
+	struct avago_ps *ps = &ps_avago_data;
 	gssize len = sizeof (struct avago_ps);
 
-	if (mce_read_chunk_from_file(ps_device_path, &tmp, &len, 0) == FALSE)
+	if (mce_sensorhub_read(ps_device_path, ps, &len) == FALSE)
 		goto EXIT;
 
 	if (len != sizeof (struct avago_ps)) {
@@ -370,8 +377,6 @@ static void update_proximity_sensor_state_avago(void)
 		goto EXIT;
 	}
 
-	ps = (struct avago_ps *)tmp;
-
 	if ((ps->status & APDS990X_PS_UPDATED) == 0)
 		goto EXIT;
 
@@ -387,8 +392,6 @@ static void update_proximity_sensor_state_avago(void)
 			       USE_INDATA, CACHE_INDATA);
 
 EXIT:
-	g_free(tmp);
-
 	return;
 }
 
@@ -400,11 +403,10 @@ EXIT:
 static void update_proximity_sensor_state_dipro(void)
 {
 	cover_state_t proximity_sensor_state;
-	struct dipro_ps *ps;
-	void *tmp = NULL;
+	struct dipro_ps *ps = &ps_dipro_data;
 	gssize len = sizeof (struct dipro_ps);
 
-	if (mce_read_chunk_from_file(ps_device_path, &tmp, &len, 0) == FALSE)
+	if (mce_sensorhub_read(ps_device_path, ps, &len) == FALSE)
 		goto EXIT;
 
 	if (len != sizeof (struct dipro_ps)) {
@@ -414,8 +416,6 @@ static void update_proximity_sensor_state_dipro(void)
 		goto EXIT;
 	}
 
-	ps = (struct dipro_ps *)tmp;
-
 	if (ps->led1 < ps_threshold->threshold_rising)
 		proximity_sensor_state = COVER_OPEN;
 	else
@@ -428,8 +428,6 @@ static void update_proximity_sensor_state_dipro(void)
 			       USE_INDATA, CACHE_INDATA);
 
 EXIT:
-	g_free(tmp);
-
 	return;
 }
 
@@ -455,20 +453,21 @@ static void update_proximity_monitor(void)
 	    (alarm_ui_state == MCE_ALARM_UI_VISIBLE_INT32) ||
 	    (alarm_ui_state == MCE_ALARM_UI_RINGING_INT32)) {
 		/* Register proximity sensor I/O monitor */
-		if (proximity_sensor_iomon_id == NULL) {
+		if (ps_hub_attached == FALSE) {
 			(void)enable_proximity_sensor();
 
 			/* FIXME: is code forking the only way to do these? */
 			switch (get_ps_type()) {
 			case PS_TYPE_AVAGO:
-				if ((proximity_sensor_iomon_id = mce_register_io_monitor_chunk(-1, ps_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, ps_avago_iomon_cb, sizeof (struct avago_ps))) == NULL)
+				/* Shared with the ALS */
+				if ((ps_hub_attached = mce_sensorhub_attach(SENSORHUB_CHANNEL_PS, ps_device_path, sizeof (struct avago_ps), ps_avago_iomon_cb)) == FALSE)
 					goto EXIT;
 
 				update_proximity_sensor_state_avago();
 				break;
 
 			case PS_TYPE_DIPRO:
-				if ((proximity_sensor_iomon_id = mce_register_io_monitor_chunk(-1, ps_device_path, MCE_IO_ERROR_POLICY_WARN, G_IO_IN | G_IO_PRI | G_IO_ERR, FALSE, ps_dipro_iomon_cb, sizeof (struct dipro_ps))) == NULL)
+				if ((ps_hub_attached = mce_sensorhub_attach(SENSORHUB_CHANNEL_PS, ps_device_path, sizeof (struct dipro_ps), ps_dipro_iomon_cb)) == FALSE)
 					goto EXIT;
 
 				update_proximity_sensor_state_dipro();
@@ -481,8 +480,8 @@ static void update_proximity_monitor(void)
 	} else {
 		/* Unregister proximity sensor I/O monitor */
 		disable_proximity_sensor();
-		mce_unregister_io_monitor(proximity_sensor_iomon_id);
-		proximity_sensor_iomon_id = NULL;
+		mce_sensorhub_detach(SENSORHUB_CHANNEL_PS);
+		ps_hub_attached = FALSE;
 	}
 
 EXIT:
@@ -767,8 +766,9 @@ void g_module_unload(GModule *module)
 	remove_input_trigger_from_datapipe(&call_state_pipe,
 					   call_state_trigger);
 
-	/* Unregister I/O monitors */
-	mce_unregister_io_monitor(proximity_sensor_iomon_id);
+	/* Let go of the sensor */
+	mce_sensorhub_detach(SENSORHUB_CHANNEL_PS);
+	ps_hub_attached = FALSE;
 
 	return;
 }
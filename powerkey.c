@@ -22,6 +22,8 @@
 
 #include <stdlib.h>			/* exit(), EXIT_FAILURE */
 #include <string.h>			/* strcmp() */
+#include <time.h>			/* clock_gettime(), CLOCK_MONOTONIC */
+#include <sys/time.h>			/* struct timeval */
 #include <linux/input.h>		/* struct input_event */
 
 #include "mce.h"			/* mce_get_submode_int32(),
@@ -37,6 +39,9 @@
 #include "powerkey.h"
 
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add(),
+					 * mce_timer_remove()
+					 */
 #include "mce-conf.h"			/* mce_conf_get_int(),
 					 * mce_conf_get_string()
 					 */
@@ -105,6 +110,11 @@ static gchar *longpresssignal = NULL;
 /** D-Bus signal to send on double [power] press */
 static gchar *doublepresssignal = NULL;
 
+/** Kernel timestamp of the last [power] press */
+static struct timeval powerkey_press_time;
+/** Delay in milliseconds for a long press of the last [power] press */
+static gint powerkey_press_delay = 0;
+
 static void cancel_powerkey_timeout(void);
 
 /**
@@ -240,7 +250,7 @@ static void cancel_doublepress_timeout(void)
 {
 	/* Remove the timeout source for the [power] double key press handler */
 	if (doublepress_timeout_cb_id != 0) {
-		g_source_remove(doublepress_timeout_cb_id);
+		mce_timer_remove(doublepress_timeout_cb_id);
 		doublepress_timeout_cb_id = 0;
 	}
 }
@@ -280,7 +290,7 @@ static gboolean setup_doublepress_timeout(void)
 
 	/* Setup new timeout */
 	doublepress_timeout_cb_id =
-		g_timeout_add(doublepressdelay, doublepress_timeout_cb, NULL);
+		mce_timer_add(doublepressdelay, doublepress_timeout_cb, NULL);
 	status = TRUE;
 
 EXIT:
@@ -387,11 +397,56 @@ static void cancel_powerkey_timeout(void)
 {
 	/* Remove the timeout source for the [power] long key press handler */
 	if (powerkey_timeout_cb_id != 0) {
-		g_source_remove(powerkey_timeout_cb_id);
+		mce_timer_remove(powerkey_timeout_cb_id);
 		powerkey_timeout_cb_id = 0;
 	}
 }
 
+/**
+ * Get the time between two input event timestamps
+ *
+ * @param from The earlier timestamp
+ * @param to The later timestamp
+ * @return The time in milliseconds; 0 if the timestamps are out of order
+ */
+static gint timeval_diff_ms(const struct timeval *from,
+			    const struct timeval *to)
+{
+	gint64 diff = (((gint64)to->tv_sec - from->tv_sec) * 1000) +
+		      ((to->tv_usec - from->tv_usec) / 1000);
+
+	return (diff > 0) ? (gint)MIN(diff, G_MAXINT) : 0;
+}
+
+/**
+ * Get the time that has passed since an input event was generated
+ * The keyboard event devices are set to timestamp their events
+ * using the monotonic clock, so this is the time the event spent
+ * in transit; should the kernel still use the wall clock,
+ * the age comes out as 0
+ *
+ * @param ev The input event
+ * @param limit The maximum age to report, in milliseconds
+ * @return The age in milliseconds, clamped to [0, limit]
+ */
+static gint input_event_age(const struct input_event *ev, gint limit)
+{
+	struct timespec ts;
+	struct timeval now;
+	gint age = 0;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		goto EXIT;
+
+	now.tv_sec = ts.tv_sec;
+	now.tv_usec = ts.tv_nsec / 1000;
+
+	age = MIN(timeval_diff_ms(&ev->time, &now), MAX(limit, 0));
+
+EXIT:
+	return age;
+}
+
 /**
  * Setup powerkey timeout
  */
@@ -401,7 +456,7 @@ static void setup_powerkey_timeout(gint powerkeydelay)
 
 	/* Setup new timeout */
 	powerkey_timeout_cb_id =
-		g_timeout_add(powerkeydelay, powerkey_timeout_cb, NULL);
+		mce_timer_add(powerkeydelay, powerkey_timeout_cb, NULL);
 }
 
 /**
@@ -534,7 +589,12 @@ static void powerkey_trigger(gconstpointer const data)
 	if ((ev != NULL) && (ev->code == KEY_POWER)) {
 		/* If set, the [power] key was pressed */
 		if (ev->value == 1) {
-			mce_log(LL_DEBUG, "[power] pressed");
+			gint age = input_event_age(ev, longdelay);
+
+			mce_log(LL_DEBUG, "[power] pressed; latency %d ms",
+				age);
+
+			powerkey_press_time = ev->time;
 
 			/* Are we waiting for a doublepress? */
 			if (doublepress_timeout_cb_id != 0) {
@@ -547,15 +607,31 @@ static void powerkey_trigger(gconstpointer const data)
 				/* Shorter delay for startup
 				 * than for shutdown
 				 */
-				setup_powerkey_timeout(mediumdelay);
+				powerkey_press_delay = mediumdelay;
+				setup_powerkey_timeout(MAX(mediumdelay - age, 0));
 			} else {
-				setup_powerkey_timeout(longdelay);
+				/* Measure the delay from the time the key
+				 * was pressed, not from the time we got to it
+				 */
+				powerkey_press_delay = longdelay;
+				setup_powerkey_timeout(MAX(longdelay - age, 0));
 			}
 		} else if (ev->value == 0) {
-			mce_log(LL_DEBUG, "[power] released");
-
-			/* Short key press */
-			if (powerkey_timeout_cb_id != 0) {
+			gint held = timeval_diff_ms(&powerkey_press_time,
+						    &ev->time);
+
+			mce_log(LL_DEBUG, "[power] released; held %d ms",
+				held);
+
+			/* If the release was delayed past the long press
+			 * timeout, go by the kernel timestamps instead
+			 */
+			if ((powerkey_timeout_cb_id != 0) &&
+			    (held >= powerkey_press_delay)) {
+				cancel_powerkey_timeout();
+				handle_longpress();
+			} else if (powerkey_timeout_cb_id != 0) {
+				/* Short key press */
 				handle_shortpress();
 
 				if ((system_state == MCE_STATE_ACTDEAD) ||
@@ -0,0 +1,313 @@
+/**
+ * @file medianfilter.c
+ * Equivalence test and microbenchmark for the median filter
+ * <p>
+ * Feeds the same random sequences to the median filter and to
+ * a reference copy of the original insertion sort implementation,
+ * and fails on the first result that differs; then times both
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <stdio.h>			/* printf(), fprintf() */
+#include <stdlib.h>			/* exit(), EXIT_SUCCESS, EXIT_FAILURE */
+#include <string.h>			/* memset(), strcmp() */
+#include <time.h>			/* clock_gettime(), CLOCK_MONOTONIC */
+
+#include "median_filter.h"
+
+/** Largest window size tested exhaustively */
+#define MAX_WINDOW_SIZE			33
+
+/** Largest window size supported by the reference */
+#define MAX_REFERENCE_WINDOW_SIZE	257
+
+/** Number of samples per equivalence test sequence */
+#define TEST_SAMPLES			20000
+
+/** Number of samples per benchmark run */
+#define BENCH_SAMPLES			2000000
+
+/** Reference median filter; the original implementation */
+typedef struct {
+	gsize window_size;		/**< Window size */
+	gsize samples;			/**< Current number of samples */
+	gsize oldest;			/**< Index of the oldest sample */
+	gint window[MAX_REFERENCE_WINDOW_SIZE];	/**< Ring buffer */
+	/** Ordered buffer */
+	gint ordered_window[MAX_REFERENCE_WINDOW_SIZE];
+} reference_filter_t;
+
+/**
+ * Initialise a reference filter
+ *
+ * @param filter The filter to initialise
+ * @param window_size The window size to use
+ */
+static void reference_init(reference_filter_t *filter, gsize window_size)
+{
+	memset(filter, 0, sizeof (*filter));
+	filter->window_size = window_size;
+}
+
+/**
+ * Insert a sample into the ordered buffer of a reference filter;
+ * the original insertion sort, unchanged
+ *
+ * @param filter The filter
+ * @param value The value to insert
+ * @param oldest The oldest value
+ * @return The filtered value
+ */
+static gint reference_insert(reference_filter_t *filter,
+			     gint value, gint oldest)
+{
+	guint i;
+
+	if (filter->samples < filter->window_size) {
+		for (i = 0; i < filter->samples; i++) {
+			if (filter->ordered_window[i] >= value) {
+				for ( ; i < filter->samples; ++i) {
+					gint tmp;
+
+					tmp = filter->ordered_window[i];
+					filter->ordered_window[i] = value;
+					value = tmp;
+				}
+
+				break;
+			}
+		}
+
+		filter->ordered_window[i] = value;
+		filter->samples++;
+
+		goto EXIT;
+	} else {
+		if (value == oldest)
+			goto EXIT;
+
+		for (i = 0; i < filter->window_size; i++) {
+			if (filter->ordered_window[i] >= value) {
+				for ( ; i < filter->window_size; i++) {
+					int tmp = filter->ordered_window[i];
+
+					filter->ordered_window[i] = value;
+					value = tmp;
+
+					if (value == oldest)
+						goto EXIT;
+				}
+
+				goto EXIT;
+			} else if (filter->ordered_window[i] == oldest) {
+				for ( ; i < filter->window_size - 1; i++) {
+					if (filter->ordered_window[i + 1] >= value)
+						break;
+
+					filter->ordered_window[i] = filter->ordered_window[i + 1];
+				}
+
+				filter->ordered_window[i] = value;
+				goto EXIT;
+			}
+		}
+	}
+
+EXIT:
+	return (filter->ordered_window[(filter->samples - 1) / 2] +
+		filter->ordered_window[filter->samples / 2]) / 2;
+}
+
+/**
+ * Insert a sample into a reference filter
+ *
+ * @param filter The filter
+ * @param value The value to insert
+ * @return The filtered value
+ */
+static gint reference_map(reference_filter_t *filter, gint value)
+{
+	gint filtered_value;
+
+	filtered_value = reference_insert(filter, value,
+					  filter->window[filter->oldest]);
+	filter->window[filter->oldest] = value;
+	filter->oldest = (filter->oldest + 1) % filter->window_size;
+
+	return filtered_value;
+}
+
+/**
+ * Get the monotonic time
+ *
+ * @return The time in nanoseconds
+ */
+static gint64 get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((gint64)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/**
+ * Compare the median filter with the reference for one window size
+ *
+ * @param window_size The window size
+ * @param range Samples are drawn from [0, range);
+ *              small ranges give lots of duplicates
+ * @return TRUE if the results are identical, FALSE otherwise
+ */
+static gboolean test_equivalence(gsize window_size, gint range)
+{
+	median_filter_struct filter = { 0 };
+	reference_filter_t reference;
+	gboolean status = FALSE;
+	gint i;
+
+	reference_init(&reference, window_size);
+
+	if (median_filter_init(&filter, window_size) == FALSE) {
+		fprintf(stderr, "median_filter_init(%u) failed\n",
+			(guint)window_size);
+		goto EXIT;
+	}
+
+	for (i = 0; i < TEST_SAMPLES; i++) {
+		gint value = g_random_int_range(0, range);
+		gint expected = reference_map(&reference, value);
+		gint result = median_filter_map(&filter, value);
+
+		if (result != expected) {
+			fprintf(stderr,
+				"window %u, range %d, sample %d: "
+				"got %d, expected %d\n",
+				(guint)window_size, range, i,
+				result, expected);
+			goto EXIT;
+		}
+
+		/* Re-initialise now and then, like the ALS filter does */
+		if (g_random_int_range(0, 1000) == 0) {
+			reference_init(&reference, window_size);
+			(void)median_filter_init(&filter, window_size);
+		}
+	}
+
+	status = TRUE;
+
+EXIT:
+	median_filter_free(&filter);
+
+	return status;
+}
+
+/**
+ * Time the median filter and the reference for one window size
+ *
+ * @param window_size The window size
+ * @param samples Random samples to feed, BENCH_SAMPLES of them
+ */
+static void benchmark(gsize window_size, const gint *samples)
+{
+	median_filter_struct filter = { 0 };
+	reference_filter_t reference;
+	volatile gint sink = 0;
+	gint64 start;
+	gint64 reference_time;
+	gint64 filter_time;
+	gint i;
+
+	reference_init(&reference, window_size);
+	(void)median_filter_init(&filter, window_size);
+
+	start = get_time_ns();
+
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		sink += reference_map(&reference, samples[i]);
+
+	reference_time = get_time_ns() - start;
+	start = get_time_ns();
+
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		sink += median_filter_map(&filter, samples[i]);
+
+	filter_time = get_time_ns() - start;
+
+	printf("window %2u: reference %6.1f ns, filter %6.1f ns per sample\n",
+	       (guint)window_size,
+	       (gdouble)reference_time / BENCH_SAMPLES,
+	       (gdouble)filter_time / BENCH_SAMPLES);
+
+	median_filter_free(&filter);
+}
+
+/**
+ * Main
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array with command line arguments
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char **argv)
+{
+	static const gint ranges[] = { 2, 16, 1000, G_MAXINT / 2 };
+	static const gsize large_sizes[] = { 129, MAX_REFERENCE_WINDOW_SIZE };
+	gboolean bench = ((argc > 1) && (strcmp(argv[1], "--bench") == 0));
+	gint *samples;
+	gsize size;
+	guint i;
+
+	for (size = 1; size <= MAX_WINDOW_SIZE; size++) {
+		for (i = 0; i < G_N_ELEMENTS(ranges); i++) {
+			if (test_equivalence(size, ranges[i]) == FALSE)
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	for (size = 0; size < G_N_ELEMENTS(large_sizes); size++) {
+		for (i = 0; i < G_N_ELEMENTS(ranges); i++) {
+			if (test_equivalence(large_sizes[size],
+					     ranges[i]) == FALSE)
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	printf("median filter: window sizes 1-%d, %u and %u "
+	       "match the reference\n",
+	       MAX_WINDOW_SIZE, (guint)large_sizes[0], (guint)large_sizes[1]);
+
+	if (bench == FALSE)
+		goto EXIT;
+
+	samples = g_new(gint, BENCH_SAMPLES);
+
+	for (i = 0; i < BENCH_SAMPLES; i++)
+		samples[i] = g_random_int_range(0, 1000);
+
+	for (size = 3; size <= MAX_WINDOW_SIZE; size += 2)
+		benchmark(size, samples);
+
+	for (size = 0; size < G_N_ELEMENTS(large_sizes); size++)
+		benchmark(large_sizes[size], samples);
+
+	g_free(samples);
+
+EXIT:
+	return EXIT_SUCCESS;
+}
@@ -38,6 +38,12 @@
 					 * mce_write_number_string_to_file()
 					 */
 #include "mce-log.h"			/* mce_log(), LL_* */
+#include "mce-timer.h"			/* mce_timer_add(),
+					 * mce_timer_add_seconds(),
+					 * mce_timer_add_aligned(),
+					 * mce_timer_remove(),
+					 * MCE_TIMER_DEFERRABLE
+					 */
 #include "datapipe.h"			/* execute_datapipe(),
 					 * datapipe_get_gint(),
 					 * append_input_trigger_to_datapipe(),
@@ -107,6 +113,9 @@ static guint tklock_unlock_timeout_cb_id = 0;
 /** Powerkey repeat emulation ID */
 static guint powerkey_repeat_emulation_cb_id = 0;
 
+/** ID for the touchscreen calibration settle timeout */
+static guint ts_settle_timeout_cb_id = 0;
+
 /** Powerkey repeats counter */
 static guint powerkey_repeat_count = 0;
 
@@ -226,9 +235,12 @@ typedef enum {
 	MCE_TS_ENABLED
 } ts_state_t;
 
-/** Touch screen state */
+/** Touch screen state, as last written to the hardware */
 static ts_state_t ts_state = MCE_TS_UNSET;
 
+/** Requested touch screen state */
+static ts_state_t ts_target = MCE_TS_UNSET;
+
 /** Double tap state type */
 typedef enum {
 	/** Double tap state unknown */
@@ -239,9 +251,12 @@ typedef enum {
 	MCE_DT_ENABLED
 } dt_state_t;
 
-/** Double tap state */
+/** Double tap state, as last written to the hardware */
 static dt_state_t dt_state = MCE_DT_UNSET;
 
+/** Requested double tap state */
+static dt_state_t dt_target = MCE_DT_UNSET;
+
 /* Valid triggers for autorelock */
 
 /** No autorelock triggers */
@@ -275,6 +290,7 @@ static gint autorelock_triggers = AUTORELOCK_NO_TRIGGERS;
 static void set_doubletap_gesture(gboolean enable);
 static void ts_enable(void);
 static void ts_disable(void);
+static void ts_apply_state(void);
 static void set_tklock_state(lock_state_t lock_state);
 static void autorelock_touchscreen_trigger(gconstpointer const data);
 static void cancel_tklock_dim_timeout(void);
@@ -405,7 +421,8 @@ static gboolean doubletap_recal_timeout_cb(gpointer data)
 	/* Otherwise use next delay */
 	doubletap_recal_index++;
 	doubletap_recal_timeout_id =
-	       	g_timeout_add_seconds(doubletap_recal_delays[doubletap_recal_index],
+	       	mce_timer_add_aligned(MCE_TIMER_DEFERRABLE,
+				      doubletap_recal_delays[doubletap_recal_index] * 1000,
 				      doubletap_recal_timeout_cb, NULL);
 
 	return FALSE;
@@ -417,7 +434,7 @@ static gboolean doubletap_recal_timeout_cb(gpointer data)
 static void cancel_doubletap_recal_timeout(void)
 {
 	if (doubletap_recal_timeout_id != 0)
-		g_source_remove(doubletap_recal_timeout_id);
+		mce_timer_remove(doubletap_recal_timeout_id);
 	doubletap_recal_timeout_id = 0;
 	doubletap_recal_on_heartbeat = FALSE;
 }
@@ -435,7 +452,8 @@ static void setup_doubletap_recal_timeout(void)
 	doubletap_recal_on_heartbeat = FALSE;
 
 	doubletap_recal_timeout_id =
-		g_timeout_add_seconds(doubletap_recal_delays[doubletap_recal_index],
+		mce_timer_add_aligned(MCE_TIMER_DEFERRABLE,
+				      doubletap_recal_delays[doubletap_recal_index] * 1000,
 				      doubletap_recal_timeout_cb, NULL);
 
 }
@@ -521,7 +539,7 @@ EXIT:
 static void cancel_pocket_mode_timeout(void)
 {
 	if (pocket_mode_proximity_timeout_cb_id != 0) {
-		g_source_remove(pocket_mode_proximity_timeout_cb_id);
+		mce_timer_remove(pocket_mode_proximity_timeout_cb_id);
 		pocket_mode_proximity_timeout_cb_id = 0;
 	}
 }
@@ -583,7 +601,7 @@ static void setup_pocket_mode_timeout(void)
 		return;
 
 	pocket_mode_proximity_timeout_cb_id =
-		g_timeout_add_seconds(DEFAULT_POCKET_MODE_PROXIMITY_TIMEOUT,
+		mce_timer_add_seconds(DEFAULT_POCKET_MODE_PROXIMITY_TIMEOUT,
 				      pocket_mode_timeout_cb, NULL);
 }
 
@@ -594,7 +612,7 @@ static void cancel_doubletap_proximity_timeout(void)
 {
 	/* Remove the timer source for doubletap gesture proximity */
 	if (doubletap_proximity_timeout_cb_id != 0) {
-		g_source_remove(doubletap_proximity_timeout_cb_id);
+		mce_timer_remove(doubletap_proximity_timeout_cb_id);
 		doubletap_proximity_timeout_cb_id = 0;
 	}
 }
@@ -619,7 +637,7 @@ static void setup_doubletap_proximity_timeout(void)
 		timeout = 0;
 
 	doubletap_proximity_timeout_cb_id =
-		g_timeout_add_seconds(timeout,
+		mce_timer_add_seconds(timeout,
 				      doubletap_proximity_timeout_cb, NULL);
 
 EXIT:
@@ -680,19 +698,8 @@ static void set_doubletap_gesture(gboolean enable)
 		cancel_doubletap_proximity_timeout();
 	}
 
-	if (enable && dt_state != MCE_DT_ENABLED) {
-		(void)mce_write_string_to_file(mce_touchscreen_gesture_control_path, "4");
-		setup_doubletap_recal_timeout();
-		dt_state = MCE_DT_ENABLED;
-	} else if (!enable && dt_state != MCE_DT_DISABLED) {
-		(void)mce_write_string_to_file(mce_touchscreen_gesture_control_path, "0");
-		cancel_doubletap_recal_timeout();
-		/* Disabling the double tap gesture causes recalibration */
-		if (ts_state == MCE_TS_ENABLED) {
-			g_usleep(MCE_TOUCHSCREEN_CALIBRATION_DELAY);
-		}
-		dt_state = MCE_DT_DISABLED;
-	}
+	dt_target = (enable == TRUE) ? MCE_DT_ENABLED : MCE_DT_DISABLED;
+	ts_apply_state();
 
 	/* Finally, ensure that touchscreen interrupts are enabled
 	 * if doubletap gestures are enabled
@@ -735,16 +742,104 @@ EXIT:
 }
 
 /**
- * Enable touchscreen interrupts (events will be generated by kernel)
+ * Cancel the touchscreen calibration settle timeout
  */
-static void ts_enable(void)
+static void cancel_ts_settle_timeout(void)
+{
+	if (ts_settle_timeout_cb_id != 0) {
+		mce_timer_remove(ts_settle_timeout_cb_id);
+		ts_settle_timeout_cb_id = 0;
+	}
+}
+
+/**
+ * Timeout callback for the touchscreen calibration settle timeout
+ *
+ * @param data Unused
+ * @return Always returns FALSE, to disable the timeout
+ */
+static gboolean ts_settle_timeout_cb(gpointer data)
+{
+	(void)data;
+
+	ts_settle_timeout_cb_id = 0;
+
+	/* Continue with whatever was requested meanwhile */
+	ts_apply_state();
+
+	return FALSE;
+}
+
+/**
+ * Setup the touchscreen calibration settle timeout
+ */
+static void setup_ts_settle_timeout(void)
 {
-	if (ts_state != MCE_TS_ENABLED) {
+	cancel_ts_settle_timeout();
+
+	ts_settle_timeout_cb_id =
+		mce_timer_add(MCE_TOUCHSCREEN_CALIBRATION_DELAY,
+			      ts_settle_timeout_cb, NULL);
+}
+
+/**
+ * Bring the touchscreen and double tap hardware state
+ * towards the requested state
+ *
+ * The touchscreen recalibrates when its interrupts are enabled,
+ * and when the double tap gesture is disabled with the interrupts
+ * enabled; no further changes are written until it has settled.
+ * Requests made meanwhile only update the requested state,
+ * so the latest one wins once the settle timeout has passed
+ */
+static void ts_apply_state(void)
+{
+	/* Calibrating; the settle timeout will call us again */
+	if (ts_settle_timeout_cb_id != 0)
+		goto EXIT;
+
+	/* Disable interrupts first, to avoid needless recalibration */
+	if ((ts_target == MCE_TS_DISABLED) && (ts_state != MCE_TS_DISABLED)) {
+		generic_event_control(mce_touchscreen_sysfs_disable_path,
+				      FALSE);
+		ts_state = MCE_TS_DISABLED;
+	}
+
+	if ((dt_target == MCE_DT_ENABLED) && (dt_state != MCE_DT_ENABLED)) {
+		(void)mce_write_string_to_file(mce_touchscreen_gesture_control_path, "4");
+		setup_doubletap_recal_timeout();
+		dt_state = MCE_DT_ENABLED;
+	} else if ((dt_target == MCE_DT_DISABLED) &&
+		   (dt_state != MCE_DT_DISABLED)) {
+		(void)mce_write_string_to_file(mce_touchscreen_gesture_control_path, "0");
+		cancel_doubletap_recal_timeout();
+		dt_state = MCE_DT_DISABLED;
+
+		/* Disabling the double tap gesture causes recalibration */
+		if (ts_state == MCE_TS_ENABLED) {
+			setup_ts_settle_timeout();
+			goto EXIT;
+		}
+	}
+
+	if ((ts_target == MCE_TS_ENABLED) && (ts_state != MCE_TS_ENABLED)) {
 		generic_event_control(mce_touchscreen_sysfs_disable_path,
 				      TRUE);
-		g_usleep(MCE_TOUCHSCREEN_CALIBRATION_DELAY);
 		ts_state = MCE_TS_ENABLED;
+		setup_ts_settle_timeout();
 	}
+
+EXIT:
+	return;
+}
+
+/**
+ * Enable touchscreen interrupts (events will be generated by kernel)
+ */
+static void ts_enable(void)
+{
+	ts_target = MCE_TS_ENABLED;
+	ts_apply_state();
 }
 
 /**
@@ -752,11 +847,8 @@ static void ts_enable(void)
  */
 static void ts_disable(void)
 {
-	if (ts_state != MCE_TS_DISABLED) {
-		generic_event_control(mce_touchscreen_sysfs_disable_path,
-				      FALSE);
-		ts_state = MCE_TS_DISABLED;
-	}
+	ts_target = MCE_TS_DISABLED;
+	ts_apply_state();
 }
 
 /**
@@ -1285,7 +1377,7 @@ static void cancel_tklock_visual_blank_timeout(void)
 {
 	/* Remove the timer source for visual tklock blanking */
 	if (tklock_visual_blank_timeout_cb_id != 0) {
-		g_source_remove(tklock_visual_blank_timeout_cb_id);
+		mce_timer_remove(tklock_visual_blank_timeout_cb_id);
 		tklock_visual_blank_timeout_cb_id = 0;
 	}
 }
@@ -1334,7 +1426,7 @@ static void setup_tklock_visual_blank_timeout(void)
 
 	/* Setup blank timeout */
 	tklock_visual_blank_timeout_cb_id =
-		g_timeout_add_seconds(DEFAULT_VISUAL_BLANK_DELAY, tklock_visual_blank_timeout_cb, NULL);
+		mce_timer_add_seconds(DEFAULT_VISUAL_BLANK_DELAY, tklock_visual_blank_timeout_cb, NULL);
 
 EXIT:
 	return;
@@ -1374,7 +1466,7 @@ static void cancel_tklock_dim_timeout(void)
 {
 	/* Remove the timer source for tklock dimming */
 	if (tklock_dim_timeout_cb_id != 0) {
-		g_source_remove(tklock_dim_timeout_cb_id);
+		mce_timer_remove(tklock_dim_timeout_cb_id);
 		tklock_dim_timeout_cb_id = 0;
 	}
 }
@@ -1388,7 +1480,7 @@ static void setup_tklock_dim_timeout(void)
 
 	/* Setup new timeout */
 	tklock_dim_timeout_cb_id =
-		g_timeout_add_seconds(dim_delay, tklock_dim_timeout_cb, NULL);
+		mce_timer_add_seconds(dim_delay, tklock_dim_timeout_cb, NULL);
 }
 
 /**
@@ -1591,7 +1683,7 @@ static void cancel_tklock_unlock_timeout(void)
 {
 	/* Remove the timer source for delayed tklock unlocking */
 	if (tklock_unlock_timeout_cb_id != 0) {
-		g_source_remove(tklock_unlock_timeout_cb_id);
+		mce_timer_remove(tklock_unlock_timeout_cb_id);
 		tklock_unlock_timeout_cb_id = 0;
 	}
 }
@@ -1605,7 +1697,7 @@ static void setup_tklock_unlock_timeout(void)
 
 	/* Setup new timeout */
 	tklock_unlock_timeout_cb_id =
-		g_timeout_add(MCE_TKLOCK_UNLOCK_DELAY,
+		mce_timer_add(MCE_TKLOCK_UNLOCK_DELAY,
 			      tklock_unlock_timeout_cb, NULL);
 }
 
@@ -1636,7 +1728,7 @@ static void cancel_powerkey_repeat_emulation_timeout(void)
 {
 	/* Remove the timer source for powerkey pressed emulation */
 	if (powerkey_repeat_emulation_cb_id != 0) {
-		g_source_remove(powerkey_repeat_emulation_cb_id);
+		mce_timer_remove(powerkey_repeat_emulation_cb_id);
 		powerkey_repeat_emulation_cb_id = 0;
 	}
 }
@@ -1651,7 +1743,7 @@ static void setup_powerkey_repeat_emulation_timeout(void)
 
     /* Setup powerkey repeat emulation timeout */
     powerkey_repeat_emulation_cb_id =
-	g_timeout_add_seconds(DEFAULT_POWERKEY_REPEAT_DELAY, powerkey_repeat_emulation_cb, NULL);
+	mce_timer_add_seconds(DEFAULT_POWERKEY_REPEAT_DELAY, powerkey_repeat_emulation_cb, NULL);
 }
 
 /**
@@ -2893,6 +2985,16 @@ static void submode_trigger(gconstpointer data)
 		}
 	}
 
+	/* If the event eater was ended by the input grab
+	 * rather than by us, close the event eater UI
+	 */
+	if (((submode & MCE_EVEATER_SUBMODE) == 0) &&
+	    ((old_submode & MCE_EVEATER_SUBMODE) != 0) &&
+	    ((submode & MCE_TKLOCK_SUBMODE) == 0) &&
+	    (tklock_ui_state == MCE_TKLOCK_UI_EVENT_EATER)) {
+		(void)close_tklock_ui();
+	}
+
 	old_submode = submode;
 }
 
@@ -3374,6 +3476,7 @@ void mce_tklock_exit(void)
 	cancel_tklock_unlock_timeout();
 	cancel_tklock_dim_timeout();
 	cancel_doubletap_recal_timeout();
+	cancel_ts_settle_timeout();
 
 	return;
 }
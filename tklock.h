@@ -73,8 +73,8 @@
 #define MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH		    "/sys/devices/platform/omap2_mcspi.1/spi1.0/disable_ts"
 #define MCE_RX44_TOUCHSCREEN_SYSFS_DISABLE_PATH_KERNEL2637	"/sys/devices/platform/omap2_mcspi.1/spi1.0/disable"
 
-/** Touch screen enable delay for calibration **/
-#define MCE_TOUCHSCREEN_CALIBRATION_DELAY		100000 /* 100 milliseconds */
+/** Touch screen enable delay for calibration, in milliseconds **/
+#define MCE_TOUCHSCREEN_CALIBRATION_DELAY		100
 
 /** Default fallback setting for the touchscreen/keypad autolock */
 #define DEFAULT_TK_AUTOLOCK		FALSE		/* FALSE / TRUE */
@@ -0,0 +1,1389 @@
+/**
+ * @file alstune.c
+ * Tool to evaluate ALS profiles and smoothing chains against
+ * recorded lux traces, without a device
+ * <p>
+ * The trace is passed through the same smoothing chain and
+ * profile lookup as the ALS filter uses; the result is
+ * a brightness timeline, the number of brightness transitions
+ * and an estimate of the wakeups caused by the sensor
+ * <p>
+ * The poll schedules of polled sensors are replayed as well;
+ * the adaptive schedule of the ALS filter is compared with
+ * a fixed poll interval, by the number of polls and by how far
+ * the brightness they result in strays from the brightness
+ * of a sensor that is read at every sample
+ * <p>
+ * Copyright © 2012 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * mce is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * mce is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mce.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <glib.h>
+
+#include <errno.h>			/* errno */
+#include <stdio.h>			/* fprintf(), fopen(), fgets(),
+					 * fread(), fclose(), FILE
+					 */
+#include <getopt.h>			/* getopt_long(),
+					 * struct option
+					 */
+#include <stdlib.h>			/* strtol(), EXIT_SUCCESS,
+					 * EXIT_FAILURE
+					 */
+#include <string.h>			/* strcmp(), memcpy() */
+
+#include "mce.h"			/* MCE_INVALID_TRANSLATION */
+#include "mce-lib.h"			/* mce_translate_string_to_int(),
+					 * mce_translate_int_to_string(),
+					 * mce_translation_t
+					 */
+#include "als_filter.h"			/* als_profile_compile(),
+					 * als_profile_lookup(),
+					 * als_filter_chain_setup(),
+					 * als_filter_chain_append(),
+					 * als_filter_chain_reset(),
+					 * als_filter_chain_map(),
+					 * als_filter_chain_free(),
+					 * als_poll_set_range(),
+					 * als_poll_reset(),
+					 * als_poll_adapt(),
+					 * als_filter_chain_t,
+					 * als_filter_params_t,
+					 * als_level_table_t,
+					 * als_poll_t,
+					 * als_profile_struct,
+					 * ALS_FILTER_*, ALS_RANGES
+					 */
+
+/** Leave out the colour phase matrices; only the ALS profiles are used */
+#define ALS_PROFILES_ONLY
+#include "modules/filter-brightness-als.h"
+					/* *_als_profiles_*,
+					 * ALS_PROFILE_*,
+					 * ALS_DISPLAY_ON_POLL_MIN,
+					 * ALS_DISPLAY_ON_POLL_MAX,
+					 * DEFAULT_ALS_*
+					 */
+
+/** Name shown by --help etc. */
+#define PRG_NAME			"alstune"
+
+/**
+ * Number of samples processed at a time; the samples of a block
+ * are passed through the smoothing chain in one go, after which
+ * each profile scans the whole block
+ */
+#define ALSTUNE_BLOCK_SIZE		4096
+
+/** Number of ALS profiles */
+#define ALSTUNE_PROFILES		(ALS_PROFILE_MAXIMUM + 1)
+
+/** Maximum length of a line in CSV traces */
+#define ALSTUNE_LINE_MAX		256
+
+/** Default sample interval of traces without timestamps */
+#define ALSTUNE_SAMPLE_INTERVAL		500		/* Milliseconds */
+
+/**
+ * Default interval of the fixed poll schedule;
+ * the display on poll interval before the interval adapted
+ */
+#define ALSTUNE_FIXED_POLL_INTERVAL	1500		/* Milliseconds */
+
+/** Trace formats */
+typedef enum {
+	/** Invalid format */
+	TRACE_FORMAT_INVALID = MCE_INVALID_TRANSLATION,
+	/** One "time_ms,lux" or "lux" sample per line */
+	TRACE_FORMAT_CSV = 0,
+	/** alstune_record_t records in host byte order */
+	TRACE_FORMAT_BINARY = 1
+} trace_format_t;
+
+/** Sample in binary traces */
+typedef struct {
+	/** Timestamp, in milliseconds */
+	guint32 time_ms;
+	/** Ambient light, in lux */
+	gint32 lux;
+} __attribute__((packed)) alstune_record_t;
+
+/** Outputs that the ALS adjusts */
+typedef enum {
+	/** The display backlight */
+	ALSTUNE_OUTPUT_DISPLAY = 0,
+	/** The LED */
+	ALSTUNE_OUTPUT_LED = 1,
+	/** The keyboard backlight */
+	ALSTUNE_OUTPUT_KBD = 2,
+	/** Number of outputs */
+	ALSTUNE_OUTPUTS
+} alstune_output_t;
+
+/** Replayed poll schedules */
+typedef enum {
+	/** Fixed poll interval */
+	ALSTUNE_SCHEDULE_FIXED = 0,
+	/** Poll interval that adapts to the variance of the readings */
+	ALSTUNE_SCHEDULE_ADAPTIVE = 1,
+	/** Number of schedules */
+	ALSTUNE_SCHEDULES
+} alstune_schedule_id_t;
+
+/** Built-in ALS profiles of a device */
+typedef struct {
+	/** Name of the device */
+	const gchar *name;
+	/** Profiles for each output; NULL if the output isn't adjusted */
+	const als_profile_struct *profiles[ALSTUNE_OUTPUTS];
+} alstune_device_t;
+
+/** Evaluation state of a single profile */
+typedef struct {
+	/** Is the profile evaluated? */
+	gboolean enabled;
+	/** The compiled profile */
+	als_level_table_t table;
+	/** Current level; -1 before the first sample */
+	gint level;
+	/** Lower end of the current threshold window */
+	gint lower;
+	/** Upper end of the current threshold window */
+	gint upper;
+	/** Current brightness + possible HBM boost (boost level * 256) */
+	gint value;
+	/** Number of brightness transitions */
+	guint64 transitions;
+	/** Number of samples outside the threshold window */
+	guint64 wakeups;
+	/** Sum of the brightness over all samples */
+	guint64 brightness_sum;
+} alstune_profile_t;
+
+/**
+ * Replay state of a poll schedule
+ *
+ * The trace is only read at the polls; between the polls,
+ * the brightness of each profile stays what the last poll gave
+ */
+typedef struct {
+	/** The poll schedule */
+	als_poll_t poll;
+	/** Smoothing chain of the polled readings */
+	als_filter_chain_t chain;
+	/** Has the first poll been made? */
+	gboolean started;
+	/** Time of the next poll, in milliseconds */
+	guint64 next_poll;
+	/** Number of polls */
+	guint64 polls;
+	/** Current level of each profile */
+	gint level[ALSTUNE_PROFILES];
+	/** Lower end of the threshold window of each profile */
+	gint lower[ALSTUNE_PROFILES];
+	/** Upper end of the threshold window of each profile */
+	gint upper[ALSTUNE_PROFILES];
+	/** Current brightness + possible HBM boost of each profile */
+	gint value[ALSTUNE_PROFILES];
+	/** Sum of the brightness error of each profile over all samples */
+	guint64 error_sum[ALSTUNE_PROFILES];
+	/** Number of samples with the wrong brightness, per profile */
+	guint64 off_target[ALSTUNE_PROFILES];
+} alstune_schedule_t;
+
+/** Devices with built-in profiles */
+static const alstune_device_t alstune_devices[] = {
+	{
+		.name = "rm696",
+		.profiles = {
+			display_als_profiles_rm696,
+			led_als_profiles_rm696,
+			NULL
+		}
+	}, {
+		.name = "rm680",
+		.profiles = {
+			display_als_profiles_rm680,
+			led_als_profiles_rm680,
+			kbd_als_profiles_rm680
+		}
+	}, {
+		.name = "rx51",
+		.profiles = {
+			display_als_profiles_rx51,
+			led_als_profiles_rx51,
+			kbd_als_profiles_rx51
+		}
+	}, {
+		.name = "rx44",
+		.profiles = {
+			display_als_profiles_rx44,
+			led_als_profiles_rx44,
+			kbd_als_profiles_rx44
+		}
+	}, {
+		.name = NULL,
+	}
+};
+
+/** Mapping of output names */
+static const mce_translation_t output_translation[] = {
+	{
+		.number = ALSTUNE_OUTPUT_DISPLAY,
+		.string = "display",
+	}, {
+		.number = ALSTUNE_OUTPUT_LED,
+		.string = "led",
+	}, {
+		.number = ALSTUNE_OUTPUT_KBD,
+		.string = "kbd",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** Mapping of profile names; also used as key file group names */
+static const mce_translation_t profile_translation[] = {
+	{
+		.number = ALS_PROFILE_MINIMUM,
+		.string = "minimum",
+	}, {
+		.number = ALS_PROFILE_ECONOMY,
+		.string = "economy",
+	}, {
+		.number = ALS_PROFILE_NORMAL,
+		.string = "normal",
+	}, {
+		.number = ALS_PROFILE_BRIGHT,
+		.string = "bright",
+	}, {
+		.number = ALS_PROFILE_MAXIMUM,
+		.string = "maximum",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** Mapping of smoothing stage names; same as in mce.ini */
+static const mce_translation_t filter_type_translation[] = {
+	{
+		.number = ALS_FILTER_MEDIAN,
+		.string = "median",
+	}, {
+		.number = ALS_FILTER_EWMA,
+		.string = "ewma",
+	}, {
+		.number = ALS_FILTER_HYSTERESIS,
+		.string = "hysteresis",
+	}, {
+		.number = ALS_FILTER_SPIKE,
+		.string = "spike",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** Mapping of poll schedule names */
+static const mce_translation_t schedule_translation[] = {
+	{
+		.number = ALSTUNE_SCHEDULE_FIXED,
+		.string = "fixed",
+	}, {
+		.number = ALSTUNE_SCHEDULE_ADAPTIVE,
+		.string = "adaptive",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** Mapping of trace format names */
+static const mce_translation_t format_translation[] = {
+	{
+		.number = TRACE_FORMAT_CSV,
+		.string = "csv",
+	}, {
+		.number = TRACE_FORMAT_BINARY,
+		.string = "binary",
+	}, { /* MCE_INVALID_TRANSLATION marks the end of this array */
+		.number = MCE_INVALID_TRANSLATION,
+		.string = NULL
+	}
+};
+
+/** The name of the program */
+static const gchar *progname;
+
+/** The smoothing chain */
+static als_filter_chain_t alstune_chain;
+
+/** The profiles being evaluated */
+static alstune_profile_t alstune_profiles[ALSTUNE_PROFILES];
+
+/** Profiles loaded from a file; NULL for the built-in ones */
+static als_profile_struct *file_profiles[ALSTUNE_PROFILES];
+
+/** The replayed poll schedules */
+static alstune_schedule_t alstune_schedules[ALSTUNE_SCHEDULES];
+
+/** Timestamps of the current block */
+static guint32 block_time[ALSTUNE_BLOCK_SIZE];
+/** Raw lux values of the current block */
+static gint block_raw[ALSTUNE_BLOCK_SIZE];
+/** Smoothed lux values of the current block */
+static gint block_lux[ALSTUNE_BLOCK_SIZE];
+/**
+ * Brightness + possible HBM boost of each profile for each sample
+ * of the current block, when the sensor is read at every sample
+ */
+static gint block_value[ALSTUNE_PROFILES][ALSTUNE_BLOCK_SIZE];
+/** Records of the current block of a binary trace */
+static alstune_record_t block_records[ALSTUNE_BLOCK_SIZE];
+
+/**
+ * Display usage information
+ */
+static void usage(void)
+{
+	fprintf(stdout,
+		"Usage: %s [OPTION]... [TRACE]\n"
+		"Evaluate ALS profiles against a recorded lux trace\n"
+		"\n"
+		"TRACE is read from stdin if not given or `-'; "
+		"CSV traces have\n"
+		"one `time_ms,lux' or `lux' sample per line, "
+		"binary traces consist of\n"
+		"records of a 32-bit unsigned time_ms "
+		"and a 32-bit signed lux value\n"
+		"in host byte order\n"
+		"\n"
+		"  -d, --device=DEVICE            use the built-in "
+		"profiles of DEVICE;\n"
+		"                                   valid devices are: "
+		"rm696 (default),\n"
+		"                                   rm680, rx51, rx44\n"
+		"  -o, --output=OUTPUT            evaluate the profiles "
+		"for OUTPUT;\n"
+		"                                   valid outputs are: "
+		"display (default),\n"
+		"                                   led, kbd\n"
+		"  -P, --profiles=FILE            replace the built-in "
+		"profiles with the\n"
+		"                                   groups in the key "
+		"file FILE; each group\n"
+		"                                   is named after a "
+		"profile and has a\n"
+		"                                   `Ranges' list of "
+		"lower, upper pairs\n"
+		"                                   and a `Values' list "
+		"with one more entry\n"
+		"  -p, --profile=PROFILE          only evaluate "
+		"PROFILE;\n"
+		"                                   valid profiles are: "
+		"minimum, economy,\n"
+		"                                   normal, bright, "
+		"maximum\n"
+		"  -c, --chain=STAGES             smoothing chain; "
+		"a `;'-separated list\n"
+		"                                   of median, ewma, "
+		"hysteresis, spike;\n"
+		"                                   empty by default\n"
+		"      --median-window=SIZE       window size of "
+		"median stages\n"
+		"      --ewma-weight=PERCENT      weight of new readings "
+		"in ewma stages\n"
+		"      --hysteresis-band=PERCENT  width of hysteresis "
+		"bands\n"
+		"      --hysteresis-min=LUX       minimum width of "
+		"hysteresis bands\n"
+		"      --spike-ratio=PERCENT      ratio between readings "
+		"that is a spike\n"
+		"      --spike-min=LUX            changes that are "
+		"never spikes\n"
+		"      --spike-hold=COUNT         spikes in a row "
+		"to reject\n"
+		"  -m, --threshold-max=LUX        upper threshold of "
+		"the topmost level;\n"
+		"                                   unlimited by "
+		"default\n"
+		"  -i, --interval=MS              sample interval "
+		"of traces without\n"
+		"                                   timestamps "
+		"(default %d)\n"
+		"      --poll=MIN;MAX             range of the "
+		"adaptive poll interval\n"
+		"                                   (default %d;%d)\n"
+		"      --poll-fixed=MS            interval of the "
+		"fixed poll schedule\n"
+		"                                   the adaptive one "
+		"is compared with\n"
+		"                                   (default %d)\n"
+		"  -f, --format=FORMAT            trace format; "
+		"csv (default) or binary\n"
+		"  -t, --timeline=FILE            write the brightness "
+		"transitions to FILE\n"
+		"                                   as `time_ms,profile,"
+		"lux,brightness,hbm'\n"
+		"  -h, --help                     display this help "
+		"and exit\n"
+		"\n"
+		"Report bugs to <david.weinehall@nokia.com>\n",
+		progname, ALSTUNE_SAMPLE_INTERVAL,
+		ALS_DISPLAY_ON_POLL_MIN, ALS_DISPLAY_ON_POLL_MAX,
+		ALSTUNE_FIXED_POLL_INTERVAL);
+}
+
+/**
+ * Report an invalid option argument
+ *
+ * @param option The name of the option
+ * @param string The argument
+ */
+static void invalid_argument(const gchar *const option,
+			     const gchar *const string)
+{
+	fprintf(stderr,
+		"%s: invalid argument `%s' for `--%s'\n",
+		progname, string, option);
+}
+
+/**
+ * Parse an integer option argument
+ *
+ * @param option The name of the option
+ * @param string The argument
+ * @param[out] value The value
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean parse_int(const gchar *const option,
+			  const gchar *const string, gint *value)
+{
+	gboolean status = FALSE;
+	gchar *end = NULL;
+	glong tmp;
+
+	errno = 0;
+	tmp = strtol(string, &end, 10);
+
+	if ((errno != 0) || (end == string) || (*end != '\0') ||
+	    (tmp < G_MININT) || (tmp > G_MAXINT)) {
+		invalid_argument(option, string);
+		goto EXIT;
+	}
+
+	*value = (gint)tmp;
+	status = TRUE;
+
+EXIT:
+	return status;
+}
+
+/**
+ * Parse a `min;max' option argument
+ *
+ * @param option The name of the option
+ * @param string The argument
+ * @param[out] min The first value
+ * @param[out] max The second value
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean parse_range(const gchar *const option,
+			    const gchar *const string, gint *min, gint *max)
+{
+	gboolean status = FALSE;
+	gchar **values = g_strsplit(string, ";", 0);
+
+	if ((values[0] == NULL) || (values[1] == NULL) ||
+	    (values[2] != NULL)) {
+		invalid_argument(option, string);
+		goto EXIT;
+	}
+
+	if ((parse_int(option, g_strstrip(values[0]), min) == FALSE) ||
+	    (parse_int(option, g_strstrip(values[1]), max) == FALSE))
+		goto EXIT;
+
+	if ((*min <= 0) || (*max < *min)) {
+		invalid_argument(option, string);
+		goto EXIT;
+	}
+
+	status = TRUE;
+
+EXIT:
+	g_strfreev(values);
+
+	return status;
+}
+
+/**
+ * Parse a smoothing chain
+ *
+ * @param chain The chain to append the stages to
+ * @param string The `;'-separated list of stages
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean parse_chain(als_filter_chain_t *chain,
+			    const gchar *const string)
+{
+	gboolean status = FALSE;
+	gchar **names = g_strsplit(string, ";", 0);
+	guint i;
+
+	for (i = 0; names[i] != NULL; i++) {
+		gint type;
+
+		if (*g_strstrip(names[i]) == '\0')
+			continue;
+
+		type = mce_translate_string_to_int(filter_type_translation,
+						   names[i]);
+
+		if (type == ALS_FILTER_INVALID) {
+			fprintf(stderr,
+				"%s: unknown smoothing stage `%s'\n",
+				progname, names[i]);
+			goto EXIT;
+		}
+
+		if (als_filter_chain_append(chain, type) == FALSE) {
+			fprintf(stderr,
+				"%s: too many smoothing stages; "
+				"at most %d are supported\n",
+				progname, ALS_FILTER_MAX_STAGES);
+			goto EXIT;
+		}
+	}
+
+	status = TRUE;
+
+EXIT:
+	g_strfreev(names);
+
+	return status;
+}
+
+/**
+ * Load profiles from a key file
+ *
+ * @param file The key file
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean load_profiles(const gchar *const file)
+{
+	GKeyFile *keyfile = g_key_file_new();
+	GError *error = NULL;
+	gboolean status = FALSE;
+	gint *ranges = NULL;
+	gint *values = NULL;
+	gint profile;
+
+	if (g_key_file_load_from_file(keyfile, file,
+				      G_KEY_FILE_NONE, &error) == FALSE) {
+		fprintf(stderr, "%s: cannot load `%s'; %s\n",
+			progname, file, error->message);
+		goto EXIT;
+	}
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		const gchar *group =
+			mce_translate_int_to_string(profile_translation,
+						    profile);
+		als_profile_struct *tmp;
+		gsize nranges = 0;
+		gsize nvalues = 0;
+
+		if (g_key_file_has_group(keyfile, group) == FALSE)
+			continue;
+
+		ranges = g_key_file_get_integer_list(keyfile, group, "Ranges",
+						     &nranges, &error);
+
+		if (ranges != NULL)
+			values = g_key_file_get_integer_list(keyfile, group,
+							     "Values",
+							     &nvalues, &error);
+
+		if (values == NULL) {
+			fprintf(stderr, "%s: `%s' [%s]: %s\n",
+				progname, file, group, error->message);
+			goto EXIT;
+		}
+
+		/* Leave room for the terminating { -1, -1 } */
+		if (((nranges % 2) != 0) || ((nranges / 2) >= ALS_RANGES) ||
+		    (nvalues != (nranges / 2) + 1)) {
+			fprintf(stderr,
+				"%s: `%s' [%s]: expected up to %d "
+				"lower, upper pairs and one more value\n",
+				progname, file, group, ALS_RANGES - 1);
+			goto EXIT;
+		}
+
+		/* The members are const, since the built-in
+		 * profiles are; fill in the allocated copy in one go
+		 */
+		tmp = g_malloc0(sizeof (*tmp));
+		memcpy((gint *)tmp->range, ranges, nranges * sizeof (gint));
+		((gint *)tmp->range)[nranges] = -1;
+		((gint *)tmp->range)[nranges + 1] = -1;
+		memcpy((gint *)tmp->value, values, nvalues * sizeof (gint));
+
+		g_free(file_profiles[profile]);
+		file_profiles[profile] = tmp;
+
+		g_free(ranges);
+		ranges = NULL;
+		g_free(values);
+		values = NULL;
+	}
+
+	status = TRUE;
+
+EXIT:
+	g_clear_error(&error);
+	g_free(ranges);
+	g_free(values);
+	g_key_file_free(keyfile);
+
+	return status;
+}
+
+/**
+ * Read a block of samples from a CSV trace
+ *
+ * @param fp The trace
+ * @param interval The interval of samples without timestamps
+ * @param[in,out] count The number of samples read so far
+ * @return The number of samples in the block; 0 at the end of the trace
+ */
+static gsize read_block_csv(FILE *fp, gint interval, guint64 *count)
+{
+	gchar line[ALSTUNE_LINE_MAX];
+	gsize n = 0;
+
+	while ((n < ALSTUNE_BLOCK_SIZE) &&
+	       (fgets(line, sizeof (line), fp) != NULL)) {
+		gchar *str = g_strstrip(line);
+		gchar *end = NULL;
+		glong first;
+
+		/* Skip empty lines, comments and headers */
+		if ((*str == '\0') || (*str == '#'))
+			continue;
+
+		first = strtol(str, &end, 10);
+
+		if (end == str)
+			continue;
+
+		if (*end == ',') {
+			block_time[n] = (guint32)first;
+			block_raw[n] = (gint)strtol(end + 1, NULL, 10);
+		} else {
+			block_time[n] = (guint32)((*count + n) * interval);
+			block_raw[n] = (gint)first;
+		}
+
+		n++;
+	}
+
+	*count += n;
+
+	return n;
+}
+
+/**
+ * Read a block of samples from a binary trace
+ *
+ * @param fp The trace
+ * @param[in,out] count The number of samples read so far
+ * @return The number of samples in the block; 0 at the end of the trace
+ */
+static gsize read_block_binary(FILE *fp, guint64 *count)
+{
+	gsize n = fread(block_records, sizeof (alstune_record_t),
+			ALSTUNE_BLOCK_SIZE, fp);
+	gsize i;
+
+	for (i = 0; i < n; i++) {
+		block_time[i] = block_records[i].time_ms;
+		block_raw[i] = block_records[i].lux;
+	}
+
+	*count += n;
+
+	return n;
+}
+
+/**
+ * Find the first value outside a threshold window
+ *
+ * @param values The values
+ * @param first The first value to check
+ * @param last One past the last value to check
+ * @param lower The lower end of the window
+ * @param upper The upper end of the window
+ * @return The index of the value, or last if all values are inside
+ */
+static gsize find_outside(const gint *values, gsize first, gsize last,
+			  gint lower, gint upper)
+{
+	guint span = (guint)MAX(upper - lower, 0);
+
+	/* A single unsigned compare covers both ends of the window */
+	while ((first < last) && ((guint)(values[first] - lower) < span))
+		first++;
+
+	return first;
+}
+
+/**
+ * Count the values outside a threshold window
+ *
+ * @param values The values
+ * @param first The first value to check
+ * @param last One past the last value to check
+ * @param lower The lower end of the window
+ * @param upper The upper end of the window
+ * @return The number of values outside the window
+ */
+static guint64 count_outside(const gint *values, gsize first, gsize last,
+			     gint lower, gint upper)
+{
+	guint span = (guint)MAX(upper - lower, 0);
+	guint64 count = 0;
+	gsize i;
+
+	/* Branch-free, so that the compiler can vectorise it */
+	for (i = first; i < last; i++)
+		count += ((guint)(values[i] - lower) >= span);
+
+	return count;
+}
+
+/**
+ * Look up the brightness for a sample, and log transitions
+ *
+ * @param profile The profile
+ * @param id The profile number
+ * @param i The index of the sample in the block
+ * @param timeline The timeline, or NULL
+ */
+static void lookup_sample(alstune_profile_t *profile, gint id,
+			  gsize i, FILE *timeline)
+{
+	gint old = profile->level;
+
+	profile->value = als_profile_lookup(&profile->table, block_lux[i],
+					    &profile->level,
+					    &profile->lower, &profile->upper);
+
+	if (profile->level == old)
+		goto EXIT;
+
+	if (old != -1)
+		profile->transitions++;
+
+	if (timeline != NULL)
+		fprintf(timeline, "%u,%s,%d,%d,%d\n",
+			block_time[i],
+			mce_translate_int_to_string(profile_translation, id),
+			block_lux[i], profile->value % 256,
+			profile->value / 256);
+
+EXIT:
+	return;
+}
+
+/**
+ * Evaluate a profile over a block of samples
+ *
+ * The level only changes when the smoothed lux leaves the
+ * threshold window of the current level, so the block is scanned
+ * for the next such sample instead of looking up every sample
+ *
+ * @param profile The profile
+ * @param id The profile number
+ * @param n The number of samples in the block
+ * @param timeline The timeline, or NULL
+ */
+static void evaluate_block(alstune_profile_t *profile, gint id,
+			   gsize n, FILE *timeline)
+{
+	gsize i = 0;
+	gsize j;
+
+	if (profile->level == -1) {
+		lookup_sample(profile, id, 0, timeline);
+		profile->brightness_sum += profile->value % 256;
+		block_value[id][0] = profile->value;
+		i = 1;
+	}
+
+	while (i < n) {
+		gsize next = find_outside(block_lux, i, n,
+					  profile->lower, profile->upper);
+
+		profile->wakeups += count_outside(block_raw, i, next,
+						  profile->lower,
+						  profile->upper);
+		profile->brightness_sum += (guint64)(profile->value % 256) *
+					   (next - i);
+
+		for (j = i; j < next; j++)
+			block_value[id][j] = profile->value;
+
+		if (next == n)
+			break;
+
+		/* The raw reading is checked against the old window */
+		profile->wakeups += count_outside(block_raw, next, next + 1,
+						  profile->lower,
+						  profile->upper);
+
+		lookup_sample(profile, id, next, timeline);
+		profile->brightness_sum += profile->value % 256;
+		block_value[id][next] = profile->value;
+		i = next + 1;
+	}
+}
+
+/**
+ * Poll the trace at a sample, the way the ALS filter does
+ *
+ * @param schedule The poll schedule
+ * @param i The index of the sample in the block
+ */
+static void poll_sample(alstune_schedule_t *schedule, gsize i)
+{
+	gint lux = als_filter_chain_map(&schedule->chain,
+					MAX(block_raw[i], 0));
+	gint profile;
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		if (alstune_profiles[profile].enabled == FALSE)
+			continue;
+
+		/* Readings inside the threshold window are ignored */
+		if ((schedule->level[profile] != -1) &&
+		    (lux >= schedule->lower[profile]) &&
+		    (lux < schedule->upper[profile]))
+			continue;
+
+		schedule->value[profile] =
+			als_profile_lookup(&alstune_profiles[profile].table,
+					   lux, &schedule->level[profile],
+					   &schedule->lower[profile],
+					   &schedule->upper[profile]);
+	}
+
+	(void)als_poll_adapt(&schedule->poll, lux);
+
+	schedule->started = TRUE;
+	schedule->next_poll = (guint64)block_time[i] +
+			      schedule->poll.interval;
+	schedule->polls++;
+}
+
+/**
+ * Replay a poll schedule over a block of samples
+ *
+ * The brightness is compared with the one of a sensor
+ * that is read at every sample, so evaluate_block()
+ * must have been called for the block first
+ *
+ * @param schedule The poll schedule
+ * @param n The number of samples in the block
+ */
+static void evaluate_schedule(alstune_schedule_t *schedule, gsize n)
+{
+	gsize i;
+
+	for (i = 0; i < n; i++) {
+		gint profile;
+
+		if ((schedule->started == FALSE) ||
+		    (block_time[i] >= schedule->next_poll))
+			poll_sample(schedule, i);
+
+		for (profile = ALS_PROFILE_MINIMUM;
+		     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+			gint error;
+
+			if (alstune_profiles[profile].enabled == FALSE)
+				continue;
+
+			error = ABS((schedule->value[profile] % 256) -
+				    (block_value[profile][i] % 256));
+
+			schedule->error_sum[profile] += error;
+			schedule->off_target[profile] += (error != 0);
+		}
+	}
+}
+
+/**
+ * Output the results
+ *
+ * @param samples The number of samples
+ * @param duration The duration of the trace, in milliseconds
+ */
+static void report(guint64 samples, guint64 duration)
+{
+	alstune_schedule_t *fixed = &alstune_schedules[ALSTUNE_SCHEDULE_FIXED];
+	alstune_schedule_t *adaptive =
+		&alstune_schedules[ALSTUNE_SCHEDULE_ADAPTIVE];
+	gint schedule;
+	gint profile;
+
+	fprintf(stdout,
+		"Samples: %" G_GUINT64_FORMAT "\n"
+		"Duration: %" G_GUINT64_FORMAT " ms\n"
+		"Poll wakeups at %d ms: %" G_GUINT64_FORMAT "\n"
+		"Poll wakeups at %d-%d ms: %" G_GUINT64_FORMAT "\n"
+		"\n"
+		"%-10s %12s %18s %16s\n",
+		samples, duration,
+		fixed->poll.min, fixed->polls,
+		adaptive->poll.min, adaptive->poll.max, adaptive->polls,
+		"profile", "transitions", "interrupt wakeups",
+		"mean brightness");
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		alstune_profile_t *p = &alstune_profiles[profile];
+
+		if (p->enabled == FALSE)
+			continue;
+
+		fprintf(stdout,
+			"%-10s %12" G_GUINT64_FORMAT
+			" %18" G_GUINT64_FORMAT " %15.1f%%\n",
+			mce_translate_int_to_string(profile_translation,
+						    profile),
+			p->transitions, p->wakeups,
+			(samples == 0) ? 0.0 :
+			(gdouble)p->brightness_sum / (gdouble)samples);
+	}
+
+	/* The error is in brightness percentage points,
+	 * against a sensor that is read at every sample
+	 */
+	fprintf(stdout,
+		"\n"
+		"%-10s %-10s %16s %16s\n",
+		"profile", "schedule", "mean error", "off target");
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		if (alstune_profiles[profile].enabled == FALSE)
+			continue;
+
+		for (schedule = 0; schedule < ALSTUNE_SCHEDULES; schedule++) {
+			alstune_schedule_t *s = &alstune_schedules[schedule];
+
+			fprintf(stdout,
+				"%-10s %-10s %16.2f %15.2f%%\n",
+				mce_translate_int_to_string(profile_translation,
+							    profile),
+				mce_translate_int_to_string(schedule_translation,
+							    schedule),
+				(samples == 0) ? 0.0 :
+				(gdouble)s->error_sum[profile] /
+				(gdouble)samples,
+				(samples == 0) ? 0.0 :
+				100.0 * (gdouble)s->off_target[profile] /
+				(gdouble)samples);
+		}
+	}
+}
+
+/**
+ * Main
+ *
+ * @param argc Number of command line arguments
+ * @param argv Array with command line arguments
+ * @return 0 on success, non-zero on failure
+ */
+int main(int argc, char **argv)
+{
+	int optc;
+	int opt_index;
+
+	int status = EXIT_FAILURE;
+
+	const alstune_device_t *device = &alstune_devices[0];
+	const gchar *profiles_file = NULL;
+	const gchar *timeline_file = NULL;
+	const gchar *chain = "";
+	gint output = ALSTUNE_OUTPUT_DISPLAY;
+	gint only_profile = -1;
+	gint format = TRACE_FORMAT_CSV;
+	gint threshold_max = G_MAXINT;
+	gint interval = ALSTUNE_SAMPLE_INTERVAL;
+	gint poll_min = ALS_DISPLAY_ON_POLL_MIN;
+	gint poll_max = ALS_DISPLAY_ON_POLL_MAX;
+	gint poll_fixed = ALSTUNE_FIXED_POLL_INTERVAL;
+	als_filter_params_t params = {
+		.median_window = DEFAULT_ALS_MEDIAN_WINDOW,
+		.ewma_weight = DEFAULT_ALS_EWMA_WEIGHT,
+		.hysteresis_band = DEFAULT_ALS_HYSTERESIS_BAND,
+		.hysteresis_min = DEFAULT_ALS_HYSTERESIS_MIN,
+		.spike_ratio = DEFAULT_ALS_SPIKE_RATIO,
+		.spike_min = DEFAULT_ALS_SPIKE_MIN,
+		.spike_hold = DEFAULT_ALS_SPIKE_HOLD
+	};
+	FILE *trace = stdin;
+	FILE *timeline = NULL;
+	guint64 samples = 0;
+	guint64 first_time = 0;
+	guint64 last_time = 0;
+	guint enabled = 0;
+	gint schedule;
+	gint profile;
+	gsize n;
+
+	const char optline[] = "d:o:P:p:c:m:i:f:t:h";
+
+	struct option const options[] = {
+		{ "device", required_argument, 0, 'd' },
+		{ "output", required_argument, 0, 'o' },
+		{ "profiles", required_argument, 0, 'P' },
+		{ "profile", required_argument, 0, 'p' },
+		{ "chain", required_argument, 0, 'c' },
+		{ "median-window", required_argument, 0, 'M' },
+		{ "ewma-weight", required_argument, 0, 'E' },
+		{ "hysteresis-band", required_argument, 0, 'B' },
+		{ "hysteresis-min", required_argument, 0, 'N' },
+		{ "spike-ratio", required_argument, 0, 'R' },
+		{ "spike-min", required_argument, 0, 'S' },
+		{ "spike-hold", required_argument, 0, 'H' },
+		{ "threshold-max", required_argument, 0, 'm' },
+		{ "interval", required_argument, 0, 'i' },
+		{ "poll", required_argument, 0, 'Q' },
+		{ "poll-fixed", required_argument, 0, 'F' },
+		{ "format", required_argument, 0, 'f' },
+		{ "timeline", required_argument, 0, 't' },
+		{ "help", no_argument, 0, 'h' },
+		{ 0, 0, 0, 0 }
+	};
+
+	progname = PRG_NAME;
+
+	/* Parse the command-line options */
+	while ((optc = getopt_long(argc, argv, optline,
+				   options, &opt_index)) != -1) {
+		gboolean valid = TRUE;
+
+		switch (optc) {
+		case 'd':
+			for (device = alstune_devices;
+			     device->name != NULL; device++) {
+				if (strcmp(device->name, optarg) == 0)
+					break;
+			}
+
+			if (device->name == NULL) {
+				invalid_argument("device", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 'o':
+			output = mce_translate_string_to_int(output_translation,
+							     optarg);
+			if (output == MCE_INVALID_TRANSLATION) {
+				invalid_argument("output", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 'P':
+			profiles_file = optarg;
+			break;
+
+		case 'p':
+			only_profile =
+				mce_translate_string_to_int(profile_translation,
+							    optarg);
+			if (only_profile == MCE_INVALID_TRANSLATION) {
+				invalid_argument("profile", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 'c':
+			chain = optarg;
+			break;
+
+		case 'M':
+			valid = parse_int("median-window", optarg,
+					  &params.median_window);
+			break;
+
+		case 'E':
+			valid = parse_int("ewma-weight", optarg,
+					  &params.ewma_weight);
+			break;
+
+		case 'B':
+			valid = parse_int("hysteresis-band", optarg,
+					  &params.hysteresis_band);
+			break;
+
+		case 'N':
+			valid = parse_int("hysteresis-min", optarg,
+					  &params.hysteresis_min);
+			break;
+
+		case 'R':
+			valid = parse_int("spike-ratio", optarg,
+					  &params.spike_ratio);
+			break;
+
+		case 'S':
+			valid = parse_int("spike-min", optarg,
+					  &params.spike_min);
+			break;
+
+		case 'H':
+			valid = parse_int("spike-hold", optarg,
+					  &params.spike_hold);
+			break;
+
+		case 'm':
+			valid = parse_int("threshold-max", optarg,
+					  &threshold_max);
+			break;
+
+		case 'i':
+			valid = parse_int("interval", optarg, &interval);
+
+			if ((valid == TRUE) && (interval <= 0)) {
+				invalid_argument("interval", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 'Q':
+			valid = parse_range("poll", optarg,
+					    &poll_min, &poll_max);
+			break;
+
+		case 'F':
+			valid = parse_int("poll-fixed", optarg, &poll_fixed);
+
+			if ((valid == TRUE) && (poll_fixed <= 0)) {
+				invalid_argument("poll-fixed", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 'f':
+			format = mce_translate_string_to_int(format_translation,
+							     optarg);
+			if (format == TRACE_FORMAT_INVALID) {
+				invalid_argument("format", optarg);
+				valid = FALSE;
+			}
+
+			break;
+
+		case 't':
+			timeline_file = optarg;
+			break;
+
+		case 'h':
+			usage();
+			status = EXIT_SUCCESS;
+			goto EXIT;
+
+		default:
+			valid = FALSE;
+			break;
+		}
+
+		if (valid == FALSE) {
+			fprintf(stderr,
+				"Try `%s --help' for more information.\n",
+				progname);
+			goto EXIT;
+		}
+	}
+
+	/* The chain parameters must be in place before the stages */
+	als_filter_chain_setup(&alstune_chain, &params);
+
+	if (parse_chain(&alstune_chain, chain) == FALSE)
+		goto EXIT;
+
+	if (als_filter_chain_reset(&alstune_chain) == FALSE) {
+		fprintf(stderr, "%s: cannot set up the smoothing chain\n",
+			progname);
+		goto EXIT;
+	}
+
+	/* Each schedule smooths the readings of its own polls */
+	for (schedule = 0; schedule < ALSTUNE_SCHEDULES; schedule++) {
+		alstune_schedule_t *s = &alstune_schedules[schedule];
+
+		als_filter_chain_setup(&s->chain, &params);
+
+		if ((parse_chain(&s->chain, chain) == FALSE) ||
+		    (als_filter_chain_reset(&s->chain) == FALSE)) {
+			fprintf(stderr,
+				"%s: cannot set up the smoothing chain\n",
+				progname);
+			goto EXIT;
+		}
+
+		for (profile = ALS_PROFILE_MINIMUM;
+		     profile <= ALS_PROFILE_MAXIMUM; profile++)
+			s->level[profile] = -1;
+	}
+
+	als_poll_set_range(&alstune_schedules[ALSTUNE_SCHEDULE_FIXED].poll,
+			   poll_fixed, poll_fixed);
+	als_poll_reset(&alstune_schedules[ALSTUNE_SCHEDULE_FIXED].poll);
+	als_poll_set_range(&alstune_schedules[ALSTUNE_SCHEDULE_ADAPTIVE].poll,
+			   poll_min, poll_max);
+	als_poll_reset(&alstune_schedules[ALSTUNE_SCHEDULE_ADAPTIVE].poll);
+
+	if ((profiles_file != NULL) && (load_profiles(profiles_file) == FALSE))
+		goto EXIT;
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+		alstune_profile_t *p = &alstune_profiles[profile];
+		const als_profile_struct *source = file_profiles[profile];
+
+		if ((only_profile != -1) && (only_profile != profile))
+			continue;
+
+		if ((source == NULL) && (device->profiles[output] != NULL))
+			source = &device->profiles[output][profile];
+
+		if (source == NULL)
+			continue;
+
+		if (als_profile_compile(source, &p->table,
+					threshold_max) != 0)
+			fprintf(stderr,
+				"%s: warning: the ranges of profile `%s' "
+				"are unsorted or unterminated\n",
+				progname,
+				mce_translate_int_to_string(profile_translation,
+							    profile));
+
+		p->enabled = TRUE;
+		p->level = -1;
+		enabled++;
+	}
+
+	if (enabled == 0) {
+		fprintf(stderr,
+			"%s: no profiles for `%s' on `%s'\n",
+			progname,
+			mce_translate_int_to_string(output_translation, output),
+			device->name);
+		goto EXIT;
+	}
+
+	if ((optind < argc) && (strcmp(argv[optind], "-") != 0)) {
+		if ((trace = fopen(argv[optind], "r")) == NULL) {
+			fprintf(stderr, "%s: cannot open `%s'; %s\n",
+				progname, argv[optind], g_strerror(errno));
+			goto EXIT;
+		}
+	}
+
+	if (timeline_file != NULL) {
+		if ((timeline = fopen(timeline_file, "w")) == NULL) {
+			fprintf(stderr, "%s: cannot open `%s'; %s\n",
+				progname, timeline_file, g_strerror(errno));
+			goto EXIT;
+		}
+
+		fprintf(timeline, "time_ms,profile,lux,brightness,hbm\n");
+	}
+
+	/* Each block is smoothed once, then evaluated
+	 * against every profile
+	 */
+	while ((n = (format == TRACE_FORMAT_BINARY) ?
+		    read_block_binary(trace, &samples) :
+		    read_block_csv(trace, interval, &samples)) > 0) {
+		gsize i;
+
+		if (samples == n)
+			first_time = block_time[0];
+
+		last_time = block_time[n - 1];
+
+		for (i = 0; i < n; i++)
+			block_lux[i] =
+				als_filter_chain_map(&alstune_chain,
+						     MAX(block_raw[i], 0));
+
+		for (profile = ALS_PROFILE_MINIMUM;
+		     profile <= ALS_PROFILE_MAXIMUM; profile++) {
+			if (alstune_profiles[profile].enabled == FALSE)
+				continue;
+
+			evaluate_block(&alstune_profiles[profile], profile,
+				       n, timeline);
+		}
+
+		for (schedule = 0; schedule < ALSTUNE_SCHEDULES; schedule++)
+			evaluate_schedule(&alstune_schedules[schedule], n);
+	}
+
+	if (ferror(trace) != 0) {
+		fprintf(stderr, "%s: cannot read the trace; %s\n",
+			progname, g_strerror(errno));
+		goto EXIT;
+	}
+
+	report(samples, (last_time > first_time) ? last_time - first_time : 0);
+
+	status = EXIT_SUCCESS;
+
+EXIT:
+	if ((trace != NULL) && (trace != stdin))
+		fclose(trace);
+
+	if (timeline != NULL)
+		fclose(timeline);
+
+	for (profile = ALS_PROFILE_MINIMUM;
+	     profile <= ALS_PROFILE_MAXIMUM; profile++)
+		g_free(file_profiles[profile]);
+
+	als_filter_chain_free(&alstune_chain);
+
+	for (schedule = 0; schedule < ALSTUNE_SCHEDULES; schedule++)
+		als_filter_chain_free(&alstune_schedules[schedule].chain);
+
+	return status;
+}
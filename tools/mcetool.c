@@ -30,6 +30,7 @@
 					 */
 #include <stdlib.h>			/* exit(), EXIT_FAILURE */
 #include <string.h>			/* strcmp(), strlen(), strdup() */
+#include <unistd.h>			/* sleep() */
 #include <dbus/dbus.h>
 #include <gconf/gconf-client.h>
 
@@ -41,6 +42,7 @@
 #include "tklock.h"			/* For GConf paths */
 #include "modules/display.h"		/* For GConf paths */
 #include "modules/powersavemode.h"	/* For GConf paths */
+#include "mce-wakeups.h"		/* MCE_WAKEUPS_GET */
 
 /** Name shown by --help etc. */
 #define PRG_NAME			"mcetool"
@@ -97,6 +99,25 @@
 /** Define demo mode DBUS method */
 #define MCE_DBUS_DEMO_MODE_REQ      		"display_set_demo_mode"
 
+/** Interval between updates of the wakeup statistics, in seconds */
+#define WAKEUPS_UPDATE_INTERVAL			5
+
+/** Number of sources shown in the wakeup statistics */
+#define WAKEUPS_MAX_ROWS			20
+
+/** Wakeup statistics for a source */
+typedef struct {
+	gchar *name;			/**< Type and name of the source */
+	guint wakeups;			/**< Wakeups caused by the source */
+	guint dispatches;		/**< Dispatches of the source */
+	guint64 cpu_time;		/**< CPU time used, in microseconds */
+	guint max_time;			/**< Longest dispatch, in microseconds */
+	guint stalls;			/**< Dispatches over the time budget */
+	guint new_wakeups;		/**< Wakeups since the last update */
+	guint new_dispatches;		/**< Dispatches since the last update */
+	guint64 new_cpu_time;		/**< CPU time since the last update */
+} wakeup_row_t;
+
 /** Enums for powerkey events */
 enum {
 	INVALID_EVENT = -1,		/**< Event not set */
@@ -233,6 +254,8 @@ static void usage(void)
 		  "event; valid types are:\n"
 		  "                                    ``short'', ``double'' "
 		  "and ``long''\n"
+		  "      --wakeups                   show what wakes up MCE; "
+		  "updated until interrupted\n"
 		  "      --status                    output MCE status\n"
 		  "      --block                     block after executing "
 		  "commands\n"
@@ -1127,6 +1150,263 @@ EXIT:
 	return status;
 }
 
+/**
+ * Free the wakeup statistics for a source
+ *
+ * @param data The statistics
+ */
+static void free_wakeup_row(gpointer data)
+{
+	wakeup_row_t *row = data;
+
+	g_free(row->name);
+	g_free(row);
+}
+
+/**
+ * Get the wakeup statistics from MCE
+ *
+ * @param[out] wakeups The number of mainloop wakeups
+ * @param[out] elapsed Milliseconds since the statistics were started
+ * @param rows Table to add the statistics for each source to
+ * @return TRUE on success, FALSE on failure
+ */
+static gboolean get_wakeup_stats(guint *wakeups, guint *elapsed,
+				 GHashTable *rows)
+{
+	/* com.nokia.mce.request.get_wakeup_stats */
+	DBusMessage *reply = NULL;
+	DBusError error;
+	dbus_uint32_t total = 0;
+	dbus_uint32_t span = 0;
+	gchar **names = NULL;
+	dbus_uint32_t *source_wakeups = NULL;
+	dbus_uint32_t *dispatches = NULL;
+	dbus_uint64_t *cpu_times = NULL;
+	dbus_uint32_t *max_times = NULL;
+	dbus_uint32_t *stalls = NULL;
+	gint names_count = 0;
+	gint wakeups_count = 0;
+	gint dispatches_count = 0;
+	gint cpu_times_count = 0;
+	gint max_times_count = 0;
+	gint stalls_count = 0;
+	gboolean status = FALSE;
+	gint i;
+
+	dbus_error_init(&error);
+
+	if ((reply = mcetool_dbus_call_with_reply(MCE_WAKEUPS_GET,
+						  NULL)) == NULL)
+		goto EXIT;
+
+	if (dbus_message_get_args(reply, &error,
+				  DBUS_TYPE_UINT32, &total,
+				  DBUS_TYPE_UINT32, &span,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+				  &names, &names_count,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				  &source_wakeups, &wakeups_count,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				  &dispatches, &dispatches_count,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_UINT64,
+				  &cpu_times, &cpu_times_count,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				  &max_times, &max_times_count,
+				  DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32,
+				  &stalls, &stalls_count,
+				  DBUS_TYPE_INVALID) == FALSE) {
+		fprintf(stderr,
+			"Failed to get reply arguments from %s: "
+			"%s; exiting",
+			MCE_WAKEUPS_GET, error.message);
+		dbus_error_free(&error);
+		goto EXIT;
+	}
+
+	if ((wakeups_count != names_count) ||
+	    (dispatches_count != names_count) ||
+	    (cpu_times_count != names_count) ||
+	    (max_times_count != names_count) ||
+	    (stalls_count != names_count)) {
+		fprintf(stderr,
+			"Invalid reply from %s; exiting",
+			MCE_WAKEUPS_GET);
+		goto EXIT;
+	}
+
+	for (i = 0; i < names_count; i++) {
+		wakeup_row_t *row = g_new0(wakeup_row_t, 1);
+
+		row->name = g_strdup(names[i]);
+		row->wakeups = source_wakeups[i];
+		row->dispatches = dispatches[i];
+		row->cpu_time = cpu_times[i];
+		row->max_time = max_times[i];
+		row->stalls = stalls[i];
+		g_hash_table_insert(rows, row->name, row);
+	}
+
+	*wakeups = total;
+	*elapsed = span;
+	status = TRUE;
+
+EXIT:
+	dbus_free_string_array(names);
+
+	if (reply != NULL)
+		dbus_message_unref(reply);
+
+	return status;
+}
+
+/**
+ * Compare the wakeup statistics of two sources;
+ * the source with most new wakeups, then dispatches, comes first
+ *
+ * @param a The statistics of the first source
+ * @param b The statistics of the second source
+ * @return Less than, equal to or greater than zero if a should be
+ *         shown before, at the same position as or after b
+ */
+static gint wakeup_row_compare(gconstpointer a, gconstpointer b)
+{
+	const wakeup_row_t *row_a = a;
+	const wakeup_row_t *row_b = b;
+
+	if (row_a->new_wakeups != row_b->new_wakeups)
+		return (row_a->new_wakeups > row_b->new_wakeups) ? -1 : 1;
+
+	if (row_a->new_dispatches != row_b->new_dispatches)
+		return (row_a->new_dispatches > row_b->new_dispatches) ? -1 : 1;
+
+	return strcmp(row_a->name, row_b->name);
+}
+
+/**
+ * Print what woke up MCE since the last update
+ *
+ * @param rows The current statistics for each source
+ * @param old_rows The statistics at the last update; NULL if none
+ * @param wakeups The number of mainloop wakeups since the last update
+ * @param span Milliseconds since the last update
+ */
+static void print_wakeup_stats(GHashTable *rows, GHashTable *old_rows,
+			       guint wakeups, guint span)
+{
+	GHashTableIter iter;
+	GList *sorted = NULL;
+	GList *tmp;
+	gpointer value;
+	guint attributed = 0;
+	gint count = 0;
+
+	if (span == 0)
+		span = 1;
+
+	g_hash_table_iter_init(&iter, rows);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		wakeup_row_t *row = value;
+		wakeup_row_t *old_row = NULL;
+
+		if (old_rows != NULL)
+			old_row = g_hash_table_lookup(old_rows, row->name);
+
+		row->new_wakeups = row->wakeups;
+		row->new_dispatches = row->dispatches;
+		row->new_cpu_time = row->cpu_time;
+
+		if (old_row != NULL) {
+			row->new_wakeups -= old_row->wakeups;
+			row->new_dispatches -= old_row->dispatches;
+			row->new_cpu_time -= old_row->cpu_time;
+		}
+
+		attributed += row->new_wakeups;
+		sorted = g_list_prepend(sorted, row);
+	}
+
+	sorted = g_list_sort(sorted, wakeup_row_compare);
+
+	fprintf(stdout,
+		"\n"
+		"%.1f wakeups/min over the last %u s; "
+		"%.1f/min not attributed to a source\n"
+		"\n"
+		"%12s %12s %12s %8s %7s  %s\n",
+		(gdouble)wakeups * 60000 / span, (span + 500) / 1000,
+		(gdouble)(wakeups - MIN(wakeups, attributed)) * 60000 / span,
+		"wakeups/min", "dispatch/min", "cpu ms/min", "max ms",
+		"stalls", "source");
+
+	for (tmp = sorted;
+	     (tmp != NULL) && (count < WAKEUPS_MAX_ROWS);
+	     tmp = g_list_next(tmp), count++) {
+		wakeup_row_t *row = tmp->data;
+
+		if (row->new_dispatches == 0)
+			break;
+
+		fprintf(stdout,
+			"%12.1f %12.1f %12.1f %8.1f %7u  %s\n",
+			(gdouble)row->new_wakeups * 60000 / span,
+			(gdouble)row->new_dispatches * 60000 / span,
+			(gdouble)row->new_cpu_time * 60 / span,
+			(gdouble)row->max_time / 1000,
+			row->stalls, row->name);
+	}
+
+	g_list_free(sorted);
+}
+
+/**
+ * Show what wakes up MCE; updated until interrupted
+ * The first update covers the time since MCE was started
+ *
+ * @return 0 on success, EXIT_FAILURE on failure
+ */
+static gint show_wakeups(void)
+{
+	GHashTable *old_rows = NULL;
+	guint old_wakeups = 0;
+	guint old_elapsed = 0;
+	gint status = EXIT_FAILURE;
+
+	while (TRUE) {
+		GHashTable *rows;
+		guint wakeups;
+		guint elapsed;
+
+		rows = g_hash_table_new_full(g_str_hash, g_str_equal,
+					     NULL, free_wakeup_row);
+
+		if (get_wakeup_stats(&wakeups, &elapsed, rows) == FALSE) {
+			g_hash_table_destroy(rows);
+			goto EXIT;
+		}
+
+		print_wakeup_stats(rows, old_rows,
+				   wakeups - old_wakeups,
+				   elapsed - old_elapsed);
+
+		if (old_rows != NULL)
+			g_hash_table_destroy(old_rows);
+
+		old_rows = rows;
+		old_wakeups = wakeups;
+		old_elapsed = elapsed;
+
+		sleep(WAKEUPS_UPDATE_INTERVAL);
+	}
+
+EXIT:
+	if (old_rows != NULL)
+		g_hash_table_destroy(old_rows);
+
+	return status;
+}
+
 /**
  * Print mce related information
  *
@@ -1565,6 +1845,7 @@ int main(int argc, char **argv)
 	gboolean send_dim = FALSE;
 	gboolean send_blank = FALSE;
 	gboolean request_color_profile_ids = FALSE;
+	gboolean show_wakeup_stats = FALSE;
 	dbus_uint32_t new_radio_states;
 	dbus_uint32_t radio_states_mask;
 
@@ -1598,6 +1879,7 @@ int main(int argc, char **argv)
 		{ "deactivate-led-pattern", required_argument, 0, 'Y' },
 		{ "powerkey-event", required_argument, 0, 'e' },
 		{ "modinfo", required_argument, 0, 'M' },
+		{ "wakeups", no_argument, 0, 'W' },
 		{ "status", no_argument, 0, 'N' },
 		{ "session", no_argument, 0, 'S' },
 		{ "help", no_argument, 0, 'h' },
@@ -1919,6 +2201,11 @@ int main(int argc, char **argv)
 			get_mce_status = FALSE;
 			break;
 
+		case 'W':
+			show_wakeup_stats = TRUE;
+			get_mce_status = FALSE;
+			break;
+
 		case 'N':
 			force_mce_status = TRUE;
 			break;
@@ -2102,6 +2389,9 @@ int main(int argc, char **argv)
 	if ((get_mce_status == TRUE) || (force_mce_status == TRUE))
 		mcetool_get_status();
 
+	if (show_wakeup_stats == TRUE)
+		status = show_wakeups();
+
 	while (block == TRUE)
 		/* Do nothing */;
 